@@ -0,0 +1,115 @@
+#include "ProcessTracer.h"
+#include "SignalHandler.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Measures how many break point hits per second the tracer handles. The benchmark traces itself:
+// the tracee calls ldb_bench_target() in a loop, on which a break point is set. As in the
+// debugger, the events are handled on the tracer thread of ProcessTracer, and only the reported
+// stops reach the main thread.
+
+extern "C" __attribute__((noinline, used)) void ldb_bench_target(size_t i) {
+  asm volatile("" : : "r"(i) : "memory");
+}
+
+namespace {
+
+  /**
+   * @brief Hands the stops reported by the tracer thread to the main thread
+   */
+  class StopQueue : public ldb::SignalHandler {
+  public:
+    using SignalHandler::SignalHandler;
+
+    ldb::SignalEvent handleEvent(const ldb::SignalEvent& event) override {
+      auto res = SignalHandler::handleEvent(event);
+      if (res.isIgnored()) return res;
+      {
+        std::scoped_lock<std::mutex> lock(mutex);
+        events.push_back(res);
+      }
+      reported.notify_one();
+      return res;
+    }
+
+    ldb::SignalEvent wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      reported.wait(lock, [this]() { return not events.empty(); });
+      auto res = events.front();
+      events.pop_front();
+      return res;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable reported;
+    std::deque<ldb::SignalEvent> events;
+  };
+
+  int runTracee(size_t iterations) {
+    for (size_t i = 0; i < iterations; i++) ldb_bench_target(i);
+    return 0;
+  }
+
+  /**
+   * @brief Trace a new tracee until it exits
+   * @param fast_path If true, the break point counts its hits and continues from the tracer
+   * thread. Otherwise, every hit is reported as a stop to the main thread, which resumes the
+   * process
+   */
+  void runTracer(const std::string& self, size_t iterations, bool fast_path) {
+    ldb::ProcessTracer tracer(self, {"--tracee", std::to_string(iterations)});
+    auto* stop_queue = tracer.makeSignalHandler<StopQueue>();
+    auto* breakpoints = tracer.getBreakPointHandler();
+
+    const auto* symbols = tracer.getSymbolTable();
+    const auto* target = symbols ? (*symbols)["ldb_bench_target"] : nullptr;
+    if (not target) throw std::runtime_error("Failed to locate ldb_bench_target");
+    Elf64_Addr addr = target->getAddress();
+
+    tracer.execute([&]() {
+      if (fast_path) breakpoints->setAction(addr, {.auto_continue = true});
+      else
+        breakpoints->add(*target);
+    });
+
+    size_t stops = 0;
+    auto start = std::chrono::steady_clock::now();
+    tracer.resume();
+    while (true) {
+      auto event = stop_queue->wait();
+      if (event.getStatus() == ldb::Process::Status::kExited or
+          event.getStatus() == ldb::Process::Status::kKilled or
+          event.getStatus() == ldb::Process::Status::kDead)
+        break;
+
+      // A reported stop: the handler already stepped over the break point
+      stops++;
+      tracer.resume();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t hits = fast_path ? tracer.execute([&]() { return breakpoints->getHitCount(addr); })
+                            : stops;
+    std::cout << (fast_path ? "action (count, continue)" : "reported stop") << ": " << hits
+              << " hits in " << elapsed.count() << "s, " << size_t(hits / elapsed.count())
+              << " hits/s" << std::endl;
+  }
+
+}// namespace
+
+int main(int argc, char** argv) {
+  if (argc == 3 and std::string_view(argv[1]) == "--tracee") return runTracee(std::stoul(argv[2]));
+
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+  std::string self = std::filesystem::read_symlink("/proc/self/exe");
+  runTracer(self, iterations, true);
+  runTracer(self, iterations, false);
+  return 0;
+}
@@ -2,44 +2,50 @@
 #include "Process.h"
 #include "SignalHandler.h"
 #include <QtCore/QObject>
-#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 namespace ldb::gui {
 
+  /**
+   * @brief Signal handler that reports the stops of the process to the GUI
+   * Events are handled on the tracer thread, see TracerThread. Only the ones that are reported
+   * reach the GUI thread, through queued signals
+   */
   class QtSignalHandler : public QObject, public SignalHandler {
     Q_OBJECT
   public:
     explicit QtSignalHandler(Process* process, BreakPointHandler* bph);
-    ~QtSignalHandler() override;
 
     SignalEvent handleEvent(const SignalEvent& event) override;
 
-    void reset(Process* p, BreakPointHandler* bph) override;
-
-    void mute() override;
-    void unmute() override;
-
   signals:
 
     void signalReceived(SignalEvent event);
     void processExited();
-    void ignoredEvent(SignalEvent event);
 
-  private slots:
+    /**
+     * @brief Emitted when the process stopped on an internal break point that changed what the
+     * views show, e.g. the loaded libraries, and was resumed
+     */
+    void internalBreakpoint();
 
-    void resumeTracee(SignalEvent event);
-    void resetBreakpoint();
+  protected:
+    void internalBreakpointChanged() override;
 
-  private:
-    void stopThread();
+    /**
+     * @brief Hand the messages to the GUI thread, which logs them
+     * A single flush is queued until the GUI thread runs it, however many break points are hit
+     */
+    void logMessages(std::vector<BreakPointMessage>&& messages) override;
 
-    std::mutex mutex;
-    std::atomic<bool> worker_waiting;
-    std::atomic<bool> worker_exit;
+  private:
+    // Runs on the GUI thread
+    void flushMessages();
 
-    void workerLoop();
-    QThread* worker_thread;
-    std::condition_variable update_cv;
+    std::mutex messages_mutex;
+    // Messages of the tracer thread, not logged yet
+    std::vector<BreakPointMessage> pending_messages;
   };
 
 }// namespace ldb::gui
@@ -43,6 +43,16 @@ namespace ldb::gui {
       return process_tracer.get();
     }
 
+    /**
+     * @brief Lock the state the tracer thread updates while the process runs, if there is a tracer
+     * Views hold it while they read the symbol table, break points, trace buffers or profilers.
+     * ProcessTracer::execute() must not be called meanwhile, and neither must the models be reset
+     * @see ProcessTracer::lock()
+     */
+    std::unique_lock<std::mutex> lockTracer() {
+      return process_tracer ? process_tracer->lock() : std::unique_lock<std::mutex>();
+    }
+
   public slots:
 
     /**
@@ -120,6 +130,11 @@ namespace ldb::gui {
      */
     void executionEnded();
 
+    /**
+     * @brief Emitted when the tracee may have loaded or unloaded shared libraries
+     */
+    void librariesChanged();
+
   private:
     std::unique_ptr<ProcessTracer> process_tracer;
 
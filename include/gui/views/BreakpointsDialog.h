@@ -1,10 +1,16 @@
 #pragma once
+#include "ProcessTracer.h"
+#include "SymbolIndex.h"
 #include "SymbolTable.h"
 #include "TracerView.h"
 #include <QDialog>
 #include <QLineEdit>
 #include <QSortFilterProxyModel>
 #include <QTableView>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 namespace ldb::gui {
 
@@ -21,6 +27,11 @@ namespace ldb::gui {
     bool isBreakpoint(const Symbol* sym) const;
     void toggleBreakpoint(const QModelIndex& index);
 
+    /**
+     * @brief Lock the tracer while symbols and break points are read, see TracerPanel::lockTracer()
+     */
+    std::unique_lock<std::mutex> lockTracer() const;
+
   public slots:
     void update();
 
@@ -28,6 +39,79 @@ namespace ldb::gui {
     TracerPanel* tracer_panel;
   };
 
+  /**
+   * @brief Lists the symbols matching a search, best matches first
+   *
+   * The index and the searches are built and run on a worker thread, one task after the other,
+   * and the results are received in batches. A new search does not wait for the previous one,
+   * which is only told to stop: its batches are dropped. Rows are only handed to the view when
+   * it needs them, through canFetchMore()/fetchMore().
+   */
+  class SymbolSearchModel : public QAbstractTableModel {
+  public:
+    SymbolSearchModel(QObject* parent, TracerPanel* tp);
+    ~SymbolSearchModel() override;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    /**
+     * @brief Returns the symbol of a row, or nullptr if its table was freed since it was indexed
+     * The caller holds the lock of the tracer
+     */
+    const Symbol* getSymbol(int row) const;
+    void toggleBreakpoint(const QModelIndex& index);
+
+    /**
+     * @brief Index the symbols of a tracer on the worker, and search them again once it is done
+     * The tracer must stay alive until the index is built, or this is called again: a build in
+     * progress is waited for, since the table may be about to change
+     * @param tracer The tracer whose table is indexed, or nullptr to clear the results
+     */
+    void setSymbols(ProcessTracer* tracer);
+
+    /**
+     * @brief Repaint the shown rows, after breakpoints were added or removed elsewhere
+     */
+    void refreshBreakpoints();
+
+  public slots:
+    void search(const QString& query);
+
+  private:
+    // Tell the running search, if any, to stop. Its worker is not waited for
+    void cancel();
+    void receive(uint64_t search_id, std::vector<SymbolIndex::Match>&& batch);
+    void setIndex(uint64_t index_id, std::shared_ptr<const SymbolIndex> new_index,
+                  uint64_t generation);
+
+    TracerPanel* tracer_panel;
+    std::shared_ptr<const SymbolIndex> symbol_index;
+    // The symbols of the index are freed once the tracer moves past this generation, which
+    // happens before the index is replaced
+    uint64_t index_generation = 0;
+    QString last_query;
+
+    // Every match received so far, of which the first loaded ones are shown
+    std::vector<uint32_t> results;
+    int loaded = 0;
+
+    // A single thread, so the searches run after the index they need is built
+    QThreadPool worker;
+    // Every search has its own flag, since a cancelled one may still be running
+    std::shared_ptr<std::atomic<bool>> cancelled;
+    // Batches of a previous search may still be queued, they are recognized by their id
+    uint64_t current_search = 0;
+    // Same for the indexes, the last one requested is the only one kept
+    uint64_t current_index = 0;
+    bool building = false;
+  };
+
   class BreakpointsDialog : public QDialog, public TracerView {
   public:
     explicit BreakpointsDialog(TracerPanel* parent);
@@ -45,8 +129,8 @@ namespace ldb::gui {
   private:
     QLineEdit* search_bar;
     BreakpointModel* model;
-    QSortFilterProxyModel* search_proxy;
-    QSortFilterProxyModel* breakpoint_proxy;
+    SymbolSearchModel* search_model;
+    QSortFilterProxyModel* breakpoint_proxy = nullptr;
     QTableView* function_list;
     QTableView* breakpoint_list;
   };
@@ -0,0 +1,78 @@
+#pragma once
+#include "CodeCoverage.h"
+#include "SignalHandler.h"
+#include "TracerView.h"
+#include <QAbstractTableModel>
+#include <QComboBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QTableView>
+#include <QTimer>
+#include <QWidget>
+#include <memory>
+
+namespace ldb::gui {
+
+  /**
+   * @brief Shows whether every function of a coverage run was reached, and how many of its probes
+   */
+  class CoverageModel : public QAbstractTableModel {
+  public:
+    CoverageModel(QObject* parent, TracerPanel* tp);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    /**
+     * @param new_coverage The coverage to show, or nullptr to clear the view
+     */
+    void setCoverage(std::shared_ptr<CodeCoverage> new_coverage);
+
+    const std::shared_ptr<CodeCoverage>& getCoverage() const {
+      return coverage;
+    }
+
+    /**
+     * @brief Show the probes hit since the last refresh, if any
+     */
+    void refresh();
+
+  private:
+    TracerPanel* tracer_panel;
+    std::shared_ptr<CodeCoverage> coverage;
+    // Probes covered at the last refresh
+    size_t shown = 0;
+  };
+
+  /**
+   * @brief Runs the process with coverage probes, and writes the report when it exits
+   */
+  class CoverageView : public QWidget, public TracerView {
+  public:
+    explicit CoverageView(TracerPanel* parent);
+
+  public slots:
+    void startCoverage();
+    void stopCoverage();
+    void exportCoverage();
+    void updateStatus(SignalEvent event);
+    void writeReport();
+    void clearView();
+
+  private:
+    void updateSummary();
+
+    QComboBox* granularity;
+    QLineEdit* report;
+    QLabel* summary;
+    QTableView* table;
+    CoverageModel* model;
+    QTimer* refresh_timer;
+
+    // The report of the run was written already
+    bool reported = false;
+  };
+
+}// namespace ldb::gui
@@ -0,0 +1,69 @@
+#pragma once
+#include "FunctionProfiler.h"
+#include "TracerView.h"
+#include <QAbstractTableModel>
+#include <QLineEdit>
+#include <QTableView>
+#include <QTimer>
+#include <QWidget>
+#include <memory>
+
+namespace ldb::gui {
+
+  /**
+   * @brief Shows the call count and latency of every function of a profiler
+   * Statistics are read from the profiler when they are displayed, with the tracer locked
+   */
+  class ProfileModel : public QAbstractTableModel {
+  public:
+    ProfileModel(QObject* parent, TracerPanel* tp);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    /**
+     * @param new_profiler The profiler to show, or nullptr to clear the view
+     */
+    void setProfiler(std::shared_ptr<FunctionProfiler> new_profiler);
+
+    const std::shared_ptr<FunctionProfiler>& getProfiler() const {
+      return profiler;
+    }
+
+    /**
+     * @brief Show the calls made since the last refresh
+     */
+    void refresh();
+
+  private:
+    const FunctionProfiler::Function* getFunction(int row) const;
+
+    TracerPanel* tracer_panel;
+    std::shared_ptr<FunctionProfiler> profiler;
+    int size = 0;
+  };
+
+  /**
+   * @brief Profiles functions, and shows their latency
+   * Profiled functions never stop the process, so the view polls the profiler while it runs
+   */
+  class ProfileView : public QWidget, public TracerView {
+  public:
+    explicit ProfileView(TracerPanel* parent);
+
+  public slots:
+    void addFunction();
+    void exportProfile();
+    void clearProfile();
+    void clearView();
+
+  private:
+    QLineEdit* location;
+    QTableView* table;
+    ProfileModel* model;
+    QTimer* refresh_timer;
+  };
+
+}// namespace ldb::gui
@@ -0,0 +1,84 @@
+#pragma once
+#include "TraceBuffer.h"
+#include "TracerView.h"
+#include <QAbstractTableModel>
+#include <QComboBox>
+#include <QLineEdit>
+#include <QTableView>
+#include <QTimer>
+#include <QWidget>
+#include <map>
+#include <memory>
+
+namespace ldb::gui {
+
+  /**
+   * @brief Shows the rows of a trace buffer, from the oldest one
+   * Values are read from the buffer when they are displayed, with the tracer locked. The buffer
+   * is never copied
+   */
+  class TraceModel : public QAbstractTableModel {
+  public:
+    TraceModel(QObject* parent, TracerPanel* tp);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    /**
+     * @param new_buffer The buffer to show, or nullptr to clear the view
+     */
+    void setBuffer(std::shared_ptr<TraceBuffer> new_buffer);
+
+    const std::shared_ptr<TraceBuffer>& getBuffer() const {
+      return buffer;
+    }
+
+    /**
+     * @brief Show the rows recorded since the last refresh, if any
+     */
+    void refresh();
+
+  private:
+    TracerPanel* tracer_panel;
+    std::shared_ptr<TraceBuffer> buffer;
+    // Rows recorded at the last refresh, the view is only reset when it changes
+    uint64_t shown = 0;
+    // Absolute index of the first row shown, see TraceBuffer::getFirst()
+    uint64_t first = 0;
+    int size = 0;
+    // Timestamp of the first row shown
+    uint64_t start = 0;
+  };
+
+  /**
+   * @brief Adds trace points, and shows what they recorded
+   * Trace points never stop the process, so the view polls their buffer while it runs
+   */
+  class TraceView : public QWidget, public TracerView {
+  public:
+    explicit TraceView(TracerPanel* parent);
+
+  public slots:
+    void addTracePoint();
+    void exportTrace();
+    void clearTrace();
+    void updateTracePoints();
+    void clearView();
+
+  private:
+    void selectTracePoint(int index);
+
+    QLineEdit* location;
+    QLineEdit* columns;
+    QComboBox* trace_points;
+    QTableView* table;
+    TraceModel* model;
+    QTimer* refresh_timer;
+
+    // Buffers stay alive once the process ended, so they can still be exported
+    std::map<Elf64_Addr, std::shared_ptr<TraceBuffer>> buffers;
+  };
+
+}// namespace ldb::gui
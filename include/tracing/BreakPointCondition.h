@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/user.h>
+#include <vector>
+#include "RemoteMemory.h"
+
+namespace ldb {
+
+  /**
+   * @brief Condition of a break point, compiled once into a small stack bytecode
+   *
+   * The condition is a C expression over integers, e.g. `rdi == 42 && *(int*)(rsp + 8) > 1000`:
+   * - registers by name, with or without a '$': rax, rdi, rip, r8... and the low 32 bits of the
+   * general purpose registers as int: eax, edi, r8d...
+   * - `reached`, the number of times the break point was reached, this one included
+   * - integer literals, in decimal or hexadecimal, with an optional 'u' suffix
+   * - casts to integer and pointer types, e.g. `(unsigned char)`, `(int*)`, `(uint64_t**)`
+   * - dereferences, which read the memory of the process. A register is a pointer to long
+   * - the arithmetic, bitwise, logical and comparison operators of C, with their precedence
+   *
+   * Every value is 64 bits wide, smaller types are sign or zero extended when they are read. The
+   * condition is evaluated from the tracer, on every hit, with the registers of the process.
+   */
+  class BreakPointCondition {
+  public:
+    /**
+     * @brief Compile a condition
+     * @throw std::runtime_error if the expression is invalid, with the position of the error
+     */
+    explicit BreakPointCondition(std::string_view source);
+
+    /**
+     * @brief Evaluate the condition
+     * @param regs registers of the stopped process
+     * @param reached number of times the break point was reached, this one included
+     * @param memory memory of the process, for dereferences
+     * @return The value of the expression, or nothing if a read failed or a division by zero
+     */
+    std::optional<int64_t> evaluate(const user_regs_struct& regs, uint64_t reached,
+                                    const RemoteMemory& memory) const;
+
+    const std::string& getSource() const {
+      return source;
+    }
+
+    enum class Op : uint8_t {
+      kConstant,// Push constants[arg]
+      kRegister,// Push the register at index arg in user_regs_struct
+      kReached,
+      kLoad,   // Replace an address by the value of size arg there
+      kExtend, // Truncate to arg bytes, and extend back to 64 bits
+      kNegate,
+      kNot,
+      kComplement,
+      kToBool,
+      kAdd,
+      kSubtract,
+      kMultiply,
+      kDivide,
+      kModulo,
+      kShiftLeft,
+      kShiftRight,
+      kAnd,
+      kOr,
+      kXor,
+      kEqual,
+      kNotEqual,
+      kLess,
+      kLessEqual,
+      kGreater,
+      kGreaterEqual,
+      kJumpIfZero,   // Jump to arg if the top is 0 (which is kept), pop it otherwise
+      kJumpIfNotZero,// Jump to arg with 1 on top if the top is not 0, pop it otherwise
+    };
+
+    struct Instruction {
+      Op op;
+      // Divisions, shifts, comparisons and extensions of unsigned values
+      bool is_unsigned = false;
+      uint32_t arg = 0;
+    };
+
+    const std::vector<Instruction>& getCode() const {
+      return code;
+    }
+
+    // Deeper expressions are rejected when they are compiled
+    static constexpr size_t kMaxDepth = 32;
+
+  private:
+    friend class ConditionCompiler;
+
+    std::string source;
+    std::vector<Instruction> code;
+    std::vector<int64_t> constants;
+  };
+
+}// namespace ldb
@@ -1,17 +1,63 @@
 #pragma once
+#include <array>
 #include <elf.h>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include <sys/ptrace.h>
 #include <sys/reg.h>
+#include <sys/user.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include "SymbolTable.h"
 #include "Symbol.h"
+#include "BreakPointCondition.h"
 #include "BreakPointTable.h"
+#include "CodeCoverage.h"
+#include "FunctionProfiler.h"
+#include "HardwareBreakPoints.h"
+#include "InstructionDecoder.h"
+#include "PageWatchPoints.h"
+#include "TraceBuffer.h"
 
 namespace ldb {
 
+  /**
+   * @brief What to do when a break point is hit, directly from the tracer thread
+   * Break points with an action that continues are never reported to the user, so hitting them
+   * costs a few ptrace requests instead of a stop
+   */
+  struct BreakPointAction {
+    // Only the times the condition holds are hits. Otherwise, the process is resumed right away
+    std::optional<BreakPointCondition> condition;
+    // Log every hit, with the first arguments of the function
+    bool log = false;
+    // Resume the process once the action ran, instead of reporting the stop
+    bool auto_continue = true;
+    // Number of hits resumed before the first stop is reported, if the action does not continue
+    uint64_t ignore_count = 0;
+    // Buffer every hit is recorded into, for trace points
+    std::shared_ptr<TraceBuffer> trace;
+    // Profiler every hit starts a call of, on the entry of profiled functions
+    std::shared_ptr<FunctionProfiler> profiler;
+  };
+
+  /**
+   * @brief Message of a break point hit, logged by the caller of the handler
+   */
+  struct BreakPointMessage {
+    bool warning = false;
+    std::string text;
+  };
+
   /**
    * @brief Handle of breakpoints table to give funtions to manipulate it 
    * 
@@ -24,6 +70,33 @@ namespace ldb {
       return breakPoints;
     }
 
+    /**
+     * @brief Returns the break points and watch points set in the debug registers
+     * They are dropped when the process is restarted
+     */
+    HardwareBreakPoints& getHardwareBreakPoints() {
+      return hardware;
+    }
+
+    /**
+     * @brief Returns the watch points set by protecting pages, see PageWatchPoints
+     * They are dropped when the process is restarted
+     */
+    PageWatchPoints& getPageWatchPoints() {
+      return pages;
+    }
+
+    /**
+     * @brief Run a syscall in the process, from the scratch area
+     * The registers of the process are restored afterwards
+     *
+     * @param number number of the syscall
+     * @param args arguments of the syscall
+     * @return The value returned by the syscall, or nothing if it could not run, e.g. because the
+     * scratch area is not set yet
+     */
+    std::optional<int64_t> injectSyscall(long number, const std::array<uint64_t, 6>& args);
+
     /**
      * @brief Adding a break point
      * 
@@ -31,6 +104,15 @@ namespace ldb {
      */
     void add(const Symbol& sym);
 
+    /**
+     * @brief Adding many break points at once, e.g. for coverage
+     * The code is patched a page at a time, and the debug information is not loaded
+     *
+     * @param addrs addresses of the break points. Existing break points are skipped
+     * @return The number of break points set
+     */
+    size_t add(std::span<const Elf64_Addr> addrs);
+
     /**
      * @brief Removing a break point
      * 
@@ -38,22 +120,92 @@ namespace ldb {
      */
     void remove(const Symbol& sym);
 
+    /**
+     * @brief Removing many break points at once
+     *
+     * @param addrs addresses of the break points. Addresses that are not break points are skipped
+     */
+    void remove(std::span<const Elf64_Addr> addrs);
+
     /**
      * @brief Removed all existing break point
-     * 
+     * This also removes the internal and pending break points
      */
     void removeAll();
 
     /**
-     * @brief Save name of existing break point
-     * 
+     * @brief Callback of an internal break point, called from the tracer thread while the process
+     * is stopped on it
+     * Returns true if it changed something the views show, e.g. the loaded libraries
+     */
+    using InternalCallback = std::function<bool()>;
+
+    /**
+     * @brief Adding a break point used by the debugger itself
+     * Internal break points are never reported to the user: the process is resumed once the
+     * callback returns
+     *
+     * @param addr address of break point
+     * @param callback Function to call when the break point is reached
+     */
+    void addInternal(Elf64_Addr addr, InternalCallback callback);
+
+    /**
+     * @brief Remember a break point on a symbol that is not loaded yet
+     * It is set by resolvePending once the symbol appears
+     *
+     * @param name Name of the symbol
+     */
+    void addPending(const std::string& name);
+
+    const std::vector<std::string>& getPending() const {
+      return pending;
+    }
+
+    /**
+     * @brief Set the pending break points whose symbol is now in the table
+     *
+     * @param symbols table of all symbols of child process
+     * @return The number of break points set
+     */
+    size_t resolvePending(const SymbolTable& symbols);
+
+    /**
+     * @brief Turn the break points of an object that is about to be unloaded into pending ones
+     * Their instructions are not restored, since the code is not mapped anymore
+     *
+     * @param symbols table of all symbols of child process, still holding the object
+     * @param object_file Path of the unloaded object
+     */
+    void unloadObject(const SymbolTable& symbols, const std::filesystem::path& object_file);
+
+    /**
+     * @brief A break point of the user, and its action, kept from one execution to the next
+     */
+    struct SavedBreakPoint {
+      // Name of the symbol the break point is in
+      std::string name;
+      // Address of the break point in the previous execution
+      Elf64_Addr address = 0;
+      // The action of the break point if it had one, and its counters
+      std::optional<BreakPointAction> action;
+      uint64_t reached = 0;
+      uint64_t hits = 0;
+    };
+
+    /**
+     * @brief Save the existing break points, with their actions
+     * Internal break points, coverage probes and the return addresses of profiled calls are
+     * skipped: they are set again by their owner
+     *
      * @param symbols table of all symbols of child child process
-     * @return const std::vector<std::string> list of name of break point name
+     * @return The break points, and the pending ones
      */
-    const std::vector<std::string> saveBreakpoints(const SymbolTable& symbols);
+    std::vector<SavedBreakPoint> saveBreakpoints(const SymbolTable& symbols);
 
     /**
      * @brief Update the pid of child process in this class
+     * The break points of the previous process are dropped, save them first
      * 
      * @param pid new pid
      */
@@ -61,25 +213,228 @@ namespace ldb {
 
     /**
      * @brief Rebuild the breakPointTable
+     * Break points whose symbol is not found are kept pending, along with their action.
+     * Actions are set again on the new address of their symbol, with their counters
      * 
      * @param symbols Table of all symbols of child child process
-     * @param old list of break point name to add
+     * @param old break points saved by saveBreakpoints
      */
-    void refreshBreakPoint(const SymbolTable& symbols, const std::vector<std::string>& old);
+    void refreshBreakPoint(const SymbolTable& symbols, const std::vector<SavedBreakPoint>& old);
 
     bool isAtBreakpoint() const;
     bool isBreakPoint(Elf64_Addr addr) const;
 
+    bool isInternalBreakPoint(Elf64_Addr addr) const {
+      return internal.contains(addr);
+    }
+
     /**
-     * @brief Do the process of remove break point, 
-     * step on instruction and submit the break point
-     * 
+     * @brief If the process is stopped on an internal break point, call its callback and step over
+     * it
+     *
+     * @param regs registers of the process when it trapped, clobbered by the step over
+     * @return The value returned by the callback if the process was stopped on an internal break
+     * point, nothing else
+     */
+    std::optional<bool> handleInternalBreakpoint(user_regs_struct& regs);
+
+    /**
+     * @brief Run an action whenever a break point is hit
+     * The break point is set if needed. Removing it removes the action as well
+     *
+     * @param addr address of break point
+     * @param action What to do on every hit
+     */
+    void setAction(Elf64_Addr addr, BreakPointAction action);
+
+    /**
+     * @brief Stop on a break point only when a condition holds, and after some hits
+     * The condition is compiled once, and evaluated by the tracer on every hit
+     *
+     * @param addr address of break point
+     * @param condition Condition over the registers and memory of the process, see
+     * BreakPointCondition. An empty condition always holds
+     * @param ignore_count Number of hits to ignore before stopping
+     * @throw std::runtime_error if the condition is invalid
+     */
+    void setCondition(Elf64_Addr addr, std::string_view condition, uint64_t ignore_count = 0);
+
+    /**
+     * @brief Add a trace point, which records values into a buffer on every hit, and never stops
+     * The buffer is shared with the caller, which reads it while the process runs
+     *
+     * @param addr address of the trace point
+     * @param trace buffer the hits are recorded into
+     */
+    void addTracePoint(Elf64_Addr addr, std::shared_ptr<TraceBuffer> trace);
+
+    /**
+     * @brief Returns the buffer of every trace point, by address
+     */
+    std::map<Elf64_Addr, std::shared_ptr<TraceBuffer>> getTracePoints() const;
+
+    /**
+     * @brief Returns the profiler of every profiled function, by address
+     */
+    std::map<Elf64_Addr, std::shared_ptr<FunctionProfiler>> getProfilePoints() const;
+
+    /**
+     * @brief Profile the calls of a function, without ever stopping
+     * Every call sets a one-shot break point on its return address, see FunctionProfiler
+     *
+     * @param addr address of the function
+     * @param profiler profiler the calls are counted by, shared with the caller
+     */
+    void addProfilePoint(Elf64_Addr addr, std::shared_ptr<FunctionProfiler> profiler);
+
+    /**
+     * @brief Record the code the process reaches, with a one-shot break point on every probe
+     * Probes are set in a single batch, and each one is removed on its first hit. Probes on
+     * existing break points are covered when they are hit, and the break point is kept.
+     *
+     * @param new_coverage probes to set, shared with the caller which reads the coverage
+     * @return The number of break points set
+     */
+    size_t startCoverage(std::shared_ptr<CodeCoverage> new_coverage);
+
+    /**
+     * @brief Remove the probes that were not hit, the coverage is kept by the caller
+     */
+    void stopCoverage();
+
+    const std::shared_ptr<CodeCoverage>& getCoverage() const {
+      return coverage;
+    }
+
+    /**
+     * @brief Remove the action of a break point, which is kept
+     */
+    void clearAction(Elf64_Addr addr);
+
+    /**
+     * @brief Returns the number of times a break point with an action was hit, with its condition
+     * holding
+     */
+    uint64_t getHitCount(Elf64_Addr addr) const;
+
+    /**
+     * @brief If the process is stopped on a break point with an action, run it, and step over the
+     * break point if it continues
+     * The registers are read once by the caller for the whole trap, and used to find the break
+     * point, evaluate its condition and record the hit.
+     *
+     * @param regs registers of the process when it trapped, clobbered by the step over
+     * @return true if the process must be resumed, without reporting the stop
+     * @return false else
+     */
+    bool handleActionBreakpoint(user_regs_struct& regs);
+
+    /**
+     * @brief Returns the messages of the hits handled since the last call, e.g. of log actions
+     * Hits are handled on the tracer thread, which must not use the logger while the GUI does:
+     * the caller logs them from its own thread, see SignalHandler::logMessages()
+     */
+    std::vector<BreakPointMessage> takeMessages() {
+      return std::exchange(messages, {});
+    }
+
+    /**
+     * @brief Step over the break point the process is stopped on
+     *
+     * The original instruction is copied to the scratch area and executed there (displaced
+     * stepping), so the break point stays armed. Instructions without any effect are skipped.
+     * Instructions that cannot be moved, or any instruction before the scratch area is set, are
+     * stepped over in place instead: the original instruction is restored, executed, and the
+     * break point set again.
+     *
+     * @param regs registers of the process when it trapped, clobbered by the step over
      * @return true if all is well
      * @return false else
      */
-    bool resetBreakpoint();
+    bool resetBreakpoint(user_regs_struct& regs);
+
+    /**
+     * @brief Set the area of the process where break points are stepped over
+     * The area must hold kScratchSize bytes of code that is never executed again, such as the
+     * entry point once it was reached. It is forgotten when the pid changes.
+     *
+     * @param addr Start of the area, in the process
+     */
+    void setScratchArea(Elf64_Addr addr);
+
+    static constexpr size_t kScratchSize = 16;
 
   private:
+    /**
+     * @brief Set break points on symbols in a single batch, loading their debug information
+     */
+    void addSymbols(std::span<const Symbol* const> symbols);
+
+    /**
+     * @brief Copy of an instruction, ready to be executed from the scratch area
+     */
+    struct DisplacedInstruction {
+      std::array<uint8_t, kScratchSize> code;
+      uint8_t length = 0;
+      ControlFlow control_flow = ControlFlow::kUnsupported;
+      // False if the instruction can only be stepped over in place
+      bool relocatable = false;
+      // Instructions without any effect (nop, endbr64) are skipped instead of executed
+      bool nop = false;
+      // Register pushed by a push instruction, in encoding order (rax, rcx... r15), which is
+      // emulated when the registers are known
+      std::optional<uint8_t> push_register;
+    };
+
+    /**
+     * @brief Returns the relocated copy of the instruction of a break point, decoding it on the
+     * first call
+     */
+    const DisplacedInstruction& prepareDisplaced(Elf64_Addr addr);
+
+    /**
+     * @brief Step over the break point at the given address, on which the process is stopped
+     * @param regs The registers of the process, if they were already read. Simple instructions
+     * are then emulated instead of executed
+     */
+    void stepOver(Elf64_Addr addr, user_regs_struct* regs = nullptr);
+
+    /**
+     * @brief Execute the instruction of a break point from the scratch area, and move the process
+     * back next to the original instruction
+     * @return False if the instruction must be stepped over in place
+     */
+    bool stepDisplaced(Elf64_Addr addr);
+
+    /**
+     * @brief Execute the instruction at the current address of the process
+     * A signal that stops the process before the instruction runs is sent again, so it is still
+     * reported once the process resumes
+     * @return The status of the process once stepped, as returned by waitpid()
+     */
+    int singleStep();
+
+    /**
+     * @brief Start a call of a profiled function, and set a break point on its return address
+     */
+    void enterProfiled(Elf64_Addr addr, const user_regs_struct& regs,
+                       const std::shared_ptr<FunctionProfiler>& profiler);
+
+    /**
+     * @brief Remove the break points on the return addresses no call of a profiler waits for
+     */
+    void releaseReturnPoints(FunctionProfiler& profiler);
+
+    /**
+     * @brief Set the saved action of a break point on its new address, with its counters
+     */
+    void restoreAction(Elf64_Addr addr, const SavedBreakPoint& saved);
+
+    /**
+     * @brief Drop the action and the instruction copy of a break point, once it was removed
+     */
+    void forgetBreakpoint(Elf64_Addr addr);
+
     /**
      * @brief Restore the good instruction of breakpoint
      * 
@@ -104,7 +459,44 @@ namespace ldb {
 
     pid_t pid;
     BreakPointTable breakPoints;
+    HardwareBreakPoints hardware;
+    PageWatchPoints pages;
+    std::map<Elf64_Addr, InternalCallback> internal;
+    // Name of the symbols of the break points that could not be set yet
+    std::vector<std::string> pending;
+    // Actions of the pending break points, set along with them
+    std::unordered_map<std::string, SavedBreakPoint> pending_actions;
     std::optional<Elf64_Addr> currentAddr;
+
+    std::optional<Elf64_Addr> scratch;
+    // The break point whose instruction is currently copied in the scratch area, if any
+    std::optional<Elf64_Addr> scratch_content;
+    // The scratch area holds a syscall instruction instead, see injectSyscall()
+    bool scratch_syscall = false;
+    // Copies depend on the scratch address, they are dropped when it changes
+    std::unordered_map<Elf64_Addr, DisplacedInstruction> displaced;
+
+    struct ActionState {
+      BreakPointAction action;
+      // Every time the break point was reached, whether the condition holds or not
+      uint64_t reached = 0;
+      uint64_t hits = 0;
+    };
+    std::unordered_map<Elf64_Addr, ActionState> actions;
+
+    struct ReturnPoint {
+      std::shared_ptr<FunctionProfiler> profiler;
+      // False if a break point was already set at the return address, which is then kept
+      bool owned;
+    };
+    // One-shot break points on the return address of the calls of profiled functions
+    std::unordered_map<Elf64_Addr, ReturnPoint> return_points;
+
+    std::shared_ptr<CodeCoverage> coverage;
+    // Break points set for the coverage, which have not been hit yet
+    std::unordered_set<Elf64_Addr> coverage_points;
+
+    std::vector<BreakPointMessage> messages;
   };
 
 }// namespace ldb
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 #include <elf.h>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <span>
 #include <sys/ptrace.h>
+#include <vector>
 #include "SymbolTable.h"
 
 
@@ -10,7 +13,11 @@ namespace ldb {
 
   /**
    * @brief Object contain list of all break points
-   * 
+   *
+   * The table shadows the code of the process: it keeps the original byte under every int3 it
+   * wrote, so break points may be as close to each other as needed. Break points are set and
+   * removed in batches, grouped by page: every page is read and written back once through
+   * RemoteMemory, instead of a PEEKTEXT and a POKETEXT per break point.
    */
   class BreakPointTable {
     friend std::ostream& operator<<(std::ostream& os, const BreakPointTable& table);
@@ -21,7 +28,10 @@ namespace ldb {
     BreakPointTable(const BreakPointTable& other) = delete;
     BreakPointTable& operator=(const BreakPointTable& other) = delete;
 
-    const std::map<Elf64_Addr, unsigned long>& getBreakPoints() const {
+    /**
+     * @brief Returns the original byte of the code under every break point, by address
+     */
+    const std::map<Elf64_Addr, uint8_t>& getBreakPoints() const {
       return breakPoints;
     }
 
@@ -30,8 +40,19 @@ namespace ldb {
      *
      * @param pid pid of process
      * @param addr address of break point
+     * @return true if the break point is set
      */
-    void add(const pid_t pid, const Elf64_Addr addr);
+    bool add(const pid_t pid, const Elf64_Addr addr);
+
+    /**
+     * @brief Adding many break points at once
+     * Addresses that are already break points, or that cannot be written, are skipped
+     *
+     * @param pid pid of process
+     * @param addrs addresses of the break points, in any order
+     * @return The number of break points set
+     */
+    size_t add(const pid_t pid, std::span<const Elf64_Addr> addrs);
 
     /**
      * @brief Removing a break point
@@ -40,8 +61,45 @@ namespace ldb {
      * @param addr address of break point
      */
     void remove(const pid_t pid, const Elf64_Addr addr);
+
+    /**
+     * @brief Removing many break points at once
+     * Addresses that are not break points are skipped
+     *
+     * @param pid pid process
+     * @param addrs addresses of the break points, in any order
+     */
+    void remove(const pid_t pid, std::span<const Elf64_Addr> addrs);
+
     void removeAll();
 
+    /**
+     * @brief Forget a break point without restoring its instruction
+     * Used when the code the break point was in is not mapped anymore
+     *
+     * @param addr address of break point
+     */
+    void forget(const Elf64_Addr addr);
+
+    /**
+     * @brief Restore the original byte of a break point, which is kept in the table
+     * @see enable()
+     */
+    void disable(const pid_t pid, const Elf64_Addr addr);
+
+    /**
+     * @brief Write the int3 of a disabled break point again
+     */
+    void enable(const pid_t pid, const Elf64_Addr addr);
+
+    /**
+     * @brief Replace the int3 of the break points in a copy of the code by the original bytes
+     *
+     * @param addr address the copy was read from
+     * @param code copy of the code of the process
+     */
+    void restoreOriginal(const Elf64_Addr addr, std::span<uint8_t> code) const;
+
     void refresh(const SymbolTable& symbols, const std::vector<std::string>& old);
 
     /**
@@ -53,10 +111,24 @@ namespace ldb {
      */
     const bool isBreakPoint(const Elf64_Addr addr) const;
 
+    static constexpr uint8_t kInt3 = 0xCC;
+
   private:
-    std::map<Elf64_Addr, unsigned long> breakPoints;
+    /**
+     * @brief Rewrite one byte at every given address, a page at a time
+     * Each page is read and written back once, from its first address to its last one
+     *
+     * @param pid pid of process
+     * @param addrs sorted addresses
+     * @param patch Returns the byte to write at an address, given the byte that is there
+     * @return The addresses that could not be patched
+     */
+    static std::vector<Elf64_Addr> patch(const pid_t pid, std::span<const Elf64_Addr> addrs,
+                                         const std::function<uint8_t(Elf64_Addr, uint8_t)>& patch);
+
+    std::map<Elf64_Addr, uint8_t> breakPoints;
   };
 
   std::ostream& operator<<(std::ostream& os, const BreakPointTable& info);
 
-}// namespace ldb
\ No newline at end of file
+}// namespace ldb
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <elf.h>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SymbolTable.h"
+
+namespace ldb {
+
+  /**
+   * @brief Code reached by a process, recorded with one-shot break points
+   *
+   * A probe is set on the entry of every function of an object file, or on every line start the
+   * line table gives. Probes are removed the first time they are hit, so the process only slows
+   * down when it reaches new code, and runs at full speed once it settled. A probe is thus either
+   * covered or not, hits are not counted.
+   *
+   * The probes are set and handled by BreakPointHandler, see BreakPointHandler::startCoverage().
+   */
+  class CodeCoverage {
+  public:
+    enum class Granularity {
+      kFunction,
+      kLine,
+    };
+
+    struct Probe {
+      Elf64_Addr address;
+      // Index of the function the probe is in
+      uint32_t function;
+      // Index of the source file, and line, or 0 if the address has no line information
+      uint32_t file;
+      uint32_t line;
+      bool covered = false;
+    };
+
+    struct Function {
+      std::string name;
+      // Source location of the entry of the function
+      uint32_t file;
+      uint32_t line;
+      // Probes of the function, the first one is its entry
+      size_t first_probe;
+      size_t probe_count;
+    };
+
+    /**
+     * @brief Find the probes of every function of an object file
+     *
+     * @param symbols head of the symbol table chain of the process
+     * @param object_file object file whose code is covered, e.g. the executable
+     * @param granularity probe every function, or every line. Functions of compute units without
+     * a line table only have a probe on their entry
+     */
+    CodeCoverage(const SymbolTable& symbols, const std::filesystem::path& object_file,
+                 Granularity granularity);
+
+    CodeCoverage(const CodeCoverage& other) = delete;
+    CodeCoverage& operator=(const CodeCoverage& other) = delete;
+
+    /**
+     * @brief Returns the address of every probe, sorted
+     */
+    std::vector<Elf64_Addr> getAddresses() const;
+
+    /**
+     * @brief Mark the probe at an address as covered, if there is one
+     * @return true if the probe was not covered yet
+     */
+    bool cover(Elf64_Addr address);
+
+    Granularity getGranularity() const {
+      return granularity;
+    }
+
+    const std::vector<Probe>& getProbes() const {
+      return probes;
+    }
+
+    const std::vector<Function>& getFunctions() const {
+      return functions;
+    }
+
+    const std::filesystem::path& getFile(uint32_t file) const {
+      return files[file];
+    }
+
+    size_t getCoveredProbes() const {
+      return covered;
+    }
+
+    /**
+     * @brief Returns true if the entry of a function was reached
+     */
+    bool isCovered(const Function& function) const {
+      return probes[function.first_probe].covered;
+    }
+
+    /**
+     * @brief Write the covered and uncovered functions and lines, in the lcov tracefile format
+     * Lines are covered if one of their probes is. With function granularity, only the lines of
+     * the entries of the functions are written
+     */
+    bool exportLcov(std::ostream& os) const;
+
+  private:
+    uint32_t getFileIndex(const std::filesystem::path& file);
+
+    std::filesystem::path object_file;
+    Granularity granularity;
+    std::vector<Probe> probes;
+    std::vector<Function> functions;
+    // Index 0 is the unknown file
+    std::vector<std::filesystem::path> files;
+    std::unordered_map<std::string, uint32_t> file_indexes;
+    std::unordered_map<Elf64_Addr, size_t> probe_indexes;
+    size_t covered = 0;
+  };
+
+}// namespace ldb
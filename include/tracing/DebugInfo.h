@@ -31,6 +31,10 @@ namespace ldb {
       shared_libraries.push_back(shlib);
     }
 
+    void removeSharedLibrary(const std::filesystem::path& shlib) {
+      std::erase(shared_libraries, shlib);
+    }
+
     const std::vector<std::filesystem::path>& getSharedLibraries() const {
       return shared_libraries;
     }
@@ -0,0 +1,198 @@
+#pragma once
+#include "DwarfReader.h"
+#include "LineTable.h"
+#include "MappedFile.h"
+#include <elf.h>
+#include <filesystem>
+#include <libdwarf/libdwarf.h>
+#include <libelf.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ldb {
+
+  class SymbolTable;
+
+  /**
+   * @brief Debug information of an object file, decoded one compute unit at a time
+   *
+   * Most of the DWARF data of a process is never looked at. With lazy loading, only the ELF
+   * symbols are read when an object is loaded, and a compute unit is only decoded the first time an
+   * address inside of it is needed (stack trace, source view, breakpoint...).
+   *
+   * Line tables are decoded the same way, the first time an address of their compute unit is
+   * looked up. Decoding the whole object (see loadAll()) spreads the compute units over multiple
+   * threads.
+   *
+   * The object file is only opened on the first request. Addresses are mapped to compute units
+   * using .debug_aranges, or the ranges of the compute units themselves when it is missing.
+   *
+   * This class is thread-safe.
+   */
+  class DwarfModule {
+  public:
+    explicit DwarfModule(std::filesystem::path object_file);
+    ~DwarfModule();
+
+    DwarfModule(const DwarfModule& other) = delete;
+    DwarfModule& operator=(const DwarfModule& other) = delete;
+
+    /**
+     * @brief Returns true if lazy loading is enabled
+     * It is enabled by default, and can be disabled by setting LDB_LAZY_DWARF=0
+     */
+    static bool isLazyLoadingEnabled();
+
+    /**
+     * @brief Decode the compute unit containing the given address, if it was not already
+     * @param addr Address relative to the object file
+     * @param symbols The symbol table of the object, filled with the decoded information
+     * @return True if the address belongs to a decoded compute unit, false otherwise
+     */
+    bool load(Elf64_Addr addr, SymbolTable& symbols);
+
+    /**
+     * @brief Decode every compute unit that was not already
+     * The errors are not logged, since this may run inside the tasks of ELFFile::loadLibraries
+     * @param symbols The symbol table of the object, filled with the decoded information
+     * @return The errors met while decoding the units, empty on success
+     */
+    std::vector<std::string> loadAll(SymbolTable& symbols);
+
+    /**
+     * @brief Returns true if every compute unit was decoded
+     */
+    bool isDecoded();
+
+    /**
+     * @brief Mark every compute unit as decoded, without reading them
+     * Used when the symbols were filled from elsewhere, e.g. the symbol cache
+     */
+    void setDecoded();
+
+    /**
+     * @brief Find the source location of the instruction at the given address
+     * @param addr Address relative to the object file
+     * @return The location, or std::nullopt if the address has no line information
+     */
+    std::optional<SourceLocation> findLocation(Elf64_Addr addr);
+
+    /**
+     * @brief Find the addresses of a line in a source file
+     * This decodes the line table of every compute unit
+     *
+     * @param file Path of the source file. A relative path matches any file ending with it
+     * @param line Line in the source file
+     * @return The addresses starting the line, relative to the object file
+     */
+    std::vector<Elf64_Addr> findAddresses(const std::filesystem::path& file, size_t line);
+
+    /**
+     * @brief Find the addresses where a new line starts, in a range of code of a compute unit
+     * @see LineTable::findLineStarts()
+     *
+     * @param start start of the range, relative to the object file
+     * @param end end of the range, excluded
+     * @return The addresses, relative to the object file
+     */
+    std::vector<Elf64_Addr> findLineStarts(Elf64_Addr start, Elf64_Addr end);
+
+    const std::filesystem::path& getObjectFile() const {
+      return object_file;
+    }
+
+  private:
+    /**
+     * @brief Open the object file and index its compute units, on the first call only
+     * @return True if the debug information is available, false otherwise
+     */
+    bool open();
+
+    /**
+     * @brief Fill the ranges from .debug_aranges
+     * @return False if the section is missing
+     */
+    bool readAranges();
+
+    /**
+     * @brief Fill the ranges from the DW_AT_low_pc / DW_AT_high_pc or DW_AT_ranges of every
+     * compute unit. Units without such attributes can only be decoded by loadAll
+     */
+    void readUnitRanges();
+
+    /**
+     * @brief Fill the ranges from the DW_AT_ranges attribute of a compute unit, if it has one
+     */
+    void readRangeList(Dwarf_Die cu_die, Dwarf_Off cu_offset);
+
+    // DWARF 4 and earlier, the attribute is an offset in .debug_ranges
+    void readDebugRanges(Dwarf_Die cu_die, Dwarf_Attribute attr, Dwarf_Off cu_offset);
+
+    // DWARF 5, the attribute is an offset in .debug_rnglists, or an index in its offsets table
+    void readRngLists(Dwarf_Attribute attr, Dwarf_Half form, Dwarf_Off cu_offset);
+
+    /**
+     * @brief Find the compute unit containing the given address
+     * @return The offset of the compute unit, or std::nullopt if none covers the address
+     */
+    std::optional<Dwarf_Off> findUnit(Elf64_Addr addr) const;
+
+    // Must be called with the mutex held
+    void decode(Dwarf_Off cu_offset, SymbolTable& symbols);
+
+    struct UnitResult {
+      std::vector<DwarfFunction> functions;
+      // Empty if the unit was decoded successfully
+      std::string error;
+    };
+
+    /**
+     * @brief Decode a compute unit without touching the symbols
+     * Only the given handle is used, so this can run concurrently with one handle per thread
+     */
+    UnitResult readUnit(Dwarf_Debug handle, Dwarf_Off cu_offset);
+
+    /**
+     * @brief Merge a decoded compute unit into the symbols
+     * Must be called with the mutex held
+     * @return The error met while decoding the unit, empty on success
+     */
+    std::string merge(UnitResult&& result, SymbolTable& symbols);
+
+    /**
+     * @brief Returns the line table of a compute unit, decoding it on the first call
+     * Must be called with the mutex held
+     */
+    const LineTable* getLineTable(Dwarf_Off cu_offset);
+
+    struct UnitRange {
+      Elf64_Addr start;
+      Elf64_Addr end;
+      // Offset of the compute unit entry in .debug_info
+      Dwarf_Off cu_offset;
+    };
+
+    std::mutex mutex;
+    std::filesystem::path object_file;
+
+    std::unique_ptr<MappedFile> file;
+    Elf* elf = nullptr;
+    Dwarf_Debug dbg = nullptr;
+    bool is_open = false;
+
+    // Sorted by start address
+    std::vector<UnitRange> ranges;
+    // Every compute unit, whether it has a range or not
+    std::vector<Dwarf_Off> units;
+    std::unordered_set<Dwarf_Off> decoded;
+    bool all_decoded = false;
+    // A unit without line information is kept as an empty table, so it is only read once
+    std::unordered_map<Dwarf_Off, std::unique_ptr<LineTable>> line_tables;
+  };
+
+}// namespace ldb
@@ -5,6 +5,7 @@
 #include <libdwarf/dwarf.h>
 #include <libdwarf/libdwarf.h>
 #include <map>
+#include <unordered_map>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -17,11 +18,47 @@
 namespace ldb {
 
   /**
-   * @brief Read dwarf information and fill the DebutInfo 
-   * 
-   * @param elf elf object
-   * @param db structure DebugInfo to complit
+   * @brief Debug information of a function, as decoded from its compute unit
+   * It is matched with the ELF symbol of the same name once merged in a symbol table.
    */
-  void readDwarfDebugInfo(Elf* elf, DebugInfo& db);
+  struct DwarfFunction {
+    std::string name;
+    std::string file;
+    TypeId type = TypeTable::kUnknown;
+    size_t line = 0;
+    // 0 if the entry has no address range
+    Elf64_Xword size = 0;
+    std::vector<Variable> args;
+    std::vector<Variable> vars;
+  };
+
+  /**
+   * @brief Decode the functions of a single compute unit
+   * This only touches the given handle, so units can be decoded concurrently as long as every
+   * thread uses its own handle.
+   *
+   * @param dbg initialized debug handle
+   * @param cu_offset offset of the compute unit entry in .debug_info
+   * @return The functions defined in the compute unit
+   */
+  std::vector<DwarfFunction> decodeDwarfUnit(Dwarf_Debug dbg, Dwarf_Off cu_offset);
+
+  /**
+   * @brief Fill the symbols of an object with the decoded functions
+   * Functions without a matching symbol in the object are ignored.
+   *
+   * @param functions functions decoded from the object
+   * @param symbols symbol table of the object
+   */
+  void mergeDwarfFunctions(std::vector<DwarfFunction>&& functions, SymbolTable& symbols);
+
+  /**
+   * @brief Read a single compute unit and fill the symbols it describes
+   *
+   * @param dbg initialized debug handle
+   * @param cu_offset offset of the compute unit entry in .debug_info
+   * @param symbols symbol table of the object, the compute unit comes from
+   */
+  void readDwarfUnit(Dwarf_Debug dbg, Dwarf_Off cu_offset, SymbolTable& symbols);
 
 }// namespace ldb
\ No newline at end of file
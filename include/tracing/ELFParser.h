@@ -1,14 +1,21 @@
 #pragma once
 #include "DebugInfo.h"
+#include "LinkMap.h"
+#include "MappedFile.h"
+#include "ModulePool.h"
+#include "ObjectId.h"
 #include "Process.h"
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <libelf.h>
 #include <memory>
 #include <optional>
+#include <span>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -22,10 +29,12 @@ namespace ldb {
   public:
     /**
      * @brief Builds a new ELFFile object and parses static symbols from the file
-     * This functions does not parse dwarf nor dynamic symbols.
+     * This functions does not parse dynamic symbols.
      * @param elf_path
+     * @param reusable Symbol tables of a previous execution. If the object is found in this pool,
+     * its table is adopted instead of being parsed again
      */
-    explicit ELFFile(const fs::path& elf_path);
+    explicit ELFFile(const fs::path& elf_path, ModulePool* reusable = nullptr);
 
     ~ELFFile();
 
@@ -41,8 +50,37 @@ namespace ldb {
      * object This function does not check the given process is associated  with this ELFFile
      * object. If this is not the case, this is considered undefined behaviour.
      * @param process
+     * @param reusable Symbol tables of a previous execution, that unchanged libraries may adopt
      */
-    bool parseDynamicSymbols(Process& process);
+    bool parseDynamicSymbols(Process& process, ModulePool* reusable = nullptr);
+
+    /**
+     * @brief Parse the given shared libraries in parallel
+     * @param libraries The libraries to parse
+     * @param debug_info The debug information the libraries are registered in
+     * @param reusable Symbol tables of a previous execution, that unchanged libraries may adopt
+     * @return The relocated symbol tables of the libraries, joined in the given order, or nullptr
+     * if no library could be parsed
+     */
+    static std::unique_ptr<SymbolTable> loadLibraries(const std::vector<LinkMapEntry>& libraries,
+                                                      DebugInfo& debug_info,
+                                                      ModulePool* reusable = nullptr);
+
+    /**
+     * @brief Returns the mirror of the link map built by parseDynamicSymbols
+     * It can be used to follow the libraries loaded and unloaded later on
+     */
+    const LinkMap& getLinkMap() const {
+      return link_map;
+    }
+
+    /**
+     * @brief Relocate the symbols of a position independent executable to its load address
+     * The load address is deduced from the entry point found in the auxiliary vector of the
+     * process. This must be called before parsing the dynamic symbols.
+     * @param process The process running this executable
+     */
+    void relocateExecutable(const Process& process);
 
     bool hasSymbolTable() const {
       return debug_info and debug_info->getSymbolTable();
@@ -56,76 +94,93 @@ namespace ldb {
       return debug_info.get();
     }
 
+    /**
+     * @brief Returns the identity of the parsed object
+     */
+    const ObjectId& getObjectId() const {
+      return object_id;
+    }
+
+    /**
+     * @brief Returns the errors that did not prevent the object from being parsed
+     * They are not logged by the constructor, which may run inside the tasks of loadLibraries
+     */
+    const std::vector<std::string>& getWarnings() const {
+      return warnings;
+    }
+
   private:
     /**
-     * @brief Load the entire file into memory
-     * 
-     * @param elf_path path 
+     * @brief Check the ELF header found at the beginning of the mapping
+     * Throws if the file is not a 64 bits ELF file
      */
-    void loadIntoMemory(const fs::path& elf_path);
+    void parseHeader();
 
     /**
-     * @brief Parse a string table from memory
-     * 
-     * @param str_header String table header
-     * @return std::string the string table content
+     * @brief Search the NT_GNU_BUILD_ID note of the object
+     * @return The raw build-id, or an empty string if the object has none
      */
-    std::string parseStringTable(const Elf64_Shdr& str_header);
+    std::string parseBuildId() const;
 
     /**
-     * @brief Fill the sections vector
-     * 
-     * @return true
-     * @return false 
+     * @brief Returns true if the object has a section with the given name
      */
-    bool parseSections();
+    bool hasSection(std::string_view name) const;
 
     /**
-     * @brief Read string in the process memory
+     * @brief Try to load the symbols of this object from the symbol cache
+     * @return True if the symbols were found in the cache, false otherwise
+     */
+    bool loadFromCache();
+
+    /**
+     * @brief Try to adopt the symbols of this object from the tables of a previous execution
+     * @return True if the object was found in the pool, false otherwise
+     */
+    bool loadFromPool(ModulePool& pool);
+
+    /**
+     * @brief Keep the errors met while decoding the DWARF of this object, to be reported later
+     */
+    void addDwarfWarnings(std::vector<std::string>&& errors);
+
+    /**
+     * @brief Returns a view of a string table inside the mapping
      * 
-     * @param process porcess to parse
-     * @param str_addr address of the string
-     * @return std::string string read
+     * @param str_header String table header
+     * @return std::string_view the string table content, or an empty view on failure
      */
-    static std::string parseLiveString(Process& process, Elf64_Addr str_addr);
+    std::string_view parseStringTable(const Elf64_Shdr& str_header) const;
 
     /**
-     * @brief 
+     * @brief Point the sections view to the section headers inside the mapping
      * 
-     * @param process 
-     * @param link_map_addr 
-     * @return std::vector<std::pair<Elf64_Addr, std::string>> 
+     * @return true
+     * @return false 
      */
-    std::vector<std::pair<Elf64_Addr, std::string>> parseLinkMap(Process& process,
-                                                                 Elf64_Addr link_map_addr);
+    bool parseSections();
 
     // Fill the symbols table
     void parseSymbols();
 
-    // Locate the link map of the given process
-    Elf64_Addr locateLinkMap(const Process& process);
+    // Locate the r_debug structure of the given process
+    Elf64_Addr locateRendezvous(const Process& process);
 
-    Elf64_Ehdr* header;
-    std::unique_ptr<char[]> data;
-    size_t data_size = 0;
+    // Every view below points into this mapping, which must outlive them
+    MappedFile file;
+    const Elf64_Ehdr* header = nullptr;
 
     std::filesystem::path elf_path;
+    ObjectId object_id;
+    // Difference between the addresses of the file and the ones of the process
+    Elf64_Addr load_bias = 0;
 
     std::unique_ptr<DebugInfo> debug_info;
-    std::vector<Elf64_Shdr> sections;
+    std::span<const Elf64_Shdr> sections;
+    LinkMap link_map;
+    std::vector<std::string> warnings;
 
     bool badbit;
   };
 
-
-  /**
-   * @brief Convert a address to a line in file
-   * 
-   * @param path 
-   * @param addr 
-   * @return std::optional<std::pair<std::string, size_t>> 
-   */
-  std::optional<std::pair<std::string, size_t>> addr2Line(const std::filesystem::path& path,
-                                                          const Elf64_Addr addr);
-
 }// namespace ldb
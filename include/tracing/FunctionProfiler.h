@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <elf.h>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <sys/user.h>
+#include <unordered_map>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "RemoteMemory.h"
+
+namespace ldb {
+
+  /**
+   * @brief Call counts and latency histograms of a set of functions, measured with break points
+   *
+   * The entry of every profiled function is a break point. When it is hit, the return address is
+   * read from the top of the stack, and a one-shot break point is set there: hitting it ends the
+   * call. Calls are kept in a shadow stack, along with the stack pointer at their entry, which
+   * tells apart the frames of a recursive function sharing a return address. Calls whose frame is
+   * popped without returning, by a longjmp or an exception, are dropped once the stack goes above
+   * them.
+   *
+   * Durations are measured by the tracer, and thus include the cost of a break point stop. Only
+   * the main thread of the process is profiled. Like TraceBuffer, the profiler is updated by the
+   * tracer thread, and read by the views with the tracer locked.
+   */
+  class FunctionProfiler {
+  public:
+    struct Function {
+      std::string name;
+      uint64_t calls = 0;
+      // Calls left without returning
+      uint64_t unwound = 0;
+      // Calls that are running, more than one for a recursive function
+      uint32_t depth = 0;
+      uint32_t max_depth = 0;
+      // Duration of the calls that returned, in nanoseconds
+      LatencyHistogram latency;
+    };
+
+    /**
+     * @brief Name a function, before it is profiled
+     * Functions that were not named are shown with their address
+     */
+    void addFunction(Elf64_Addr entry, std::string name);
+
+    /**
+     * @brief Keep the statistics of a function whose entry moved, when the process is restarted
+     * Nothing is done if a function is already profiled at the new address
+     */
+    void moveFunction(Elf64_Addr entry, Elf64_Addr new_entry);
+
+    /**
+     * @brief Start a call, when the process is stopped on the entry of a function
+     * @param entry address of the function
+     * @param regs registers of the process, whose stack pointer points to the return address
+     * @return The return address, if it needs a break point. Otherwise, one is already set there
+     */
+    std::optional<Elf64_Addr> enter(Elf64_Addr entry, const user_regs_struct& regs,
+                                    const RemoteMemory& memory);
+
+    /**
+     * @brief End the calls returning to an address, when the process is stopped on it
+     * @return true if a call returned, false if the address was reached some other way
+     */
+    bool leave(Elf64_Addr return_address, const user_regs_struct& regs);
+
+    /**
+     * @brief Returns the return addresses no call is waiting for anymore, whose break point must
+     * be removed, and forget them
+     */
+    std::vector<Elf64_Addr> takeReleased();
+
+    /**
+     * @brief Drop the running calls, when the process is restarted
+     * Their break points are not released, since they are gone with the process
+     */
+    void clearCalls();
+
+    /**
+     * @brief Reset the statistics of every function, the running calls are kept
+     */
+    void clear();
+
+    const std::map<Elf64_Addr, Function>& getFunctions() const {
+      return functions;
+    }
+
+    /**
+     * @brief Write one line per function with its count and latency percentiles, in nanoseconds
+     */
+    bool exportCsv(std::ostream& os) const;
+
+    /**
+     * @brief Same as exportCsv, as an array of JSON objects
+     */
+    bool exportJson(std::ostream& os) const;
+
+    /**
+     * @brief Percentiles of the latency shown and exported
+     */
+    static constexpr double kPercentiles[] = {50, 90, 99};
+
+  private:
+    struct Call {
+      Elf64_Addr function;
+      Elf64_Addr return_address;
+      // Stack pointer at the entry of the function, which points to the return address
+      uint64_t stack;
+      uint64_t start;
+    };
+
+    Function& getFunction(Elf64_Addr entry);
+
+    /**
+     * @brief Pop the last call, recording its duration if it returned
+     */
+    void pop(std::optional<uint64_t> end);
+
+    std::map<Elf64_Addr, Function> functions;
+    std::vector<Call> calls;
+    // Number of running calls returning to every address with a break point
+    std::unordered_map<Elf64_Addr, uint32_t> returns;
+    std::vector<Elf64_Addr> released;
+  };
+
+}// namespace ldb
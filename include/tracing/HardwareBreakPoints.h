@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <elf.h>
+#include <optional>
+#include <sys/types.h>
+
+namespace ldb {
+
+  /**
+   * @brief Break points and watch points set in the debug registers of the CPU
+   *
+   * DR0 to DR3 hold up to four addresses, and DR7 tells whether each one traps on execution, on
+   * writes, or on reads and writes, of 1, 2, 4 or 8 bytes. The process runs at full speed, and the
+   * CPU raises a SIGTRAP when it hits one of them: after the access for data, and before the
+   * instruction for execution. DR6 then tells which one it was.
+   *
+   * The registers are written with PTRACE_POKEUSER, so every method must be called from the tracer
+   * thread, while the process is stopped.
+   */
+  class HardwareBreakPoints {
+  public:
+    // Encoding of the RW bits of DR7
+    enum class Type : uint8_t {
+      kExecute = 0b00,
+      kWrite = 0b01,
+      kReadWrite = 0b11,
+    };
+
+    struct WatchPoint {
+      Elf64_Addr address;
+      Type type;
+      uint8_t size;
+    };
+
+    static constexpr size_t kCount = 4;
+
+    explicit HardwareBreakPoints(pid_t pid) : pid(pid) {}
+
+    HardwareBreakPoints(const HardwareBreakPoints& other) = delete;
+    HardwareBreakPoints& operator=(const HardwareBreakPoints& other) = delete;
+
+    /**
+     * @brief Set a hardware break point or watch point in a free debug register
+     *
+     * @param address watched address, aligned on size
+     * @param type accesses that trigger it
+     * @param size watched bytes: 1, 2, 4 or 8. Always 1 for kExecute
+     * @return The index of the debug register used
+     * @throw std::runtime_error if the four registers are used, or the watch point is invalid
+     */
+    size_t add(Elf64_Addr address, Type type, uint8_t size = 1);
+
+    /**
+     * @brief Clear a debug register
+     * @param index index of the register, as returned by add()
+     */
+    void remove(size_t index);
+
+    void removeAll();
+
+    /**
+     * @brief Drop the watch points, without writing to the registers
+     * Used when the process is restarted: addresses may have changed, and the new process starts
+     * with clear registers
+     */
+    void reset(pid_t new_pid);
+
+    const std::optional<WatchPoint>& at(size_t index) const {
+      return watch_points[index];
+    }
+
+    bool isEmpty() const {
+      return dr7 == 0;
+    }
+
+    /**
+     * @brief Read and clear DR6, after a SIGTRAP
+     * @return The index of the watch point that triggered the trap, if any
+     */
+    std::optional<size_t> takeTriggered();
+
+    static const char* getTypeName(Type type);
+
+  private:
+    bool writeRegister(size_t index, uint64_t value);
+
+    pid_t pid;
+    std::array<std::optional<WatchPoint>, kCount> watch_points;
+    uint64_t dr7 = 0;
+  };
+
+}// namespace ldb
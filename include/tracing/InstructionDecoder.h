@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace ldb {
+
+  /**
+   * @brief What an x86-64 instruction does to the control flow, as far as relocating it matters
+   */
+  enum class ControlFlow : uint8_t {
+    // Continues with the next instruction
+    kNone,
+    // jmp/jcc/loop to a target relative to the next instruction
+    kRelativeBranch,
+    // call to a target relative to the next instruction
+    kRelativeCall,
+    // jmp through a register or memory, or ret: the target is absolute
+    kAbsoluteBranch,
+    // call through a register or memory
+    kAbsoluteCall,
+    // Anything that cannot be moved: system calls, interrupts, far transfers, transactions...
+    kUnsupported,
+  };
+
+  /**
+   * @brief Layout of a decoded x86-64 instruction
+   */
+  struct InstructionInfo {
+    // Size of the instruction in bytes, prefixes included
+    uint8_t length = 0;
+    ControlFlow control_flow = ControlFlow::kNone;
+    // Offset of the 32 bits displacement of a RIP-relative operand, if there is one
+    std::optional<uint8_t> rip_displacement;
+  };
+
+  /**
+   * @brief Decode the layout of the x86-64 instruction at the start of a buffer
+   *
+   * This only finds the length of the instruction and how it depends on its own address, which is
+   * what moving it elsewhere requires. The operands themselves are not decoded.
+   *
+   * @param code The bytes of the instruction. 15 bytes are enough for any instruction
+   * @return The instruction layout, or std::nullopt if the bytes are not a valid 64 bits
+   * instruction, or the buffer is too short
+   */
+  std::optional<InstructionInfo> decodeInstruction(std::span<const uint8_t> code);
+
+}// namespace ldb
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace ldb {
+
+  /**
+   * @brief Histogram of durations with a bounded relative error, in the style of HdrHistogram
+   *
+   * Values below 2^kPrecisionBits are counted exactly. Above, every power of two is split into
+   * 2^(kPrecisionBits - 1) buckets of the same width, so a value is known within 1/128 of itself
+   * whatever its magnitude. Recording a value is a few bit operations, and the buckets are
+   * allocated once.
+   */
+  class LatencyHistogram {
+  public:
+    static constexpr uint32_t kPrecisionBits = 8;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    void clear();
+
+    uint64_t getCount() const {
+      return count;
+    }
+
+    uint64_t getMin() const {
+      return count ? min : 0;
+    }
+
+    uint64_t getMax() const {
+      return max;
+    }
+
+    double getMean() const {
+      return count ? double(sum) / double(count) : 0;
+    }
+
+    /**
+     * @brief Returns the value below which the given percentage of the values are
+     * The value is the highest one of its bucket, so it is never lower than the exact percentile
+     *
+     * @param percentile between 0 and 100
+     */
+    uint64_t getPercentile(double percentile) const;
+
+  private:
+    static constexpr uint32_t kHalfBuckets = 1 << (kPrecisionBits - 1);
+    // Exact values, then a half of the buckets for every other power of two
+    static constexpr uint32_t kBucketCount = (66 - kPrecisionBits) * kHalfBuckets;
+
+    static uint32_t getBucket(uint64_t value);
+
+    /**
+     * @brief Returns the highest value counted in a bucket
+     */
+    static uint64_t getHighestValue(uint32_t bucket);
+
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+  };
+
+}// namespace ldb
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <elf.h>
+#include <filesystem>
+#include <libdwarf/libdwarf.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ldb {
+
+  /**
+   * @brief A position in a source file
+   */
+  struct SourceLocation {
+    std::filesystem::path file;
+    size_t line = 0;
+    // 0 when the compiler did not record it
+    size_t column = 0;
+  };
+
+  /**
+   * @brief The line number program of a compute unit, decoded from .debug_line
+   *
+   * Rows are sorted by address, so an address is mapped to its line with a binary search.
+   * Addresses are relative to the object file.
+   */
+  class LineTable {
+  public:
+    /**
+     * @brief Decode the line table of a compute unit
+     * @param dbg initialized debug handle
+     * @param cu_die debug information entry of the compute unit
+     */
+    LineTable(Dwarf_Debug dbg, Dwarf_Die cu_die);
+
+    bool isEmpty() const {
+      return rows.empty();
+    }
+
+    /**
+     * @brief Find the source location of the instruction at the given address
+     * @param addr Address relative to the object file
+     * @return The location, or std::nullopt if the address is not covered by this table
+     */
+    std::optional<SourceLocation> find(Elf64_Addr addr) const;
+
+    /**
+     * @brief Find the addresses of the instructions that start a line
+     * A line may be split into multiple blocks of code (loops, inlining...): the first address of
+     * every block is returned.
+     *
+     * @param file Path of the source file. A relative path matches any file ending with it
+     * @param line Line in the source file
+     * @return The matching addresses, relative to the object file, sorted
+     */
+    std::vector<Elf64_Addr> findAddresses(const std::filesystem::path& file, size_t line) const;
+
+    /**
+     * @brief Find the addresses where a new line starts, in a range of code
+     * Every block of a line is counted, as in findAddresses(). This is the finest split of the code
+     * the line table gives, close to its basic blocks.
+     *
+     * @param start start of the range, relative to the object file
+     * @param end end of the range, excluded
+     * @return The addresses, sorted
+     */
+    std::vector<Elf64_Addr> findLineStarts(Elf64_Addr start, Elf64_Addr end) const;
+
+    /**
+     * @brief Returns true if the given file matches one of the files of this table
+     * See findAddresses() for the matching rules
+     */
+    bool hasFile(const std::filesystem::path& file) const;
+
+  private:
+    struct Row {
+      Elf64_Addr address;
+      uint32_t file;
+      uint32_t line;
+      uint32_t column;
+      bool is_stmt;
+      // The address is the first one past the end of a sequence, and does not belong to it
+      bool end_sequence;
+    };
+
+    /**
+     * @brief Returns, for every file of the table, whether it matches the given path
+     */
+    std::vector<bool> matchFiles(const std::filesystem::path& file) const;
+
+    std::vector<Row> rows;
+    std::vector<std::string> files;
+  };
+
+}// namespace ldb
@@ -0,0 +1,88 @@
+#pragma once
+#include "RemoteMemory.h"
+#include <elf.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ldb {
+
+  /**
+   * @brief A shared object found in the link map of the process
+   */
+  struct LinkMapEntry {
+    // Address of the link_map node in the process
+    Elf64_Addr node;
+    // Load address of the object
+    Elf64_Addr base;
+    // Address of the path of the object in the process
+    Elf64_Addr name_address;
+    std::string path;
+
+    bool operator==(const LinkMapEntry& other) const {
+      return node == other.node and base == other.base and path == other.path;
+    }
+  };
+
+  /**
+   * @brief Mirror of the list of shared objects loaded by the dynamic loader
+   *
+   * The loader exposes the list through the r_debug rendezvous structure, and calls r_brk each time
+   * it is about to change, and once again when it is consistent. The mirror is updated
+   * incrementally: only the nodes are read again, the paths are only read for new objects.
+   */
+  class LinkMap {
+  public:
+    /**
+     * @brief Changes of the link map since the last update
+     */
+    struct Delta {
+      std::vector<LinkMapEntry> added;
+      std::vector<LinkMapEntry> removed;
+
+      bool isEmpty() const {
+        return added.empty() and removed.empty();
+      }
+    };
+
+    LinkMap() = default;
+
+    /**
+     * @brief Builds an empty mirror of the link map
+     * @param rendezvous Address of the r_debug structure in the process
+     */
+    explicit LinkMap(Elf64_Addr rendezvous) : rendezvous(rendezvous) {}
+
+    bool isValid() const {
+      return rendezvous != 0;
+    }
+
+    /**
+     * @brief Returns the address of the function the loader calls on every change (r_brk)
+     * @return The address, or an empty optional if it could not be read
+     */
+    std::optional<Elf64_Addr> getBreakAddress(const RemoteMemory& memory) const;
+
+    /**
+     * @brief Returns true if the loader is not in the middle of a change (r_state is RT_CONSISTENT)
+     */
+    bool isConsistent(const RemoteMemory& memory) const;
+
+    /**
+     * @brief Walk the link map of the process, and update the mirror
+     * The executable itself, and objects without a file (e.g. the vdso) are not part of the mirror
+     * @return The objects that were loaded and unloaded since the last update
+     */
+    Delta update(const RemoteMemory& memory);
+
+    const std::vector<LinkMapEntry>& getEntries() const {
+      return entries;
+    }
+
+  private:
+    Elf64_Addr rendezvous = 0;
+    // In link map order
+    std::vector<LinkMapEntry> entries;
+  };
+
+}// namespace ldb
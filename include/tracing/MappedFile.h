@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace ldb {
+
+  /**
+   * @brief RAII handle over a private memory mapping of a file
+   *
+   * The file is mapped once and never copied: every view handed out by this class points directly
+   * into the mapping, so only the pages that are actually touched are read from the disk.
+   * The file itself is opened read-only, and the mapping is private, meaning that nothing done
+   * through this object can ever reach the underlying file.
+   */
+  class MappedFile {
+  public:
+    /**
+     * @brief Map the given file into memory
+     * Throws a std::runtime_error if the file cannot be opened or mapped
+     * @param path Path of the file to map
+     */
+    explicit MappedFile(const std::filesystem::path& path);
+
+    ~MappedFile();
+
+    /**
+     * @brief A mapping should not be copyable, since it owns the underlying memory
+     */
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const std::filesystem::path& getPath() const {
+      return path;
+    }
+
+    /**
+     * @brief Returns the status of the file, as it was when it was mapped
+     */
+    const struct stat& getStat() const {
+      return status;
+    }
+
+    char* data() {
+      return static_cast<char*>(address);
+    }
+
+    const char* data() const {
+      return static_cast<const char*>(address);
+    }
+
+    size_t size() const {
+      return length;
+    }
+
+    /**
+     * @brief Returns true if the range [offset, offset + count) lies inside the mapping
+     */
+    bool contains(size_t offset, size_t count) const {
+      return offset <= length and count <= length - offset;
+    }
+
+    /**
+     * @brief Returns a typed view of @count objects stored at the given offset
+     * @return A pointer into the mapping, or nullptr if the range is out of bounds
+     */
+    template<typename T>
+    const T* at(size_t offset, size_t count = 1) const {
+      if (count > length / sizeof(T) or not contains(offset, count * sizeof(T))) return nullptr;
+      return reinterpret_cast<const T*>(data() + offset);
+    }
+
+    /**
+     * @brief Returns a view of @count bytes stored at the given offset
+     * @return A view into the mapping, or an empty view if the range is out of bounds
+     */
+    std::string_view view(size_t offset, size_t count) const {
+      if (not contains(offset, count)) return {};
+      return {data() + offset, count};
+    }
+
+  private:
+    void unmap();
+
+    std::filesystem::path path;
+    struct stat status = {};
+    void* address = nullptr;
+    size_t length = 0;
+  };
+
+}// namespace ldb
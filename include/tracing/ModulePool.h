@@ -0,0 +1,47 @@
+#pragma once
+#include "ObjectId.h"
+#include "SymbolTable.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ldb {
+
+  /**
+   * @brief Symbol tables of a previous execution, that may be reused by the next one
+   *
+   * When a process is restarted, most of its objects did not change: only their load address
+   * may differ. The pool splits the symbol table of the previous execution into one table per
+   * object, so the ELF parser can adopt the tables of the unchanged objects instead of parsing
+   * them again.
+   *
+   * Tables are taken concurrently by the tasks parsing the shared libraries.
+   */
+  class ModulePool {
+  public:
+    /**
+     * @brief Split a chain of symbol tables into one table per object
+     * Tables with no identity are dropped, since they cannot be matched against a new object
+     * @param chain The symbol table of the previous execution
+     */
+    explicit ModulePool(std::unique_ptr<SymbolTable> chain);
+
+    ModulePool(const ModulePool& other) = delete;
+    ModulePool& operator=(const ModulePool& other) = delete;
+
+    /**
+     * @brief Remove the table of the given object from the pool
+     * @param id The identity of the object
+     * @return The table of the object, or nullptr if the object is not in the pool
+     */
+    std::unique_ptr<SymbolTable> take(const ObjectId& id);
+
+    size_t getSize() const;
+
+  private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<SymbolTable>> modules;
+  };
+
+}// namespace ldb
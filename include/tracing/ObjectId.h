@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <sys/stat.h>
+
+namespace ldb {
+
+  /**
+   * @brief Identifies the exact content of an object file
+   *
+   * Two objects with the same identity are guaranteed to hold the same symbols. The identity is
+   * based on the GNU build-id when the object has one. Otherwise, we fall back to the path of the
+   * file, its inode and its last modification time.
+   */
+  class ObjectId {
+  public:
+    ObjectId() = default;
+
+    /**
+     * @brief Build the identity of an object file
+     * @param build_id The raw content of the NT_GNU_BUILD_ID note, or an empty string if the object
+     * has none
+     * @param path Path of the object file
+     * @param status Status of the object file, used when there is no build-id
+     */
+    ObjectId(const std::string& build_id, const std::filesystem::path& path,
+             const struct stat& status);
+
+    bool hasBuildId() const {
+      return has_build_id;
+    }
+
+    /**
+     * @brief Returns a string that uniquely represents this identity, usable as a file name
+     */
+    const std::string& getKey() const {
+      return key;
+    }
+
+    bool isValid() const {
+      return not key.empty();
+    }
+
+    bool operator==(const ObjectId& other) const {
+      return key == other.key;
+    }
+
+    bool operator!=(const ObjectId& other) const {
+      return not(*this == other);
+    }
+
+  private:
+    std::string key;
+    bool has_build_id = false;
+  };
+
+}// namespace ldb
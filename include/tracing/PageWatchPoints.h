@@ -0,0 +1,130 @@
+#pragma once
+#include "HardwareBreakPoints.h"
+#include <array>
+#include <cstdint>
+#include <elf.h>
+#include <functional>
+#include <map>
+#include <optional>
+#include <sys/types.h>
+
+namespace ldb {
+
+  /**
+   * @brief Watch points of any size and number, set by protecting the pages they are in
+   *
+   * The pages of a watched region are made read-only (or inaccessible, to watch reads as well) with
+   * mprotect syscalls injected into the process, which then runs at full speed until it touches
+   * one of them. The resulting SIGSEGV is handled by the tracer: the page is opened, the faulting
+   * instruction stepped, and the page protected again. The access is only reported if it touched
+   * a watched region, and not some other data of the same page.
+   *
+   * Changes to the protection of the pages made by the process itself are not tracked. Every
+   * method must be called from the tracer thread, while the process is stopped.
+   */
+  class PageWatchPoints {
+  public:
+    using Type = HardwareBreakPoints::Type;
+
+    struct WatchPoint {
+      Elf64_Addr address;
+      size_t size;
+      Type type;
+    };
+
+    /**
+     * @brief Result of handleFault()
+     */
+    struct Fault {
+      // The fault was caused by a watched page, and the access was let through
+      bool handled = false;
+      // The watch point the access touched, if any
+      std::optional<size_t> watch_point;
+      // Address of the access
+      Elf64_Addr address = 0;
+    };
+
+    /**
+     * @brief Runs a syscall in the process, and returns its result if it could run
+     */
+    using SyscallInjector = std::function<std::optional<int64_t>(
+            long number, const std::array<uint64_t, 6>& args)>;
+
+    PageWatchPoints(pid_t pid, SyscallInjector syscall) : pid(pid), syscall(std::move(syscall)) {}
+
+    PageWatchPoints(const PageWatchPoints& other) = delete;
+    PageWatchPoints& operator=(const PageWatchPoints& other) = delete;
+
+    /**
+     * @brief Watch a region of memory
+     *
+     * @param address start of the region
+     * @param size size of the region, in bytes
+     * @param type kWrite or kReadWrite
+     * @return The id of the watch point
+     * @throw std::runtime_error if the region is not mapped, or its pages cannot be protected
+     */
+    size_t add(Elf64_Addr address, size_t size, Type type = Type::kWrite);
+
+    /**
+     * @brief Stop watching a region, its pages get their protection back
+     */
+    void remove(size_t id);
+
+    void removeAll();
+
+    /**
+     * @brief Drop the watch points, without restoring the pages
+     * Used when the process is restarted
+     */
+    void reset(pid_t new_pid);
+
+    bool isEmpty() const {
+      return watch_points.empty();
+    }
+
+    const std::map<size_t, WatchPoint>& getWatchPoints() const {
+      return watch_points;
+    }
+
+    /**
+     * @brief Handle the SIGSEGV the process is stopped on
+     * If the fault was caused by a watched page, the access is executed, so the process can be
+     * resumed without delivering the signal
+     */
+    Fault handleFault();
+
+  private:
+    struct Page {
+      // Protection of the page when nothing watches it
+      int original;
+      uint32_t writes = 0;
+      uint32_t accesses = 0;
+
+      int getProtection() const;
+    };
+
+    /**
+     * @brief Count a region in the watchers of its pages, or remove it with a negative delta, and
+     * update their protection
+     */
+    void updatePages(const WatchPoint& watch_point, int delta);
+
+    bool protect(Elf64_Addr address, size_t size, int protection);
+
+    /**
+     * @brief Returns the protection of every page of a region, from /proc/pid/maps
+     */
+    std::optional<std::vector<int>> readProtection(Elf64_Addr first_page, size_t count) const;
+
+    std::optional<size_t> findWatchPoint(Elf64_Addr address) const;
+
+    pid_t pid;
+    SyscallInjector syscall;
+
+    size_t next_id = 0;
+    std::map<size_t, WatchPoint> watch_points;
+    std::map<Elf64_Addr, Page> pages;
+  };
+
+}// namespace ldb
@@ -1,4 +1,5 @@
 #pragma once
+#include "RemoteMemory.h"
 #include <memory>
 #include <shared_mutex>
 #include <sys/wait.h>
@@ -145,6 +146,14 @@ namespace ldb {
       return pid;
     }
 
+    /**
+     * @brief Returns an accessor to the memory of the process
+     * Reads go through process_vm_readv, which is much faster than PTRACE_PEEKDATA
+     */
+    RemoteMemory getMemory() const {
+      return RemoteMemory(pid);
+    }
+
     /**
      * @brief Returns true if we're attached to the process, false otherwise
      * @return
@@ -4,10 +4,13 @@
 #include "BreakPointHandler.h"
 #include "DebugInfo.h"
 #include "ELFParser.h"
+#include "LinkMap.h"
+#include "ModulePool.h"
 #include "Process.h"
 #include "RegistersSnapshot.h"
 #include "SignalHandler.h"
 #include "StackTrace.h"
+#include "TracerThread.h"
 #include <filesystem>
 #include <memory>
 #include <shared_mutex>
@@ -21,6 +24,10 @@ namespace ldb {
    *
    * Provides utility from starting and pausing a process, attaching a signal handler, and getting
    * information such as a stacktrace and register snapshots.
+   *
+   * The process is forked, waited for and traced from a TracerThread. The methods of this class
+   * hand their requests to it, other requests on the process or its break points go through
+   * execute(), and reads of the state the thread updates while the process runs through lock().
    */
   class ProcessTracer {
   public:
@@ -30,6 +37,25 @@ namespace ldb {
      * @param args
      */
     ProcessTracer(const std::string& command, const std::vector<std::string>& args);
+    ~ProcessTracer();
+
+    /**
+     * @brief Run a task on the tracer thread, and wait for its result
+     * Everything that uses ptrace, e.g. setting break points, must run there. The caller must not
+     * hold lock()
+     */
+    template<class Task>
+    auto execute(Task&& task) -> decltype(task()) {
+      return thread->run(std::forward<Task>(task));
+    }
+
+    /**
+     * @brief Lock the state the tracer thread updates while the process runs, e.g. the symbol
+     * table, trace buffers and profilers, so it can be read from another thread
+     */
+    std::unique_lock<std::mutex> lock() {
+      return thread->lock();
+    }
 
     /**
      * @brief Returns the path to the executable linked to this tracer
@@ -50,21 +76,24 @@ namespace ldb {
     bool restart();
 
     void resume() {
-      process->resume();
+      execute([this]() { process->resume(); });
     }
 
     void singlestep() {
-      if (process->getStatus() != Process::Status::kStopped) return;
-      // By default, the breakpoint handler jump to the next instruction when restoring a breakpoint
-      ptrace(PTRACE_SINGLESTEP, process->getPid(), nullptr, nullptr);
+      execute([this]() {
+        if (process->getStatus() != Process::Status::kStopped) return;
+        // By default, the breakpoint handler jump to the next instruction when restoring a
+        // breakpoint
+        ptrace(PTRACE_SINGLESTEP, process->getPid(), nullptr, nullptr);
+      });
     }
 
     void pause() {
-      process->pause();
+      execute([this]() { process->pause(); });
     }
 
     void abort() {
-      process->kill();
+      execute([this]() { process->kill(); });
     }
 
     /**
@@ -98,6 +127,15 @@ namespace ldb {
       return debug_info->getSymbolTable();
     }
 
+    /**
+     * @brief Returns a counter increased whenever symbols are freed, when libraries are unloaded or
+     * the process is restarted. Pointers to symbols read under an older value must not be used.
+     * Read it under lock()
+     */
+    uint64_t getSymbolsGeneration() const {
+      return symbols_generation;
+    }
+
     /**
      * @brief Returns the current state of the process
      * @return The current state of the process
@@ -116,7 +154,11 @@ namespace ldb {
       auto tmp = std::make_unique<Sighandler>(process.get(), breakpoint_handler.get());
       // Get the res ptr before type casting to parent class
       auto res = tmp.get();
-      signal_handler = std::move(tmp);
+      // The events of the process are handled by the new handler from now on
+      execute([this, &tmp]() {
+        signal_handler = std::move(tmp);
+        thread->watch(signal_handler.get());
+      });
       return res;
     }
 
@@ -124,15 +166,46 @@ namespace ldb {
       return signal_handler.get();
     }
 
+    /**
+     * @brief Apply the changes of the link map of the process to the symbol table
+     * Only the libraries loaded since the last update are parsed, the tables of the unloaded ones
+     * are dropped, and pending break points are set if their library appeared. This is called
+     * automatically whenever the loader reaches r_brk, and must be called from the tracer thread
+     * while the process is stopped.
+     *
+     * @return True if the libraries changed, false otherwise
+     */
+    bool updateSharedLibraries();
+
   private:
-    bool readSymbols();
+    /**
+     * @brief Replace the process with a new one, from the tracer thread
+     */
+    bool restartProcess();
+
+    /**
+     * @brief Read the symbols of the executable and of its shared libraries
+     * @param reusable Symbol tables of a previous execution, that unchanged objects may adopt
+     * @return True if the symbols were read, false otherwise
+     */
+    bool readSymbols(ModulePool* reusable = nullptr);
+
+    /**
+     * @brief Set an internal break point on r_brk, so that we know when libraries are loaded
+     */
+    void watchSharedLibraries();
+
+    // Destroyed last, the process and its handlers are released from it
+    std::unique_ptr<TracerThread> thread;
 
     std::unique_ptr<Process> process;
 
     std::string executable_path;
     std::vector<std::string> arguments;
 
-    std::unique_ptr<const DebugInfo> debug_info;
+    std::unique_ptr<DebugInfo> debug_info;
+    LinkMap link_map;
+    uint64_t symbols_generation = 0;
 
     std::unique_ptr<SignalHandler> signal_handler;
 
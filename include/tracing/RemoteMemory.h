@@ -0,0 +1,114 @@
+#pragma once
+#include <elf.h>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <type_traits>
+
+namespace ldb {
+
+  /**
+   * @brief Bulk access to the memory of a traced process
+   *
+   * PTRACE_PEEKDATA only reads a word per syscall. This class reads whole buffers, and even
+   * multiple buffers at once, with process_vm_readv. When the kernel refuses it (e.g. the pages are
+   * not readable by the tracee itself), we fall back to /proc/pid/mem, which can read any page the
+   * tracer has access to.
+   *
+   * Writes go through /proc/pid/mem, which also patches read-only pages such as code, so a batch
+   * of buffers costs a syscall per buffer instead of one per word with PTRACE_POKEDATA.
+   *
+   * This class only holds the pid of the process, and is thus cheap to copy and safe to use from
+   * multiple threads.
+   */
+  class RemoteMemory {
+  public:
+    /**
+     * @brief One of the buffers of a scatter/gather read or write
+     */
+    struct Chunk {
+      Elf64_Addr address;
+      void* buffer;
+      size_t size;
+    };
+
+    explicit RemoteMemory(pid_t pid) : pid(pid) {}
+
+    pid_t getPid() const {
+      return pid;
+    }
+
+    /**
+     * @brief Read a buffer from the memory of the process
+     * @param address The address to read from, in the process address space
+     * @param buffer The buffer to fill
+     * @param size The number of bytes to read
+     * @return True if the whole buffer was read, false otherwise
+     */
+    bool read(Elf64_Addr address, void* buffer, size_t size) const;
+
+    /**
+     * @brief Read multiple buffers from the memory of the process, with as few syscalls as possible
+     * @param chunks The buffers to fill
+     * @return True if every buffer was entirely read, false otherwise
+     */
+    bool read(std::span<const Chunk> chunks) const;
+
+    /**
+     * @brief Read a value of the given type from the memory of the process
+     * @tparam T A trivially copyable type
+     * @param address The address of the value
+     * @return The value, or an empty optional if it could not be read
+     */
+    template<typename T>
+    std::optional<T> read(Elf64_Addr address) const {
+      static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read");
+      T res;
+      if (not read(address, &res, sizeof(T))) return std::nullopt;
+      return res;
+    }
+
+    /**
+     * @brief Write a buffer to the memory of the process, which must be stopped
+     * @param address The address to write to, in the process address space
+     * @param buffer The bytes to write
+     * @param size The number of bytes to write
+     * @return True if the whole buffer was written, false otherwise
+     */
+    bool write(Elf64_Addr address, const void* buffer, size_t size) const;
+
+    /**
+     * @brief Write multiple buffers to the memory of the process, which must be stopped
+     * /proc/pid/mem is only opened once for the whole batch
+     * @param chunks The buffers to write
+     * @return True if every buffer was entirely written, false otherwise
+     */
+    bool write(std::span<const Chunk> chunks) const;
+
+    /**
+     * @brief Read a null-terminated string from the memory of the process
+     * @param address The address of the first character
+     * @param max_size The maximum number of characters to read
+     * @return The string, or an empty optional if it could not be read. If no null character is
+     * found in the first max_size characters, the string is truncated
+     */
+    std::optional<std::string> readString(Elf64_Addr address, size_t max_size = 4096) const;
+
+  private:
+    /**
+     * @brief Read through /proc/pid/mem
+     * @return The number of bytes read
+     */
+    size_t readFromProc(Elf64_Addr address, void* buffer, size_t size) const;
+
+    /**
+     * @brief Write with PTRACE_POKEDATA, when /proc/pid/mem is not writable
+     * @return True if the whole buffer was written, false otherwise
+     */
+    bool writeWithPtrace(Elf64_Addr address, const void* buffer, size_t size) const;
+
+    pid_t pid;
+  };
+
+}// namespace ldb
@@ -14,8 +14,11 @@ namespace ldb {
    */
   class SignalEvent {
   public:
-    SignalEvent(Signal signal, Process::Status status, bool is_ignored, bool is_fatal) noexcept
-        : signal(signal), status(status), is_ignored(is_ignored), is_fatal(is_fatal) {}
+    SignalEvent(Signal signal, Process::Status status, bool is_ignored, bool is_fatal,
+                std::optional<size_t> watch_point = std::nullopt,
+                std::optional<size_t> page_watch_point = std::nullopt) noexcept
+        : signal(signal), status(status), is_ignored(is_ignored), is_fatal(is_fatal),
+          watch_point(watch_point), page_watch_point(page_watch_point) {}
 
     static const SignalEvent Unknown;
     static const SignalEvent None;
@@ -36,6 +39,30 @@ namespace ldb {
       return is_fatal;
     }
 
+    /**
+     * @brief Returns the index of the hardware watch point that triggered this SIGTRAP, if any
+     * @see HardwareBreakPoints
+     */
+    std::optional<size_t> getWatchPoint() const {
+      return watch_point;
+    }
+
+    SignalEvent withWatchPoint(std::optional<size_t> index) const {
+      return {signal, status, is_ignored, is_fatal, index, page_watch_point};
+    }
+
+    /**
+     * @brief Returns the id of the page watch point whose region was accessed, if any
+     * @see PageWatchPoints
+     */
+    std::optional<size_t> getPageWatchPoint() const {
+      return page_watch_point;
+    }
+
+    SignalEvent withPageWatchPoint(std::optional<size_t> id) const {
+      return {signal, status, is_ignored, is_fatal, watch_point, id};
+    }
+
   private:
     Signal signal;
     Process::Status status;
@@ -44,6 +71,8 @@ namespace ldb {
     bool is_ignored;
     // Set to true if the signal is fatal, meaning that the process was terminated
     bool is_fatal;
+    std::optional<size_t> watch_point;
+    std::optional<size_t> page_watch_point;
   };
 
   /**
@@ -101,26 +130,72 @@ namespace ldb {
 
     void setIgnored(Signal signal, bool ignored);
 
-  protected:
+    Process* getProcess() const {
+      return process;
+    }
+
+    /**
+     * @brief Handle the break points and watch points the process stopped on, and resume it if the
+     * stop is not reported
+     * Uses ptrace, and must thus run on the tracer thread, see TracerThread
+     */
     virtual SignalEvent handleEvent(const SignalEvent& event);
-    SignalEvent makeEventFromSignal(int signal);
 
     /**
      * @brief Wait for a signal to be received. Throws an exception on error (i.e the process was
      * killed)
      *
      * @param utimeout The timeout in useconds
-     * If set to 0, the function will wait indefinitely, and is guaranteed to return a valid
-     * event, or throw if it can't.
+     * If set to 0, the function will wait indefinitely, and only returns std::nullopt if the wait
+     * was interrupted by a signal, see TracerThread.
      *
      * Else, if timeout is set to a valid value, the function will return a valid event if it
      * received one in the given time. Otherwise, it will return std::nullopt. If an errors occurs,
      * the function will throw.
      *
-     * @return A valid event if one was received, or std::nullopt if the timeout was reached.
-     * Guaranteed to return a valid event if timeout is nullptr and no error occurs.
+     * @return A valid event if one was received, or std::nullopt if the timeout was reached or the
+     * wait was interrupted.
      */
     std::optional<SignalEvent> pollEvent(size_t utimeout);
+
+  protected:
+    /**
+     * @brief Handle the SIGTRAP the process is stopped on
+     * The registers are read once, and handed to the break point handler. Internal break points
+     * and break points whose action continues are handled silently, others are stepped over and
+     * reported. Traps that are not on a break point may come from a hardware watch point
+     */
+    SignalEvent handleTrap(const SignalEvent& event);
+
+    /**
+     * @brief Called from the tracer thread when the callback of an internal break point changed
+     * what the process looks like, e.g. the loaded libraries. The process is resumed afterwards
+     */
+    virtual void internalBreakpointChanged() {}
+
+    /**
+     * @brief Log the messages of the break points hit on the tracer thread, e.g. by log actions
+     * They are logged right away by default. A handler whose process is traced while another
+     * thread logs must hand them to that thread instead, the logger is not thread safe
+     */
+    virtual void logMessages(std::vector<BreakPointMessage>&& messages);
+
+    /**
+     * @brief Handle the SIGSEGV the process is stopped on, which may come from a page watch point
+     * Must be called from the tracer thread, and sets the final status of the process
+     *
+     * @return Nothing if the event is not a stop on a SIGSEGV. Otherwise, the event to report: a
+     * running, ignored event if the access did not touch a watch point, a stop if it did, and a
+     * fatal event for a real fault
+     */
+    std::optional<SignalEvent> handlePageFault(const SignalEvent& event);
+
+    /**
+     * @brief Build the event of a signal, and update the status of the process
+     * @param stopped true if the process is stopped on the signal, false if it was terminated by it
+     */
+    SignalEvent makeEventFromSignal(int signal, bool stopped);
+
     std::atomic<bool> is_muted;
     std::vector<bool> ignored_signals;
     BreakPointHandler* breakpoint_handler;
@@ -1,6 +1,7 @@
 #pragma once
 #include "Symbol.h"
 #include <iostream>
+#include <string_view>
 
 namespace ldb {
 
@@ -14,9 +15,9 @@ namespace ldb {
     StackFrame(Elf64_Addr addr, Elf64_Off offset, const Symbol* symbol);
     StackFrame(std::string fun_name, Elf64_Addr addr, Elf64_Off offset);
 
-    const std::string& getFunctionName() const {
+    std::string_view getFunctionName() const {
       if (symbol) {
-        return symbol->getName();
+        return symbol->getDemangledName();
       } else {
         return name;
       }
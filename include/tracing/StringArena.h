@@ -0,0 +1,45 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace ldb {
+
+  /**
+   * @brief Append-only storage for many small strings
+   *
+   * Strings are copied, null-terminated, in large blocks that are never moved nor freed before the
+   * arena itself. The views returned by add() thus stay valid as long as the arena exists, and
+   * can be stored instead of std::string to save an allocation and a few pointers per string.
+   */
+  class StringArena {
+  public:
+    StringArena() = default;
+
+    StringArena(const StringArena& other) = delete;
+    StringArena& operator=(const StringArena& other) = delete;
+
+    /**
+     * @brief Copy a string in the arena
+     * @return A view over the copy, which is followed by a null character
+     */
+    std::string_view add(std::string_view str);
+
+    /**
+     * @brief Returns the number of bytes allocated by the arena
+     */
+    size_t getCapacity() const {
+      return capacity;
+    }
+
+  private:
+    static constexpr size_t kBlockSize = 16 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    // Free space left in the last block
+    char* cursor = nullptr;
+    size_t available = 0;
+    size_t capacity = 0;
+  };
+
+}// namespace ldb
@@ -1,91 +1,184 @@
 #pragma once
+#include "TypeTable.h"
+#include <cstdint>
 #include <elf.h>
 #include <filesystem>
 #include <iostream>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace ldb {
 
+  class SymbolTable;
+
+  /**
+   * @brief A named and typed variable, such as a function argument
+   */
+  class Variable {
+  public:
+    Variable(std::string name, TypeId type) : name(std::move(name)), type(type) {}
+
+    Variable(std::string name, const std::string& type)
+        : name(std::move(name)), type(TypeTable::getDefault().intern(type)) {}
+
+    const std::string& getName() const {
+      return name;
+    }
+
+    /**
+     * @brief Returns the name of the type of this variable, or an empty string if it is unknown
+     */
+    const std::string& getType() const {
+      return TypeTable::getDefault().getName(type);
+    }
+
+    TypeId getTypeId() const {
+      return type;
+    }
+
+  private:
+    std::string name;
+    // Types are interned in the default TypeTable
+    TypeId type;
+  };
+
+  /**
+   * @brief Debug information of a symbol, only present if it was described in DWARF
+   */
+  struct SymbolDebugInfo {
+    std::filesystem::path file;
+    size_t line = 0;
+    TypeId type = TypeTable::kUnknown;
+    std::vector<Variable> args;
+    std::vector<Variable> vars;
+  };
+
   /**
    * @brief Represents a symbol in the ELF file, such as a function, global variable, etc.
    *
+   * Symbols store their address relative to the object file they come from. The load address of
+   * the object is kept by the SymbolTable that owns the symbol, so that relocating an object only
+   * means updating its base address.
+   *
+   * Most symbols have no debug information, and the address search only needs their range. So a
+   * symbol only holds its range and name, which is stored by its table. The debug information is
+   * kept apart by the table, and only allocated for the symbols that have some.
    */
   class Symbol {
     friend std::ostream& operator<<(std::ostream& os, const Symbol& symbol);
+    friend class SymbolTable;
   public:
+    /**
+     * @brief Construct a new symbol that spans a known range of addresses
+     * Symbols are built by their table, see SymbolTable::add()
+     *
+     * @param addr The address of this symbol, relative to its object file
+     * @param size The size of this symbol in bytes, as found in st_size or DW_AT_high_pc. 0 if
+     * unknown
+     * @param name The name of this symbol, which must outlive it
+     */
+    Symbol(Elf64_Addr addr, Elf64_Xword size, std::string_view name)
+        : addr(addr), size(size), name(name.data()), name_length(name.size()) {}
+
+    /**
+     * @brief Returns the source file this symbol was defined in, or an empty path if unknown
+     */
+    const std::filesystem::path& getFile() const;
 
-    Symbol(const std::string& strName, const std::string& strType)
-        : addr(0), name(strName), line(0), type(strType) {}
+    void setFile(const std::string& strFile) {
+      editDebugInfo().file = strFile;
+    }
 
     /**
-     * @brief Construct a new symbol
-     * @param addr The address of this symbol. This may be relative to the source file, or the
-     * current binary.
-     * @param name The name of this symbol.
-     * @param file An optional file path, if it is known
+     * @brief Returns the address of this symbol in the traced process
+     * This is the address relative to the object file, plus the object load address
      */
-    Symbol(Elf64_Addr addr, std::string name, std::filesystem::path file)
-        : addr(addr), name(name), file(file) {}
+    Elf64_Addr getAddress() const;
 
     /**
-     * @brief Relocate this symbol to a new address
-     * @param base The base address for the relocation
+     * @brief Returns the table this symbol belongs to, or nullptr if it belongs to none
      */
-    void relocate(Elf64_Addr base) {
-      addr += base;
+    const SymbolTable* getTable() const {
+      return table;
     }
 
-    const std::filesystem::path& getFile() const {
-      return file;
+    /**
+     * @brief Returns the address of this symbol relative to its object file
+     */
+    Elf64_Addr getRelativeAddress() const {
+      return addr;
     }
 
-    void setFile(const std::string& strFile) {
-      file = std::filesystem::path(strFile);
+    /**
+     * @brief Returns the size of this symbol in bytes, or 0 if it is unknown
+     */
+    Elf64_Xword getSize() const {
+      return size;
     }
 
-    Elf64_Addr getAddress() const {
-      return addr;
+    void setSize(Elf64_Xword s) {
+      size = s;
     }
 
-    const std::string& getName() const {
-      return name;
+    /**
+     * @brief Returns true if the given address lies inside this symbol
+     * Symbols with an unknown size only contain their start address
+     */
+    bool contains(Elf64_Addr address) const {
+      Elf64_Addr start = getAddress();
+      return address == start or (address > start and address - start < size);
     }
 
-    void setName(const std::string& strName) {
-      name = strName;
+    std::string_view getName() const {
+      return {name, name_length};
     }
 
-    const size_t getLine() const {
-      return line;
-    }
+    /**
+     * @brief Returns the demangled name of this symbol, or its name if it is not mangled
+     * Names are demangled on the first call, and kept by the table afterwards.
+     */
+    std::string_view getDemangledName() const;
+
+    size_t getLine() const;
 
     void setLine(const size_t l) {
-      line = line;
+      editDebugInfo().line = l;
     }
 
-    const std::string& getType() const {
-      return type;
-    }
+    /**
+     * @brief Returns the name of the type of this symbol, or an empty string if it is unknown
+     */
+    const std::string& getType() const;
 
     void setType(const std::string& strType) {
-      type = strType;
+      editDebugInfo().type = TypeTable::getDefault().intern(strType);
     }
 
-    const std::vector<Symbol>& getArgs() const {
-      return args;
+    TypeId getTypeId() const;
+
+    void setTypeId(TypeId id) {
+      editDebugInfo().type = id;
     }
 
-    std::vector<Symbol>& getArgs() {
-      return args;
+    const std::vector<Variable>& getArgs() const;
+
+    std::vector<Variable>& getArgs() {
+      return editDebugInfo().args;
     }
 
-    const std::vector<Symbol>& getVars() const {
-      return vars;
+    const std::vector<Variable>& getVars() const;
+
+    std::vector<Variable>& getVars() {
+      return editDebugInfo().vars;
     }
 
-    std::vector<Symbol>& getVars() {
-      return vars;
+    /**
+     * @brief Returns true if the symbol was described by the debug information
+     */
+    bool hasDebugInfo() const {
+      return debug != kNoDebugInfo;
     }
 
     /**
@@ -95,7 +188,7 @@ namespace ldb {
      */
     bool operator==(const Symbol& other) const {
       // Two symbols are equal if they have the same address and name
-      return addr == other.addr && name == other.name;
+      return addr == other.addr && getName() == other.getName();
     }
 
     bool operator!=(const Symbol& other) const {
@@ -103,12 +196,27 @@ namespace ldb {
     }
 
   private:
-    std::filesystem::path file;
+    /**
+     * @brief Returns the debug information of this symbol, or nullptr if it has none
+     */
+    const SymbolDebugInfo* getDebugInfo() const;
+
+    /**
+     * @brief Returns the debug information of this symbol, allocating it if needed
+     * The symbol must belong to a table
+     */
+    SymbolDebugInfo& editDebugInfo();
+
+    static constexpr uint32_t kNoDebugInfo = UINT32_MAX;
+
+    // The table this symbol belongs to, if any
+    SymbolTable* table = nullptr;
     Elf64_Addr addr;
-    std::string name;
-    size_t line;
-    std::string type;
-    std::vector<Symbol> args;
-    std::vector<Symbol> vars;
+    Elf64_Xword size;
+    // Owned by the string arena of the table
+    const char* name;
+    uint32_t name_length;
+    // Index of the debug information in the table
+    uint32_t debug = kNoDebugInfo;
   };
 }// namespace ldb
@@ -0,0 +1,68 @@
+#pragma once
+#include "ObjectId.h"
+#include "SymbolTable.h"
+#include <filesystem>
+#include <memory>
+
+namespace ldb {
+
+  /**
+   * @brief Persistent, on-disk cache of the symbols parsed from object files
+   *
+   * Parsing the ELF and DWARF data of an object is costly, while most objects (libc and friends)
+   * never change between two executions. Each object gets its own entry in the cache directory,
+   * named after its ObjectId, that holds a compact binary copy of its symbol table: symbols,
+   * function arguments and variables, source files and type names.
+   *
+   * Entries are memory-mapped when loaded, and written atomically, so multiple debuggers may safely
+   * share the same cache directory.
+   */
+  class SymbolCache {
+  public:
+    /**
+     * @brief Builds a cache stored in the given directory
+     * The directory is created on the first write
+     * @param directory
+     */
+    explicit SymbolCache(std::filesystem::path directory);
+
+    /**
+     * @brief Returns the cache used by default by the ELF parser
+     *
+     * The cache lives in $LDB_SYMBOL_CACHE_DIR, or $XDG_CACHE_HOME/ldb/symbols, or
+     * ~/.cache/ldb/symbols. It can be disabled by setting LDB_SYMBOL_CACHE=0.
+     * @return A pointer to the default cache, or nullptr if caching is disabled
+     */
+    static SymbolCache* getDefault();
+
+    const std::filesystem::path& getDirectory() const {
+      return directory;
+    }
+
+    /**
+     * @brief Load the symbol table of the given object from the cache
+     * @param id The identity of the object
+     * @param object_file The current path to the object, since the same object may be found under
+     * different paths
+     * @return The cached symbol table, or nullptr if the object is not in the cache, or its entry
+     * is invalid
+     */
+    std::unique_ptr<SymbolTable> load(const ObjectId& id,
+                                      const std::filesystem::path& object_file) const;
+
+    /**
+     * @brief Store the symbol table of the given object in the cache
+     * Symbols are stored relative to their object, the table may already be relocated
+     * @param id The identity of the object
+     * @param table The table to store
+     * @return True if the table was stored, false otherwise
+     */
+    bool store(const ObjectId& id, const SymbolTable& table) const;
+
+  private:
+    std::filesystem::path entryPath(const ObjectId& id) const;
+
+    std::filesystem::path directory;
+  };
+
+}// namespace ldb
@@ -0,0 +1,116 @@
+#pragma once
+#include "StringArena.h"
+#include "SymbolTable.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace ldb {
+
+  /**
+   * @brief Search index over the names of the symbols of a SymbolTable
+   *
+   * Names are matched case-insensitively, either as a substring of the symbol name, or as a fuzzy
+   * subsequence (every character of the query appears in order in the name). Substrings are found
+   * through a trigram index, so the whole table is only scanned for the fuzzy matches. C++ symbols
+   * match by both their demangled and their mangled names.
+   *
+   * The index keeps its own copy of the names, so it can be queried from any thread. The
+   * symbols it returns belong to the table it was built from, and are only valid as long as the
+   * table is not modified.
+   */
+  class SymbolIndex {
+  public:
+    struct Match {
+      // Position of the symbol in the index, see getSymbol()
+      uint32_t id;
+      // Higher is better
+      int score;
+    };
+
+    /**
+     * @brief Receives a batch of matches, and returns false to stop the search
+     */
+    using Callback = std::function<bool(std::vector<Match>&& batch)>;
+
+    /**
+     * @brief Copy the names of every symbol of the chain
+     * Every table of the chain is demangled first, see SymbolTable::demangleAll(). The trigram
+     * index itself is only built on the first search, or by prepareSearch().
+     */
+    explicit SymbolIndex(const SymbolTable& symbols);
+
+    SymbolIndex(const SymbolIndex& other) = delete;
+    SymbolIndex& operator=(const SymbolIndex& other) = delete;
+
+    size_t getSize() const {
+      return symbols.size();
+    }
+
+    const Symbol* getSymbol(uint32_t id) const {
+      return id < symbols.size() ? symbols[id] : nullptr;
+    }
+
+    /**
+     * @brief Find the symbols matching a query, best matches first
+     *
+     * Matches are handed to the callback in batches, as soon as they are ranked: substring
+     * matches come first, then fuzzy matches. An empty query matches every symbol, in table
+     * order.
+     *
+     * @param query The text to search for
+     * @param callback Receives the matches
+     * @param cancelled Stops the search as soon as possible once set
+     * @param batch_size Maximum number of matches per batch
+     */
+    void search(std::string_view query, const Callback& callback,
+                const std::atomic<bool>& cancelled, size_t batch_size = 512) const;
+
+    /**
+     * @brief Build the trigram index now, so the first search does not have to
+     */
+    void prepareSearch() const;
+
+    /**
+     * @brief Score a name against a query, both in lower case
+     * @return The score of the match, or std::nullopt if the name does not match
+     */
+    static std::optional<int> score(std::string_view name, std::string_view query);
+
+  private:
+    void buildTrigrams() const;
+
+    /**
+     * @brief Returns the best score of the names of a symbol against a query
+     */
+    std::optional<int> scoreSymbol(uint32_t id, std::string_view query) const;
+
+    /**
+     * @brief Returns true if one of the names of a symbol contains the query
+     */
+    bool containsQuery(uint32_t id, std::string_view query) const;
+
+    /**
+     * @brief Returns the symbols whose names contain every trigram of the query, sorted
+     */
+    std::vector<uint32_t> findCandidates(std::string_view query) const;
+
+    std::vector<const Symbol*> symbols;
+    // Lower case demangled names, in the same order as the symbols
+    std::vector<std::string_view> names;
+    // Lower case mangled names, empty when the symbol name is not mangled
+    std::vector<std::string_view> mangled_names;
+    StringArena arena;
+
+    // Trigrams are stored in compressed sparse rows: the symbols containing trigram_keys[i] are
+    // trigram_ids[trigram_offsets[i]] to trigram_ids[trigram_offsets[i + 1]]
+    mutable std::once_flag trigrams_built;
+    mutable std::vector<uint32_t> trigram_keys;
+    mutable std::vector<uint32_t> trigram_offsets;
+    mutable std::vector<uint32_t> trigram_ids;
+  };
+
+}// namespace ldb
@@ -1,12 +1,23 @@
 #pragma once
+#include "LineTable.h"
+#include "ObjectId.h"
+#include "StringArena.h"
 #include "Symbol.h"
+#include <deque>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace ldb {
 
+  class DwarfModule;
+
   /**
    * @brief A table of symbols that can be used to resolve symbols.
    *
@@ -14,6 +25,7 @@ namespace ldb {
    */
   class SymbolTable {
     friend std::ostream& operator<<(std::ostream& os, const SymbolTable& table);
+    friend class Symbol;
   public:
 
     SymbolTable() = default;
@@ -29,6 +41,12 @@ namespace ldb {
       symbols.reserve(size);
     }
 
+    /**
+     * @brief Symbols point back to their table, which thus cannot be copied nor moved
+     */
+    SymbolTable(const SymbolTable& other) = delete;
+    SymbolTable& operator=(const SymbolTable& other) = delete;
+
     bool isEmpty() const {
       return symbols.empty();
     }
@@ -39,48 +57,59 @@ namespace ldb {
      */
     void shrinkToFit();
 
-    void relocate(Elf64_Addr);
+    /**
+     * @brief Set the load address of every table in the chain
+     * Since symbols are stored relative to their object, this does not touch the symbols
+     * themselves. This invalidates the address index.
+     *
+     * @param base The address the object was loaded at
+     */
+    void relocate(Elf64_Addr base);
 
     /**
      * @brief Find the symbol at a index and return it
-     * 
+     * Symbols are numbered across the whole chain. Once indexed (see indexAddresses()), this is a
+     * binary search over the tables of the chain.
+     *
      * @param index Index in table of element
      * @return const Symbol* Symbol finded
      */
-    const Symbol* at(size_t index) const {
-      size_t count = 0;
-      for (const SymbolTable* table = this; table != nullptr; table = table->next.get()) {
-        if (index < table->symbols.size()) { return &table->symbols[index]; }
-        count += table->symbols.size();
-        index -= table->symbols.size();
-      }
-      return nullptr;
-    }
+    const Symbol* at(size_t index) const;
 
-    size_t getSize() const {
-      size_t count = 0;
-      for (const SymbolTable* table = this; table != nullptr; table = table->next.get()) {
-        count += table->symbols.size();
-      }
-      return count;
-    }
+    /**
+     * @brief Returns the number of symbols in the whole chain
+     */
+    size_t getSize() const;
 
     /**
      * @brief Add a new symbol to the end of table
-     * 
-     * @param symbol Element to add
+     *
+     * @param addr Address of the symbol, relative to the object file
+     * @param size Size of the symbol in bytes, 0 if unknown
+     * @param name Name of the symbol, which is copied in the table
      * @return Symbol& Element added
      */
-    Symbol& push_back(const Symbol& symbol) {
-      symbols.push_back(symbol);
+    Symbol& add(Elf64_Addr addr, Elf64_Xword size, std::string_view name) {
+      // The names index points inside of the symbols, and may be invalidated
+      names.clear();
+      symbols.emplace_back(addr, size, strings.add(name));
+      symbols.back().table = this;
       return symbols.back();
     }
 
-    template<typename... Args>
-    Symbol& emplace_back(Args&&... args) {
-      symbols.emplace_back(args...);
-      return symbols.back();
-    }
+    /**
+     * @brief Build the name index of every table in the chain
+     * Must be called once the tables are filled, since adding a symbol invalidates the index.
+     * Until then, lookups by name fall back to a linear scan.
+     */
+    void indexNames();
+
+    /**
+     * @brief Demangle the names of every symbol of this table, in parallel
+     * Only this table is handled, not the rest of the chain. Names that were already demangled
+     * are kept.
+     */
+    void demangleAll() const;
 
     /**
      * @brief Find a symbol by name
@@ -88,7 +117,7 @@ namespace ldb {
      * @param name Name of symbol
      * @return Symbol* symbol finded
      */
-    Symbol* operator[](const std::string& name);
+    Symbol* operator[](std::string_view name);
 
     /**
      * @brief Find a symbol by name
@@ -96,7 +125,16 @@ namespace ldb {
      * @param name Name of symbol
      * @return Symbol* symbol finded
      */
-    const Symbol* operator[](const std::string& name) const;
+    const Symbol* operator[](std::string_view name) const;
+
+    /**
+     * @brief Find a symbol by name, in the tables of the same object file as this one
+     * Unlike operator[], the search stops at the first table of another object
+     *
+     * @param name Name of symbol
+     * @return Symbol* symbol finded
+     */
+    Symbol* findInObject(std::string_view name);
 
     /**
      * @brief Find a symbol by name
@@ -115,13 +153,34 @@ namespace ldb {
     const Symbol* operator[](Elf64_Addr name) const;
 
     /**
-     * @brief Find in all symbol table a symbol
+     * @brief Find in all symbol table the symbol that contains the given address
      * 
-     * @param addr Address of symbol
+     * @param addr Address inside of the symbol
      * @return std::pair<const Symbol*, const SymbolTable*> symbol finded and its symbol table
      */
     std::pair<const Symbol*, const SymbolTable*> findInTable(Elf64_Addr addr) const;
 
+    /**
+     * @brief Build the address and module indexes of every table in the chain
+     * This must be called on the head of the chain once every table was joined and relocated.
+     * Until then, lookups by address or position fall back to a linear scan of the chain.
+     */
+    void indexAddresses();
+
+    /**
+     * @brief Find the object file containing the given address
+     * An object spans from its first symbol to the end of its last one. This requires the index
+     * built by indexAddresses().
+     *
+     * @param addr Address in the process
+     * @return The first table of the object, or nullptr if no object contains the address
+     */
+    const SymbolTable* findModule(Elf64_Addr addr) const;
+
+    bool hasAddressIndex() const {
+      return not range_starts.empty();
+    }
+
     std::filesystem::path getObjectFile() const {
       return object_file;
     }
@@ -130,6 +189,95 @@ namespace ldb {
       return base_address;
     }
 
+    /**
+     * @brief Returns the next table in the chain, or nullptr if this is the last one
+     */
+    const SymbolTable* getNext() const {
+      return next.get();
+    }
+
+    /**
+     * @brief Cut the chain after this table
+     * @return The rest of the chain, or nullptr if this was the last table
+     */
+    std::unique_ptr<SymbolTable> detachNext();
+
+    /**
+     * @brief Returns the identity of the object file this table was loaded from
+     */
+    const ObjectId& getObjectId() const {
+      return object_id;
+    }
+
+    /**
+     * @brief Set the identity of the object file of every table in the chain
+     */
+    void setObjectId(const ObjectId& id);
+
+    /**
+     * @brief Set the path of the object file of every table in the chain
+     * The same object may be found under different paths
+     */
+    void setObjectFile(const std::filesystem::path& path);
+
+    /**
+     * @brief Attach debug information decoded on demand to every table in the chain
+     * @param module The debug information of the object the tables were loaded from
+     */
+    void setDwarfModule(std::shared_ptr<DwarfModule> module);
+
+    const std::shared_ptr<DwarfModule>& getDwarfModule() const {
+      return dwarf;
+    }
+
+    /**
+     * @brief Decode the debug information of the compute unit containing the given address
+     * Tables read with lazy DWARF loading only hold the ELF symbols until then. This does nothing
+     * if the compute unit was already decoded, or the object has no debug information.
+     *
+     * On the head of the chain, the table is found from the address index. Otherwise, the address
+     * is assumed to be inside of this table.
+     * @param addr Address in the process
+     */
+    void loadDebugInfo(Elf64_Addr addr) const;
+
+    /**
+     * @brief Find the source location of the instruction at the given address
+     * Must be called on the head of the chain. The line table of the compute unit is decoded on
+     * the first lookup.
+     *
+     * @param addr Address in the process
+     * @return The location, or std::nullopt if the address has no line information
+     */
+    std::optional<SourceLocation> findLocation(Elf64_Addr addr) const;
+
+    /**
+     * @brief Find the addresses of a line in a source file, in every object of the chain
+     * @param file Path of the source file. A relative path matches any file ending with it
+     * @param line Line in the source file
+     * @return The addresses in the process starting the line, sorted
+     */
+    std::vector<Elf64_Addr> findAddresses(const std::filesystem::path& file, size_t line) const;
+
+    /**
+     * @brief Find the addresses where a new line starts, in the code of a function
+     * Must be called on the head of the chain, see LineTable::findLineStarts()
+     *
+     * @param start Address of the function in the process
+     * @param end End of the function, excluded
+     * @return The addresses in the process, sorted. Empty if there is no line information
+     */
+    std::vector<Elf64_Addr> findLineStarts(Elf64_Addr start, Elf64_Addr end) const;
+
+    /**
+     * @brief Remove the tables of the given object from the chain
+     * The head of the chain is never removed. This invalidates the address index.
+     *
+     * @param path Path of the object file
+     * @return The number of tables removed
+     */
+    size_t removeObject(const std::filesystem::path& path);
+
     /**
      * @brief Merge two symbol table
      * 
@@ -155,11 +303,89 @@ namespace ldb {
     }
 
   private:
+    /**
+     * @brief Returns the demangled name of one of the symbols of this table
+     * @see Symbol::getDemangledName()
+     */
+    std::string_view demangle(const Symbol& symbol) const;
+
+    /**
+     * @brief Drop the indexes of the chain, which no longer match its content
+     */
+    void clearIndex();
+
+    /**
+     * @brief Find the table holding the symbols of the given address
+     * On the head of an indexed chain, the symbol ranges are searched first, then the objects.
+     * Otherwise, the address is assumed to be inside of this table.
+     * @return The table, or nullptr if none was found
+     */
+    const SymbolTable* findTable(Elf64_Addr addr) const;
+
+    /**
+     * @brief Find the index of the range containing the given address
+     * @return The position of the range in the index, or the index size if none was found
+     */
+    size_t findRange(Elf64_Addr addr) const;
+
+    // Only the head of the chain owns an address index
+    // The start addresses are kept apart in a dense, sorted array so the binary search does not
+    // have to drag the rest of the range in cache
+    struct AddressRange {
+      Elf64_Addr end;
+      const Symbol* symbol;
+      const SymbolTable* table;
+    };
+    std::vector<Elf64_Addr> range_starts;
+    std::vector<AddressRange> ranges;
+
+    // Every table of the chain, with the number of symbols before it, so a symbol is found from
+    // its global position without walking the chain
+    struct TableEntry {
+      size_t first_symbol;
+      const SymbolTable* table;
+    };
+    std::vector<TableEntry> tables;
+
+    // The address span of every object of the chain, sorted by start address
+    struct ModuleRange {
+      Elf64_Addr start;
+      Elf64_Addr end;
+      const SymbolTable* table;
+    };
+    std::vector<ModuleRange> modules;
+
+    // Last table of the chain, so joining does not walk it. Only valid on the head of the chain,
+    // may be null when unknown
+    SymbolTable* tail = nullptr;
+
+    // Transparent hash, so the index can be queried with any string-like type without copies
+    struct NameHash {
+      using is_transparent = void;
+      size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+      }
+    };
+    // Every table owns the index of its own symbols. Keys are views over the symbols names
+    std::unordered_map<std::string_view, Symbol*, NameHash, std::equal_to<>> names;
+
+    // Symbols only hold what the address and name lookups need. Their names live in the arena,
+    // and their debug information, which most of them lack, is kept apart
     std::vector<Symbol> symbols;
+    StringArena strings;
+    // Deque, so references handed out by the symbols are not invalidated when one is added
+    std::deque<SymbolDebugInfo> debug_infos;
+    // Demangled names, in the same order as the symbols. An empty view is a name that was not
+    // demangled yet. Only filled on demand, since most names are never displayed
+    mutable std::mutex demangle_mutex;
+    mutable std::vector<std::string_view> demangled;
+    mutable StringArena demangled_strings;
     std::unique_ptr<SymbolTable> next;
-    std::string file;
     std::filesystem::path object_file;
-    Elf64_Addr base_address;
+    ObjectId object_id;
+    // Debug information that was not decoded yet, shared by the tables of the same object
+    std::shared_ptr<DwarfModule> dwarf;
+    Elf64_Addr base_address = 0;
   };
 
 
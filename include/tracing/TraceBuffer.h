@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/user.h>
+#include <vector>
+#include "BreakPointCondition.h"
+#include "RemoteMemory.h"
+
+namespace ldb {
+
+  /**
+   * @brief Ring buffer of the values captured by a trace point, every time it is hit
+   *
+   * The buffer is allocated once, and stored by column: every column is an array of capacity
+   * values, so recording a hit never allocates, and views and exports read the arrays in place.
+   * Once the buffer is full, the oldest rows are overwritten.
+   *
+   * Rows are recorded by the thread that handles the traps of the process, see TracerThread. Other
+   * threads read the buffer while holding ProcessTracer::lock().
+   */
+  class TraceBuffer {
+  public:
+    /**
+     * @brief A captured value
+     */
+    struct Column {
+      std::string name;
+      BreakPointCondition expression;
+      // Bytes read at the address the expression evaluates to, or 0 to store the value itself
+      uint32_t slice_size = 0;
+
+      uint32_t getWidth() const {
+        return slice_size ? slice_size : sizeof(int64_t);
+      }
+    };
+
+    /**
+     * @brief Parse a comma separated list of columns, e.g. "rdi, rsi, *(long*)rdi, rsi:16"
+     * Every column is an expression (see BreakPointCondition), whose value is captured. With a
+     * ":size" suffix, size bytes are captured at the address the expression evaluates to
+     *
+     * @throw std::runtime_error if an expression is invalid
+     */
+    static std::vector<Column> parseColumns(std::string_view spec);
+
+    /**
+     * @param columns captured values
+     * @param capacity number of rows kept, rounded up to a power of two
+     */
+    explicit TraceBuffer(std::vector<Column> columns, size_t capacity = kDefaultCapacity);
+
+    /**
+     * @brief Capture a row, overwriting the oldest one if the buffer is full
+     * Slices are read with a single request to the memory of the process
+     */
+    void record(const user_regs_struct& regs, uint64_t reached, const RemoteMemory& memory);
+
+    /**
+     * @brief Drop every row
+     */
+    void clear();
+
+    const std::vector<Column>& getColumns() const {
+      return columns;
+    }
+
+    size_t getCapacity() const {
+      return capacity;
+    }
+
+    /**
+     * @brief Returns the number of rows in the buffer, at most its capacity
+     */
+    size_t getSize() const;
+
+    /**
+     * @brief Returns the number of rows ever recorded, including the overwritten ones
+     */
+    uint64_t getRecorded() const {
+      return recorded.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Returns the index of the oldest row in the buffer, counted from the first row ever
+     * recorded
+     * Rows are addressed by this absolute index, so they do not move when new ones are recorded.
+     * Rows below it were overwritten.
+     */
+    uint64_t getFirst() const;
+
+    /**
+     * @brief Returns the time a row was recorded at, in nanoseconds of CLOCK_MONOTONIC
+     * @param row absolute index of the row, see getFirst()
+     */
+    uint64_t getTimestamp(uint64_t row) const;
+
+    /**
+     * @brief Returns the value of a column, or nothing if it could not be captured
+     * @param row absolute index of the row, see getFirst()
+     */
+    std::optional<int64_t> getValue(size_t column, uint64_t row) const;
+
+    /**
+     * @brief Returns the bytes of a slice column, or nothing if they could not be read
+     * @param row absolute index of the row, see getFirst()
+     */
+    std::optional<std::span<const uint8_t>> getSlice(size_t column, uint64_t row) const;
+
+    /**
+     * @brief Write the rows, from the oldest one, in a binary format
+     *
+     * All integers are in the byte order of the host:
+     * - "LDBTRACE", the version (u32), the number of columns (u32), of rows (u64), and of rows ever
+     * recorded (u64)
+     * - for every column, the length of its name (u32), its name, and its slice size (u32, 0 for a
+     * value column)
+     * - the timestamps of the rows (u64 each)
+     * - for every column, a byte per row that is 0 if the value could not be captured, then the
+     * values (i64 each) or slices of the rows
+     *
+     * @return false if the stream failed
+     */
+    bool exportTo(std::ostream& os) const;
+
+    static constexpr size_t kDefaultCapacity = 1 << 16;
+    static constexpr uint32_t kMaxSliceSize = 4096;
+    static constexpr uint32_t kExportVersion = 1;
+
+  private:
+    size_t getSlot(uint64_t row) const {
+      return row & (capacity - 1);
+    }
+
+    /**
+     * @brief Write size rows of an array of the buffer from the slot first, which takes two writes
+     * once the buffer wrapped around
+     */
+    void exportArray(std::ostream& os, const uint8_t* array, size_t width, size_t first,
+                     size_t size) const;
+
+    std::vector<Column> columns;
+    size_t capacity;
+
+    std::vector<uint64_t> timestamps;
+    // One array of capacity values per column
+    std::vector<std::vector<uint8_t>> values;
+    std::vector<std::vector<uint8_t>> valid;
+    std::atomic<uint64_t> recorded = 0;
+
+    // Reused by record(), so it never allocates
+    std::vector<RemoteMemory::Chunk> chunks;
+    std::vector<size_t> chunk_columns;
+  };
+
+}// namespace ldb
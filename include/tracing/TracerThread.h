@@ -0,0 +1,123 @@
+#pragma once
+#include "SignalHandler.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ldb {
+
+  /**
+   * @brief Thread that owns the tracee, every ptrace request must come from it
+   *
+   * The kernel only accepts ptrace requests from the thread that attached the tracee, which is the
+   * thread that forked it. This thread forks the tracee, waits for its events and handles them with
+   * the watched SignalHandler, so break points that continue are handled without leaving it. Other
+   * threads hand it their requests with run().
+   *
+   * The state the handler updates (symbol tables, trace buffers, profilers...) is guarded by a
+   * mutex, which the thread holds while it handles an event or runs a task. It is only released
+   * while the thread waits, so other threads can lock() it to read that state while the process
+   * runs.
+   *
+   * While the thread waits for the process, tasks interrupt the wait with a signal that is blocked
+   * anywhere else on the thread, so the waits of the handlers are never interrupted.
+   */
+  class TracerThread {
+  public:
+    TracerThread();
+    ~TracerThread();
+
+    TracerThread(const TracerThread&) = delete;
+    TracerThread& operator=(const TracerThread&) = delete;
+
+    /**
+     * @brief Run a task on the tracer thread, and wait for its result
+     * The task runs right away if called from the tracer thread. Exceptions thrown by the task are
+     * rethrown to the caller.
+     * The caller must not hold lock(), or the thread could never run the task
+     */
+    template<class Task>
+    auto run(Task&& task) -> decltype(task()) {
+      if (isCurrent()) return task();
+
+      using Result = decltype(task());
+      auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+      auto result = packaged->get_future();
+      push([packaged]() { (*packaged)(); });
+      // The wake up may be missed if the thread was about to wait, it is sent again until then.
+      // It is only sent while the thread waits for the process, and is never queued twice
+      while (result.wait_for(kWakeInterval) != std::future_status::ready) wake();
+      return result.get();
+    }
+
+    /**
+     * @brief Returns true if called from the tracer thread
+     */
+    bool isCurrent() const {
+      return std::this_thread::get_id() == thread.get_id();
+    }
+
+    /**
+     * @brief Lock the state of the tracer, so it is not updated while it is read
+     * The thread holds it while handling events or running tasks, readers only hold it briefly
+     */
+    std::unique_lock<std::mutex> lock() {
+      return std::unique_lock<std::mutex>(state);
+    }
+
+    /**
+     * @brief Set the handler whose process is waited for, and whose events are handled here
+     * Must be called from the tracer thread. The events of the process are only waited for while
+     * it is alive, nullptr stops waiting
+     */
+    void watch(SignalHandler* new_handler) {
+      handler = new_handler;
+    }
+
+  private:
+    static constexpr std::chrono::milliseconds kWakeInterval{1};
+
+    void push(std::function<void()> task);
+
+    /**
+     * @brief Interrupt the wait of the thread, so it runs the queued tasks
+     */
+    void wake();
+
+    /**
+     * @brief Run the queued tasks, in order
+     */
+    void runTasks();
+
+    bool hasTasks();
+
+    /**
+     * @brief Returns true if the process of the handler may still report events
+     */
+    bool isWatching() const;
+
+    void loop();
+
+    std::mutex state;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<std::function<void()>> tasks;
+
+    // Set while the thread waits for the process, the only wait wake() must interrupt
+    std::atomic<bool> waiting = false;
+
+    // Only used from the tracer thread
+    SignalHandler* handler = nullptr;
+    bool stopping = false;
+
+    // Started last, once everything it uses is constructed
+    std::thread thread;
+  };
+
+}// namespace ldb
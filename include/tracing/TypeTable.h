@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ldb {
+
+  /**
+   * @brief Compact handle on a type of the TypeTable
+   */
+  using TypeId = uint32_t;
+
+  /**
+   * @brief Interned graph of the types found in the debug information
+   *
+   * Every type is stored once, and symbols only hold its id. A type is either named (base types,
+   * structures, typedefs...) or derived from another type (pointer, const...). The name of a
+   * derived type is only built the first time it is requested, and kept afterwards.
+   *
+   * This class is thread-safe.
+   */
+  class TypeTable {
+  public:
+    enum class Kind : uint8_t { kNamed, kPointer, kConst, kArray, kReference };
+
+    /**
+     * @brief Id of the unknown type, whose name is empty
+     */
+    static constexpr TypeId kUnknown = 0;
+
+    TypeTable();
+
+    TypeTable(const TypeTable& other) = delete;
+    TypeTable& operator=(const TypeTable& other) = delete;
+
+    /**
+     * @brief Returns the table shared by every symbol
+     */
+    static TypeTable& getDefault();
+
+    /**
+     * @brief Returns the id of a named type, adding it if needed
+     * @param name The name of the type. An empty name is the unknown type
+     */
+    TypeId intern(std::string_view name);
+
+    /**
+     * @brief Returns the id of a type derived from another one, adding it if needed
+     * @param kind How the type is derived, must not be Kind::kNamed
+     * @param base The type it is derived from
+     */
+    TypeId intern(Kind kind, TypeId base);
+
+    /**
+     * @brief Returns the name of a type, as it would be written in C
+     * The reference stays valid as long as the table exists.
+     */
+    const std::string& getName(TypeId id);
+
+    size_t getSize() const;
+
+  private:
+    struct Node {
+      Kind kind;
+      TypeId base;
+      // Only valid once resolved, for derived types
+      std::string name;
+      bool resolved;
+    };
+
+    // Transparent hash, so the names can be looked up without copies
+    struct NameHash {
+      using is_transparent = void;
+      size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+      }
+    };
+
+    mutable std::shared_mutex mutex;
+    // Nodes are never moved, so the names can be handed out by reference
+    std::deque<Node> nodes;
+    std::unordered_map<std::string, TypeId, NameHash, std::equal_to<>> named;
+    // Keyed by (kind << 32 | base)
+    std::unordered_map<uint64_t, TypeId> derived;
+  };
+
+}// namespace ldb
@@ -1,107 +1,70 @@
 #include "QtSignalHandler.h"
-#include <QThread>
-#include <iostream>
-#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
 
 namespace ldb::gui {
 
   QtSignalHandler::QtSignalHandler(Process* process, BreakPointHandler* bph)
-      : SignalHandler(process, bph), worker_thread(nullptr) {
-    connect(this, &QtSignalHandler::ignoredEvent, this, &QtSignalHandler::resumeTracee);
-    worker_thread = QThread::create(&QtSignalHandler::workerLoop, this);
-    worker_thread->start();
-  }
-
-  QtSignalHandler::~QtSignalHandler() {
-    stopThread();
-  }
-
-  void QtSignalHandler::stopThread() {
-    if (not worker_thread or not worker_thread->isRunning()) return;
-
-    worker_exit = true;
-    is_muted = true;
-    update_cv.notify_all();
-    worker_thread->wait();
-    worker_exit = false;
-    is_muted = false;
-  }
-
-  void QtSignalHandler::reset(Process* p, BreakPointHandler* bph) {
-    stopThread();
-    is_muted = false;
-    process = p;
-    breakpoint_handler = bph;
-    worker_thread = QThread::create(&QtSignalHandler::workerLoop, this);
-    worker_thread->start();
-  }
-
-  void QtSignalHandler::mute() {
-
-    if (is_muted or not worker_thread or not worker_thread->isRunning()) return;
-
-    is_muted = true;
-
-    std::unique_lock<std::mutex> l(mutex);
-
-    // Wait until the thread signals that it has finished
-    update_cv.wait(l, [this]() -> bool { return worker_waiting; });
-  }
-
-  void QtSignalHandler::unmute() {
-    if (not is_muted or not worker_thread or not worker_thread->isRunning()) return;
-    update_cv.notify_one();
-
-    is_muted = false;
-  }
+      : SignalHandler(process, bph) {}
 
   SignalEvent QtSignalHandler::handleEvent(const SignalEvent& event) {
-    if (event.getSignal() == Signal::kSIGTRAP)
-      QMetaObject::invokeMethod(this, &QtSignalHandler::resetBreakpoint, Qt::QueuedConnection);
+    auto res = SignalHandler::handleEvent(event);
+    // Break points that continue, and ignored signals, are not a stop: the views are left alone
+    if (res.isIgnored()) return res;
+
+    if (auto index = res.getWatchPoint()) {
+      const auto& hardware = breakpoint_handler->getHardwareBreakPoints();
+      if (const auto& watch_point = hardware.at(*index)) {
+        std::stringstream ss;
+        ss << "Watch point " << *index << " ("
+           << HardwareBreakPoints::getTypeName(watch_point->type) << ", "
+           << int(watch_point->size) << " bytes at 0x" << std::hex << watch_point->address
+           << ") triggered";
+        logMessages({{false, ss.str()}});
+      }
+    }
 
-    if (process->getStatus() == Process::Status::kStopped and
-        ignored_signals[static_cast<size_t>(event.getSignal())] and
-        event.getSignal() != Signal::kSIGCONT) {
-      process->updateStatus(Process::Status::kRunning);
-      emit ignoredEvent(event);
-      return {event.getSignal(), event.getStatus(), true, false};
+    if (auto id = res.getPageWatchPoint()) {
+      const auto& watch_points = breakpoint_handler->getPageWatchPoints().getWatchPoints();
+      auto it = watch_points.find(*id);
+      if (it != watch_points.end()) {
+        std::stringstream ss;
+        ss << "Page watch point " << it->first << " ("
+           << HardwareBreakPoints::getTypeName(it->second.type) << ", " << it->second.size
+           << " bytes at 0x" << std::hex << it->second.address << ") triggered";
+        logMessages({{false, ss.str()}});
+      }
     }
-    emit signalReceived(event);
-    return event;
-  }
 
-  void QtSignalHandler::resumeTracee(SignalEvent event) {
-    process->resume();
+    // Emitted from the tracer thread, the connections to the views are queued
+    emit signalReceived(res);
+    return res;
   }
 
-  void QtSignalHandler::resetBreakpoint() {
-    if (not breakpoint_handler->isAtBreakpoint()) return;
-    breakpoint_handler->resetBreakpoint();
-    ptrace(PTRACE_SINGLESTEP, process->getPid(), nullptr, nullptr);
-    waitpid(process->getPid(), nullptr, 0);
+  void QtSignalHandler::internalBreakpointChanged() {
+    emit internalBreakpoint();
   }
 
+  void QtSignalHandler::logMessages(std::vector<BreakPointMessage>&& messages) {
+    bool queued = false;
+    {
+      std::scoped_lock<std::mutex> lock(messages_mutex);
+      // A flush is already queued if messages are pending
+      queued = not pending_messages.empty();
+      std::move(messages.begin(), messages.end(), std::back_inserter(pending_messages));
+    }
+    if (not queued)
+      QMetaObject::invokeMethod(this, [this]() { flushMessages(); }, Qt::QueuedConnection);
+  }
 
-  void QtSignalHandler::workerLoop() {
-    while (not worker_exit) {
-      // Wait for 100ms
-      std::optional<SignalEvent> event = waitEvent(10000000);
-      if (event) {
-        handleEvent(*event);
-        if (event->getStatus() == Process::Status::kDead or
-            event->getStatus() == Process::Status::kExited or
-            event->getStatus() == Process::Status::kKilled) {
-          break;
-        }
-      }
-      if (is_muted and not worker_exit) {
-        std::unique_lock<std::mutex> l(mutex);
-        worker_waiting = true;
-        update_cv.notify_one();
-        update_cv.wait(l);
-        worker_waiting = false;
-      }
+  void QtSignalHandler::flushMessages() {
+    std::vector<BreakPointMessage> messages;
+    {
+      std::scoped_lock<std::mutex> lock(messages_mutex);
+      messages.swap(pending_messages);
     }
+    SignalHandler::logMessages(std::move(messages));
   }
 
-}// namespace ldb::gui
\ No newline at end of file
+}// namespace ldb::gui
@@ -1,7 +1,10 @@
 #include "TracerPanel.h"
 #include "CommandDialog.h"
+#include "CoverageView.h"
 #include "LibraryView.h"
+#include "ProfileView.h"
 #include "PtyHandler.h"
+#include "TraceView.h"
 #include "logWidget.h"
 #include <QHBoxLayout>
 #include <QMessageBox>
@@ -80,6 +83,21 @@ namespace ldb::gui {
     information_tab->addTab(libs, "Libraries");
     information_tab->setTabIcon(2, QIcon(":/icons/list-settings-line.png"));
 
+    // Setup the tab where the values recorded by the trace points will be displayed
+    auto trace_view = new TraceView(this);
+    information_tab->addTab(trace_view, "Trace points");
+    information_tab->setTabIcon(3, QIcon(":/icons/menu-2-line.png"));
+
+    // Setup the tab where the latency of the profiled functions will be displayed
+    auto profile_view = new ProfileView(this);
+    information_tab->addTab(profile_view, "Profile");
+    information_tab->setTabIcon(4, QIcon(":/icons/menu-2-line.png"));
+
+    // Setup the tab where the code reached by the process will be displayed
+    auto coverage_view = new CoverageView(this);
+    information_tab->addTab(coverage_view, "Coverage");
+    information_tab->setTabIcon(5, QIcon(":/icons/menu-2-line.png"));
+
     auto* message_tabs = new QTabWidget(bottom_splitter);
     message_tabs->setIconSize(QSize(16, 16));
     message_tabs->setTabPosition(QTabWidget::South);
@@ -215,6 +233,8 @@ namespace ldb::gui {
       // Setup a new signal handler
       auto* sighandler = process_tracer->makeSignalHandler<QtSignalHandler>();
       connect(sighandler, &QtSignalHandler::signalReceived, this, &TracerPanel::signalReceived);
+      connect(sighandler, &QtSignalHandler::internalBreakpoint, this,
+              &TracerPanel::librariesChanged);
 
       // Emit signals to update the UI accordingly
       emit executionStarted();
@@ -237,6 +257,8 @@ namespace ldb::gui {
       if (res == QMessageBox::No) return;
     }
 
+    // The symbol index may still be built from the table of the tracer
+    breakpoints_dialog->clearModel();
     // No need to manually kill the process tracer, it will end itself
     process_tracer = nullptr;
 
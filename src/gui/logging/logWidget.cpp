@@ -26,8 +26,16 @@ namespace ldb::gui {
 
     ss << log.prefix(parent_handler->tsType()) << message;
 
-    text_edit->setTextColor(QColor(color_map[log.level()]));
-    text_edit->append(QString::fromStdString(ss.str()));
-    text_edit->ensureCursorVisible();
+    // Messages are logged from the tracer thread as well, the text is only appended from this one
+    QColor color(color_map[log.level()]);
+    QString text = QString::fromStdString(ss.str());
+    QMetaObject::invokeMethod(
+            this,
+            [this, color, text]() {
+              text_edit->setTextColor(color);
+              text_edit->append(text);
+              text_edit->ensureCursorVisible();
+            },
+            Qt::AutoConnection);
   }
 }// namespace ldb::gui
\ No newline at end of file
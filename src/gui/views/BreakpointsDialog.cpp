@@ -1,11 +1,65 @@
 #include "BreakpointsDialog.h"
 #include "gui/TracerPanel.h"
+#include <QFont>
 #include <QHeaderView>
 #include <QVBoxLayout>
+#include <algorithm>
 
 namespace ldb::gui {
 
   namespace {
+    // Both models display the symbols the same way
+    QVariant symbolData(const Symbol& symbol, int column) {
+      switch (column) {
+        case 0:
+          return QVariant::fromValue("0x" + QString::number(symbol.getAddress(), 16));
+        case 1: {
+          auto name = symbol.getDemangledName();
+          return QVariant::fromValue(QString::fromUtf8(name.data(), name.size()));
+        }
+        case 2:
+          return QVariant::fromValue(QString::fromStdString(symbol.getFile().string()));
+        default:
+          return {};
+      }
+    }
+
+    QVariant symbolHeader(int section, Qt::Orientation orientation, int role) {
+      if (role != Qt::DisplayRole or orientation != Qt::Horizontal) return {};
+      switch (section) {
+        case 0:
+          return "Address";
+        case 1:
+          return "Name";
+        case 2:
+          return "File";
+        default:
+          return {};
+      }
+    }
+
+    // The caller holds the lock of the tracer
+    bool isBreakpoint(TracerPanel* tracer_panel, const Symbol* sym) {
+      auto* tracer = tracer_panel->getTracer();
+      if (not tracer) return false;
+      auto* breakpoints = tracer->getBreakPointHandler();
+      if (not breakpoints) return false;
+      return breakpoints->isBreakPoint(sym->getAddress());
+    }
+
+    // Runs on the tracer thread, which writes the break points into the process
+    void toggleBreakpoint(ProcessTracer* tracer, const Symbol& symbol) {
+      auto* breakpoints = tracer->getBreakPointHandler();
+      if (not breakpoints) return;
+
+      if (breakpoints->isBreakPoint(symbol.getAddress())) breakpoints->remove(symbol);
+      else
+        breakpoints->add(symbol);
+    }
+
+    // Number of rows handed to the view at once
+    constexpr int kFetchSize = 256;
+
     // We define our own proxy model to be able to sort by breakpoints status
     //
     // Since QModels must operate on any model, if we're not dealing with a BreakpointModel model,
@@ -43,10 +97,15 @@ namespace ldb::gui {
     bool BreakpointSortProxyModel::filterAcceptsRow(int sourceRow,
                                                     const QModelIndex& sourceParent) const {
       if (not source_model) return QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
-      auto* sym = source_model->getSymbol(sourceRow);
-      if (sym == nullptr) { return false; }
-      return ((show_breakpoints and source_model->isBreakpoint(sym)) or
-              (not show_breakpoints and not source_model->isBreakpoint(sym))) and
+      bool breakpoint = false;
+      {
+        auto lock = source_model->lockTracer();
+        auto* sym = source_model->getSymbol(sourceRow);
+        if (sym == nullptr) { return false; }
+        breakpoint = source_model->isBreakpoint(sym);
+      }
+      // Reads the data of the row, which locks the tracer again
+      return ((show_breakpoints and breakpoint) or (not show_breakpoints and not breakpoint)) and
              QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
     }
 
@@ -54,8 +113,13 @@ namespace ldb::gui {
                                             const QModelIndex& right) const {
       if (not source_model) return QSortFilterProxyModel::lessThan(left, right);
 
-      auto left_data = source_model->getSymbol(left.row());
-      auto right_data = source_model->getSymbol(left.row());
+      const Symbol* left_data = nullptr;
+      const Symbol* right_data = nullptr;
+      {
+        auto lock = source_model->lockTracer();
+        left_data = source_model->getSymbol(left.row());
+        right_data = source_model->getSymbol(left.row());
+      }
 
       if (not left_data) {
         return false;
@@ -80,6 +144,7 @@ namespace ldb::gui {
       : QAbstractTableModel(parent), tracer_panel(tp) {}
 
   int BreakpointModel::rowCount(const QModelIndex& parent) const {
+    auto lock = lockTracer();
     auto* tracer = tracer_panel->getTracer();
 
     const SymbolTable* symtab = nullptr;
@@ -99,43 +164,20 @@ namespace ldb::gui {
   QVariant BreakpointModel::data(const QModelIndex& index, int role) const {
     if (not index.isValid()) return {};
     if (role == Qt::DisplayRole) {
+      auto lock = lockTracer();
       auto* tracer = tracer_panel->getTracer();
       const SymbolTable* symtab = nullptr;
       if (not tracer or not(symtab = tracer->getSymbolTable())) return {};
 
       auto* symbol = symtab->at(index.row());
       if (not symbol) return {};
-
-      switch (index.column()) {
-        case 0:
-          return QVariant::fromValue("0x" + QString::number(symbol->getAddress(), 16));
-        case 1:
-          return QVariant::fromValue(QString::fromStdString(symbol->getName()));
-        case 2:
-          return QVariant::fromValue(QString::fromStdString(symbol->getFile().string()));
-        default:
-          return {};
-      }
+      return symbolData(*symbol, index.column());
     }
     return {};
   }
 
   QVariant BreakpointModel::headerData(int section, Qt::Orientation orientation, int role) const {
-    if (role == Qt::DisplayRole) {
-      if (orientation == Qt::Horizontal) {
-        switch (section) {
-          case 0:
-            return "Address";
-          case 1:
-            return "Name";
-          case 2:
-            return "File";
-          default:
-            return {};
-        }
-      }
-    }
-    return {};
+    return symbolHeader(section, orientation, role);
   }
 
   const Symbol* BreakpointModel::getSymbol(int row) const {
@@ -150,32 +192,199 @@ namespace ldb::gui {
   }
 
   bool BreakpointModel::isBreakpoint(const Symbol* sym) const {
-    auto* tracer = tracer_panel->getTracer();
-    if (not tracer) return false;
-    auto* breakpoints = tracer->getBreakPointHandler();
-    if (not breakpoints) return false;
-    return breakpoints->isBreakPoint(sym->getAddress());
+    return gui::isBreakpoint(tracer_panel, sym);
+  }
+
+  std::unique_lock<std::mutex> BreakpointModel::lockTracer() const {
+    return tracer_panel->lockTracer();
   }
 
   void BreakpointModel::toggleBreakpoint(const QModelIndex& pos) {
     auto* tracer = tracer_panel->getTracer();
     if (not tracer) return;
-    auto* breakpoints = tracer->getBreakPointHandler();
-    if (not breakpoints) return;
-    auto* debug_info = tracer->getDebugInfo();
-    if (not debug_info) return;
-    auto* symtab = debug_info->getSymbolTable();
-    if (not symtab) return;
-
-    auto* symbol = symtab->at(pos.row());
-    if (not symbol) return;
 
-    if (isBreakpoint(symbol)) breakpoints->remove(*symbol);
-    else
-      breakpoints->add(*symbol);
+    // The table is only read from the tracer thread, which may be updating it
+    tracer->execute([tracer, row = pos.row()]() {
+      auto* symtab = tracer->getSymbolTable();
+      auto* symbol = symtab ? symtab->at(row) : nullptr;
+      if (symbol) gui::toggleBreakpoint(tracer, *symbol);
+    });
     emit dataChanged(pos, pos);
   }
 
+  SymbolSearchModel::SymbolSearchModel(QObject* parent, TracerPanel* tp)
+      : QAbstractTableModel(parent), tracer_panel(tp) {
+    worker.setMaxThreadCount(1);
+  }
+
+  SymbolSearchModel::~SymbolSearchModel() {
+    cancel();
+    worker.clear();
+    worker.waitForDone();
+  }
+
+  int SymbolSearchModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return loaded;
+  }
+
+  int SymbolSearchModel::columnCount(const QModelIndex& parent) const {
+    return 3;
+  }
+
+  QVariant SymbolSearchModel::data(const QModelIndex& index, int role) const {
+    if (not index.isValid()) return {};
+    // The symbols and break points are updated by the tracer thread
+    auto lock = tracer_panel->lockTracer();
+    auto* symbol = getSymbol(index.row());
+    if (not symbol) return {};
+
+    if (role == Qt::DisplayRole) return symbolData(*symbol, index.column());
+    if (role == Qt::FontRole and gui::isBreakpoint(tracer_panel, symbol)) {
+      // Symbols that already have a breakpoint are shown in bold
+      QFont font;
+      font.setBold(true);
+      return font;
+    }
+    return {};
+  }
+
+  QVariant SymbolSearchModel::headerData(int section, Qt::Orientation orientation,
+                                         int role) const {
+    return symbolHeader(section, orientation, role);
+  }
+
+  bool SymbolSearchModel::canFetchMore(const QModelIndex& parent) const {
+    return not parent.isValid() and static_cast<size_t>(loaded) < results.size();
+  }
+
+  void SymbolSearchModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid()) return;
+    int count = static_cast<int>(std::min<size_t>(kFetchSize, results.size() - loaded));
+    if (count <= 0) return;
+
+    beginInsertRows(QModelIndex(), loaded, loaded + count - 1);
+    loaded += count;
+    endInsertRows();
+  }
+
+  const Symbol* SymbolSearchModel::getSymbol(int row) const {
+    if (not symbol_index or row < 0 or row >= loaded) return nullptr;
+    auto* tracer = tracer_panel->getTracer();
+    if (not tracer or tracer->getSymbolsGeneration() != index_generation) return nullptr;
+    return symbol_index->getSymbol(results[row]);
+  }
+
+  void SymbolSearchModel::toggleBreakpoint(const QModelIndex& pos) {
+    auto* tracer = tracer_panel->getTracer();
+    int row = pos.row();
+    if (not tracer or not symbol_index or row < 0 or row >= loaded) return;
+    // The symbol is only read on the tracer thread, once it is known to be alive
+    tracer->execute([tracer, index = symbol_index, id = results[row],
+                     generation = index_generation]() {
+      if (tracer->getSymbolsGeneration() != generation) return;
+      gui::toggleBreakpoint(tracer, *index->getSymbol(id));
+    });
+    emit dataChanged(pos.siblingAtColumn(0), pos.siblingAtColumn(columnCount() - 1));
+  }
+
+  void SymbolSearchModel::refreshBreakpoints() {
+    if (loaded == 0) return;
+    emit dataChanged(index(0, 0), index(loaded - 1, columnCount() - 1),
+                     {Qt::FontRole});
+  }
+
+  void SymbolSearchModel::setSymbols(ProcessTracer* tracer) {
+    cancel();
+    if (building) {
+      // The build reads the previous table, which may be about to change
+      worker.clear();
+      worker.waitForDone();
+      building = false;
+    }
+    uint64_t index_id = ++current_index;
+    setIndex(index_id, nullptr, 0);
+    if (not tracer) return;
+
+    // Demangling and copying the names takes a while for large programs
+    building = true;
+    worker.start([this, tracer, index_id]() {
+      std::shared_ptr<const SymbolIndex> index;
+      uint64_t generation = 0;
+      {
+        // The tracer thread updates the table when libraries are loaded
+        auto lock = tracer->lock();
+        const auto* symbols = tracer->getSymbolTable();
+        if (not symbols) return;
+        index = std::make_shared<const SymbolIndex>(*symbols);
+        generation = tracer->getSymbolsGeneration();
+      }
+      index->prepareSearch();
+      QMetaObject::invokeMethod(
+              this,
+              [this, index, index_id, generation]() { setIndex(index_id, index, generation); },
+              Qt::QueuedConnection);
+    });
+  }
+
+  void SymbolSearchModel::setIndex(uint64_t index_id, std::shared_ptr<const SymbolIndex> new_index,
+                                   uint64_t generation) {
+    // This index was built for a table that was replaced since
+    if (index_id != current_index) return;
+    if (new_index) building = false;
+    symbol_index = std::move(new_index);
+    index_generation = generation;
+    search(last_query);
+  }
+
+  void SymbolSearchModel::search(const QString& query) {
+    last_query = query;
+    cancel();
+
+    beginResetModel();
+    results.clear();
+    loaded = 0;
+    endResetModel();
+    if (not symbol_index) return;
+
+    uint64_t search_id = ++current_search;
+    auto searched = symbol_index;
+    auto flag = cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::string text = query.toStdString();
+    worker.start([this, searched, flag, text, search_id]() {
+      // Replaced before it even started
+      if (*flag) return;
+      searched->search(
+              text,
+              [this, search_id](std::vector<SymbolIndex::Match>&& batch) {
+                // Models can only be modified from the GUI thread
+                QMetaObject::invokeMethod(
+                        this,
+                        [this, search_id, batch = std::move(batch)]() mutable {
+                          receive(search_id, std::move(batch));
+                        },
+                        Qt::QueuedConnection);
+                return true;
+              },
+              *flag);
+    });
+  }
+
+  void SymbolSearchModel::cancel() {
+    if (cancelled) *cancelled = true;
+    cancelled = nullptr;
+  }
+
+  void SymbolSearchModel::receive(uint64_t search_id, std::vector<SymbolIndex::Match>&& batch) {
+    // This batch belongs to a search that was replaced since
+    if (search_id != current_search) return;
+
+    results.reserve(results.size() + batch.size());
+    for (const auto& match : batch) results.push_back(match.id);
+    // Fill the first page, the view asks for the next ones when it is scrolled
+    if (loaded < kFetchSize) fetchMore(QModelIndex());
+  }
+
   BreakpointsDialog::BreakpointsDialog(TracerPanel* parent) : TracerView(parent), model(nullptr) {
     auto* layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
@@ -209,6 +418,15 @@ namespace ldb::gui {
     function_list->setWordWrap(true);
     search_layout->addWidget(function_list);
 
+    search_model = new SymbolSearchModel(this, tracer_panel);
+    function_list->setModel(search_model);
+    connect(search_bar, &QLineEdit::textChanged, search_model, &SymbolSearchModel::search);
+    connect(function_list, &QTableView::doubleClicked, search_model,
+            [this](const QModelIndex& index) {
+              search_model->toggleBreakpoint(index);
+              if (breakpoint_proxy) breakpoint_proxy->invalidate();
+            });
+
     QWidget* active_breakpoint_panel = new QWidget(this);
     QVBoxLayout* active_layout = new QVBoxLayout(active_breakpoint_panel);
     active_layout->setContentsMargins(0, 0, 0, 0);
@@ -226,6 +444,7 @@ namespace ldb::gui {
     active_layout->addWidget(breakpoint_list);
 
     connect(parent, &TracerPanel::executionStarted, this, &BreakpointsDialog::makeModel);
+    connect(parent, &TracerPanel::librariesChanged, this, &BreakpointsDialog::makeModel);
     connect(parent, &TracerPanel::executionEnded, this, &BreakpointsDialog::clearModel);
     clearModel();
   }
@@ -233,26 +452,22 @@ namespace ldb::gui {
   void BreakpointsDialog::makeModel() {
     clearModel();
     model->update();
+
+    search_model->setSymbols(tracer_panel->getTracer());
   }
 
   void BreakpointsDialog::clearModel() {
     delete model;
     model = new BreakpointModel(this, tracer_panel);
-    search_proxy = new BreakpointSortProxyModel(model, false);
-    search_proxy->setFilterKeyColumn(1);
-    search_proxy->setFilterFixedString(search_bar->text());
-    function_list->setModel(search_proxy);
-    connect(function_list, &QTableView::doubleClicked, model, [&](const QModelIndex& index) {
-      model->toggleBreakpoint(search_proxy->mapToSource(index));
-    });
-    connect(search_bar, &QLineEdit::textChanged, search_proxy,
-            &QSortFilterProxyModel::setFilterFixedString);
+    // The index points into the symbol table, which may be about to change
+    search_model->setSymbols(nullptr);
 
     breakpoint_proxy = new BreakpointSortProxyModel(model, true);
     breakpoint_proxy->setFilterKeyColumn(1);
     breakpoint_list->setModel(breakpoint_proxy);
     connect(breakpoint_list, &QTableView::doubleClicked, model, [&](const QModelIndex& index) {
       model->toggleBreakpoint(breakpoint_proxy->mapToSource(index));
+      search_model->refreshBreakpoints();
     });
   }
 
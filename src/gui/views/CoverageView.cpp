@@ -0,0 +1,253 @@
+#include "CoverageView.h"
+#include "gui/TracerPanel.h"
+#include <QColor>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <fstream>
+#include <tscl.hpp>
+
+namespace ldb::gui {
+
+  namespace {
+    // Interval between two refreshes of the table while the process runs
+    constexpr int kRefreshInterval = 500;
+
+    size_t countCovered(const CodeCoverage& coverage, const CodeCoverage::Function& function) {
+      const auto& probes = coverage.getProbes();
+      return std::count_if(probes.begin() + function.first_probe,
+                           probes.begin() + function.first_probe + function.probe_count,
+                           [](const auto& probe) { return probe.covered; });
+    }
+  }// namespace
+
+  CoverageModel::CoverageModel(QObject* parent, TracerPanel* tp)
+      : QAbstractTableModel(parent), tracer_panel(tp) {}
+
+  int CoverageModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid() or not coverage) return 0;
+    return coverage->getFunctions().size();
+  }
+
+  int CoverageModel::columnCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return 3;
+  }
+
+  QVariant CoverageModel::data(const QModelIndex& index, int role) const {
+    if (not index.isValid() or not coverage) return {};
+    if (role != Qt::DisplayRole and role != Qt::ForegroundRole) return {};
+    // Probes are covered by the tracer thread
+    auto lock = tracer_panel->lockTracer();
+    const auto& function = coverage->getFunctions()[index.row()];
+    if (role == Qt::ForegroundRole)
+      return coverage->isCovered(function) ? QVariant() : QVariant(QColor(Qt::red));
+
+    switch (index.column()) {
+      case 0:
+        return QString::fromStdString(function.name);
+      case 1:
+        if (function.line == 0) return {};
+        return QString::fromStdString(coverage->getFile(function.file).filename().string()) +
+               ":" + QString::number(function.line);
+      default:
+        return QString::number(countCovered(*coverage, function)) + " / " +
+               QString::number(function.probe_count);
+    }
+  }
+
+  QVariant CoverageModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole or orientation != Qt::Horizontal) return {};
+    switch (section) {
+      case 0:
+        return "Function";
+      case 1:
+        return "Location";
+      default:
+        return "Covered probes";
+    }
+  }
+
+  void CoverageModel::setCoverage(std::shared_ptr<CodeCoverage> new_coverage) {
+    beginResetModel();
+    coverage = std::move(new_coverage);
+    {
+      auto lock = tracer_panel->lockTracer();
+      shown = coverage ? coverage->getCoveredProbes() : 0;
+    }
+    endResetModel();
+  }
+
+  void CoverageModel::refresh() {
+    if (not coverage) return;
+    size_t covered = 0;
+    {
+      auto lock = tracer_panel->lockTracer();
+      covered = coverage->getCoveredProbes();
+    }
+    if (covered == shown) return;
+    shown = covered;
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+  }
+
+  CoverageView::CoverageView(TracerPanel* parent) : QWidget(parent), TracerView(parent) {
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+
+    auto* run_layout = new QHBoxLayout();
+    granularity = new QComboBox(this);
+    granularity->addItem("Functions", int(CodeCoverage::Granularity::kFunction));
+    granularity->addItem("Lines", int(CodeCoverage::Granularity::kLine));
+    run_layout->addWidget(granularity);
+    report = new QLineEdit(this);
+    report->setPlaceholderText("Report written when the process exits, e.g. coverage.info");
+    run_layout->addWidget(report, 1);
+    auto* start_button = new QPushButton("Start", this);
+    run_layout->addWidget(start_button);
+    auto* stop_button = new QPushButton("Stop", this);
+    run_layout->addWidget(stop_button);
+    auto* export_button = new QPushButton("Export", this);
+    run_layout->addWidget(export_button);
+    layout->addLayout(run_layout);
+
+    summary = new QLabel(this);
+    layout->addWidget(summary);
+
+    table = new QTableView(this);
+    table->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(table);
+
+    model = new CoverageModel(this, parent);
+    table->setModel(model);
+
+    connect(start_button, &QPushButton::clicked, this, &CoverageView::startCoverage);
+    connect(stop_button, &QPushButton::clicked, this, &CoverageView::stopCoverage);
+    connect(export_button, &QPushButton::clicked, this, &CoverageView::exportCoverage);
+
+    refresh_timer = new QTimer(this);
+    connect(refresh_timer, &QTimer::timeout, this, &CoverageView::updateSummary);
+    refresh_timer->start(kRefreshInterval);
+
+    connect(parent, &TracerPanel::executionStarted, this, &CoverageView::clearView);
+    connect(parent, &TracerPanel::signalReceived, this, &CoverageView::updateStatus);
+    connect(parent, &TracerPanel::executionEnded, this, &CoverageView::writeReport);
+  }
+
+  void CoverageView::startCoverage() {
+    auto* tracer = tracer_panel->getTracer();
+    if (not tracer) return;
+
+    // The probes are set from the tracer thread, which also updates the symbol table
+    auto selected = CodeCoverage::Granularity(granularity->currentData().toInt());
+    auto coverage = tracer->execute([tracer, selected]() -> std::shared_ptr<CodeCoverage> {
+      auto* breakpoints = tracer->getBreakPointHandler();
+      const auto* symbols = tracer->getSymbolTable();
+      if (not breakpoints or not symbols) return nullptr;
+
+      // The head of the chain is the executable
+      auto res = std::make_shared<CodeCoverage>(*symbols, symbols->getObjectFile(), selected);
+      size_t set = breakpoints->startCoverage(res);
+      if (set < res->getProbes().size()) {
+        tscl::logger(std::to_string(res->getProbes().size() - set) +
+                             " coverage probes were already break points, or could not be set",
+                     tscl::Log::Warning);
+      }
+      return res;
+    });
+    if (not coverage) return;
+    model->setCoverage(coverage);
+    reported = false;
+    updateSummary();
+  }
+
+  void CoverageView::stopCoverage() {
+    auto* tracer = tracer_panel->getTracer();
+    if (tracer and tracer->getBreakPointHandler())
+      tracer->execute([tracer]() { tracer->getBreakPointHandler()->stopCoverage(); });
+  }
+
+  void CoverageView::updateSummary() {
+    model->refresh();
+    const auto& coverage = model->getCoverage();
+    if (not coverage) {
+      summary->clear();
+      return;
+    }
+    size_t functions = 0;
+    size_t probes = 0;
+    {
+      auto lock = tracer_panel->lockTracer();
+      for (const auto& function : coverage->getFunctions())
+        functions += coverage->isCovered(function);
+      probes = coverage->getCoveredProbes();
+    }
+    summary->setText(QString("%1 / %2 functions, %3 / %4 probes covered")
+                             .arg(functions)
+                             .arg(coverage->getFunctions().size())
+                             .arg(probes)
+                             .arg(coverage->getProbes().size()));
+  }
+
+  void CoverageView::updateStatus(SignalEvent event) {
+    if (event.getStatus() == Process::Status::kExited or
+        event.getStatus() == Process::Status::kKilled or
+        event.getStatus() == Process::Status::kDead)
+      writeReport();
+    else
+      updateSummary();
+  }
+
+  void CoverageView::writeReport() {
+    updateSummary();
+    const auto& coverage = model->getCoverage();
+    QString path = report->text().trimmed();
+    if (not coverage or reported or path.isEmpty()) return;
+
+    reported = true;
+    std::ofstream file(path.toStdString());
+    bool written = false;
+    {
+      auto lock = tracer_panel->lockTracer();
+      written = file and coverage->exportLcov(file);
+    }
+    if (not written) {
+      tscl::logger("Failed to write the coverage report " + path.toStdString(), tscl::Log::Error);
+      return;
+    }
+    tscl::logger("Coverage report written to " + path.toStdString(), tscl::Log::Information);
+  }
+
+  void CoverageView::exportCoverage() {
+    const auto& coverage = model->getCoverage();
+    if (not coverage) return;
+    QString path = QFileDialog::getSaveFileName(this, "Export coverage", "coverage.info",
+                                                "lcov tracefile (*.info)");
+    if (path.isEmpty()) return;
+
+    std::ofstream file(path.toStdString());
+    bool written = false;
+    {
+      auto lock = tracer_panel->lockTracer();
+      written = file and coverage->exportLcov(file);
+    }
+    if (not written)
+      QMessageBox::warning(this, "Export coverage", "Failed to write " + path);
+  }
+
+  void CoverageView::clearView() {
+    // The probes are gone with the previous process
+    model->setCoverage(nullptr);
+    reported = false;
+    updateSummary();
+  }
+
+}// namespace ldb::gui
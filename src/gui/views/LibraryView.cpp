@@ -25,6 +25,7 @@ namespace ldb::gui {
 
     connect(parent, &TracerPanel::executionStarted, this, &LibraryView::onExecutionStarted);
     connect(parent, &TracerPanel::signalReceived, this, &LibraryView::onExecutionStarted);
+    connect(parent, &TracerPanel::librariesChanged, this, &LibraryView::onExecutionStarted);
     connect(parent, &TracerPanel::executionEnded, this, &LibraryView::clearContents);
   }
 
@@ -34,16 +35,22 @@ namespace ldb::gui {
 
     if (not tracer) return;
 
-    const auto* debug_info = tracer->getDebugInfo();
+    // The libraries are updated by the tracer thread, while the process runs
+    std::vector<QString> libraries;
+    {
+      auto lock = tracer_panel->lockTracer();
+      const auto* debug_info = tracer->getDebugInfo();
 
-    if (not debug_info) return;
+      if (not debug_info) return;
 
-    const auto& libraries = debug_info->getSharedLibraries();
+      for (const auto& library : debug_info->getSharedLibraries())
+        libraries.push_back(QString::fromStdString(library));
+    }
     setRowCount(libraries.size());
 
     int i = 0;
     for (const auto& library : libraries) {
-      setItem(i, 0, new QTableWidgetItem(QString::fromStdString(library)));
+      setItem(i, 0, new QTableWidgetItem(library));
       i++;
     }
   }
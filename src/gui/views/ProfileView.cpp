@@ -0,0 +1,244 @@
+#include "ProfileView.h"
+#include "gui/TracerPanel.h"
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <fstream>
+#include <iterator>
+
+namespace ldb::gui {
+
+  namespace {
+    // Interval between two refreshes of the table while the process runs
+    constexpr int kRefreshInterval = 500;
+
+    // Columns before the percentiles of the latency, and after them
+    constexpr int kLeadingColumns = 5;
+    constexpr int kTrailingColumns = 1;
+    constexpr int kPercentileCount = std::size(FunctionProfiler::kPercentiles);
+
+    QString toMicroseconds(double nanoseconds) {
+      return QString::number(nanoseconds / 1e3, 'f', 1);
+    }
+  }// namespace
+
+  ProfileModel::ProfileModel(QObject* parent, TracerPanel* tp)
+      : QAbstractTableModel(parent), tracer_panel(tp) {}
+
+  int ProfileModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return size;
+  }
+
+  int ProfileModel::columnCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return kLeadingColumns + kPercentileCount + kTrailingColumns;
+  }
+
+  const FunctionProfiler::Function* ProfileModel::getFunction(int row) const {
+    if (not profiler or row >= size) return nullptr;
+    const auto& functions = profiler->getFunctions();
+    if (row >= int(functions.size())) return nullptr;
+    return &std::next(functions.begin(), row)->second;
+  }
+
+  QVariant ProfileModel::data(const QModelIndex& index, int role) const {
+    if (not index.isValid() or role != Qt::DisplayRole) return {};
+    // Calls are counted by the tracer thread
+    auto lock = tracer_panel->lockTracer();
+    const auto* function = getFunction(index.row());
+    if (not function) return {};
+
+    const auto& latency = function->latency;
+    int column = index.column();
+    switch (column) {
+      case 0:
+        return QString::fromStdString(function->name);
+      case 1:
+        return QVariant::fromValue(function->calls);
+      case 2:
+        return QVariant::fromValue(function->unwound);
+      case 3:
+        return QVariant::fromValue(function->max_depth);
+      case 4:
+        return toMicroseconds(latency.getMean());
+      default:
+        break;
+    }
+    column -= kLeadingColumns;
+    if (column < kPercentileCount)
+      return toMicroseconds(latency.getPercentile(FunctionProfiler::kPercentiles[column]));
+    return toMicroseconds(latency.getMax());
+  }
+
+  QVariant ProfileModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole or orientation != Qt::Horizontal) return {};
+    switch (section) {
+      case 0:
+        return "Function";
+      case 1:
+        return "Calls";
+      case 2:
+        return "Unwound";
+      case 3:
+        return "Max depth";
+      case 4:
+        return "Mean (µs)";
+      default:
+        break;
+    }
+    section -= kLeadingColumns;
+    if (section < kPercentileCount)
+      return "p" + QString::number(FunctionProfiler::kPercentiles[section]) + " (µs)";
+    return "Max (µs)";
+  }
+
+  void ProfileModel::setProfiler(std::shared_ptr<FunctionProfiler> new_profiler) {
+    int new_size = 0;
+    if (new_profiler) {
+      auto lock = tracer_panel->lockTracer();
+      new_size = new_profiler->getFunctions().size();
+    }
+    beginResetModel();
+    profiler = std::move(new_profiler);
+    size = new_size;
+    endResetModel();
+  }
+
+  void ProfileModel::refresh() {
+    if (not profiler) return;
+    int new_size = 0;
+    {
+      auto lock = tracer_panel->lockTracer();
+      new_size = profiler->getFunctions().size();
+    }
+    if (new_size != size) {
+      beginResetModel();
+      size = new_size;
+      endResetModel();
+    } else if (size > 0)
+      emit dataChanged(index(0, 0), index(size - 1, columnCount() - 1));
+  }
+
+  ProfileView::ProfileView(TracerPanel* parent) : QWidget(parent), TracerView(parent) {
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+
+    auto* add_layout = new QHBoxLayout();
+    location = new QLineEdit(this);
+    location->setPlaceholderText("Function or address");
+    add_layout->addWidget(location, 1);
+    auto* add_button = new QPushButton("Profile", this);
+    add_layout->addWidget(add_button);
+    auto* clear_button = new QPushButton("Clear", this);
+    add_layout->addWidget(clear_button);
+    auto* export_button = new QPushButton("Export", this);
+    add_layout->addWidget(export_button);
+    layout->addLayout(add_layout);
+
+    table = new QTableView(this);
+    table->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(table);
+
+    model = new ProfileModel(this, parent);
+    model->setProfiler(std::make_shared<FunctionProfiler>());
+    table->setModel(model);
+
+    connect(add_button, &QPushButton::clicked, this, &ProfileView::addFunction);
+    connect(location, &QLineEdit::returnPressed, this, &ProfileView::addFunction);
+    connect(clear_button, &QPushButton::clicked, this, &ProfileView::clearProfile);
+    connect(export_button, &QPushButton::clicked, this, &ProfileView::exportProfile);
+
+    refresh_timer = new QTimer(this);
+    connect(refresh_timer, &QTimer::timeout, model, &ProfileModel::refresh);
+    refresh_timer->start(kRefreshInterval);
+
+    connect(parent, &TracerPanel::executionStarted, this, &ProfileView::clearView);
+    connect(parent, &TracerPanel::signalReceived, model, &ProfileModel::refresh);
+    connect(parent, &TracerPanel::executionEnded, model, &ProfileModel::refresh);
+  }
+
+  void ProfileView::addFunction() {
+    auto* tracer = tracer_panel->getTracer();
+    if (not tracer) return;
+    auto* breakpoints = tracer->getBreakPointHandler();
+    if (not breakpoints) return;
+
+    std::string name = location->text().trimmed().toStdString();
+    bool is_address = false;
+    Elf64_Addr value = location->text().trimmed().toULongLong(&is_address, 16);
+    const auto& profiler = model->getProfiler();
+    // The profile point is set from the tracer thread, which also updates the symbol table
+    bool added = tracer->execute([&]() {
+      std::optional<Elf64_Addr> addr;
+      const auto* symbols = tracer->getSymbolTable();
+      if (name.starts_with("0x") and is_address) addr = value;
+      else if (symbols) {
+        if (const auto* symbol = (*symbols)[name]) addr = symbol->getAddress();
+      }
+      if (not addr) return false;
+
+      if (symbols) {
+        if (const auto* symbol = (*symbols)[*addr]) name = symbol->getDemangledName();
+      }
+      profiler->addFunction(*addr, name);
+      breakpoints->addProfilePoint(*addr, profiler);
+      return true;
+    });
+    if (not added) {
+      QMessageBox::warning(this, "Profile", "Unknown function: " + location->text());
+      return;
+    }
+    model->refresh();
+    location->clear();
+  }
+
+  void ProfileView::clearProfile() {
+    {
+      auto lock = tracer_panel->lockTracer();
+      model->getProfiler()->clear();
+    }
+    model->refresh();
+  }
+
+  void ProfileView::exportProfile() {
+    QString path = QFileDialog::getSaveFileName(this, "Export profile", "profile.csv",
+                                                "CSV (*.csv);;JSON (*.json)");
+    if (path.isEmpty()) return;
+
+    std::ofstream file(path.toStdString());
+    const auto& profiler = *model->getProfiler();
+    bool json = path.endsWith(".json", Qt::CaseInsensitive);
+    bool written = false;
+    {
+      auto lock = tracer_panel->lockTracer();
+      written = file and (json ? profiler.exportJson(file) : profiler.exportCsv(file));
+    }
+    if (not written)
+      QMessageBox::warning(this, "Export profile", "Failed to write " + path);
+  }
+
+  void ProfileView::clearView() {
+    // Profile points are kept when the process is restarted, and so is their profiler
+    auto* tracer = tracer_panel->getTracer();
+    auto* breakpoints = tracer ? tracer->getBreakPointHandler() : nullptr;
+    bool kept = false;
+    if (breakpoints) {
+      auto lock = tracer_panel->lockTracer();
+      for (const auto& [addr, profiler] : breakpoints->getProfilePoints())
+        kept = kept or profiler == model->getProfiler();
+    }
+    if (kept) model->refresh();
+    else
+      model->setProfiler(std::make_shared<FunctionProfiler>());
+  }
+
+}// namespace ldb::gui
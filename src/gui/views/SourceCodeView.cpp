@@ -195,23 +195,20 @@ namespace ldb::gui {
 
     // Iterate on the stack until we find a function we know the source file of
     for (auto& it : *stack_trace) {
-      auto res = symtab->findInTable(it.getAddress());
-      if (not res.first) continue;
-      std::filesystem::path current_object_file;
-      size_t addr = it.getAddress() + it.getOffset() - res.second->getBaseAddress();
+      size_t addr = it.getAddress() + it.getOffset();
 
       // If the process is paused, rip points to the next instruction
       // Meaning we will get the next line, and not the current one
-      // To prevent this, we subtract 1 from the address before passing it to addr2line
+      // To prevent this, we subtract 1 from the address before looking up its line
       //
       // Note that this is not true for a process that has crashed, because rip points to the
       // instruction that caused the crash
       if (tracer->getProcess().getStatus() == Process::Status::kStopped) addr -= 1;
 
-      auto tmp = addr2Line(res.second->getObjectFile(), addr);
-      if (tmp and not tmp->first.empty()) {
-        source_file = tmp->first;
-        current_line = tmp->second;
+      auto location = symtab->findLocation(addr);
+      if (location) {
+        source_file = location->file;
+        current_line = location->line;
         break;
       }
     }
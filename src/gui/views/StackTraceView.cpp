@@ -38,16 +38,25 @@ namespace ldb::gui {
 
     this->clear();
 
+    uint64_t generation = 0;
+    {
+      auto lock = tracer_panel->lockTracer();
+      generation = tracer->getSymbolsGeneration();
+    }
     auto stacktrace = tracer->getStackTrace();
     if (not stacktrace) return;
 
+    // The symbols of the frames are freed if their library was unloaded since
+    auto lock = tracer_panel->lockTracer();
+    if (tracer->getSymbolsGeneration() != generation) return;
 
     for (const auto& frame : *stacktrace) {
       auto item = new QTreeWidgetItem(this);
 
       item->setText(0, QString::number(frame.getAddress(), 16));
       item->setText(1, QString::number(frame.getOffset(), 16));
-      item->setText(2, QString::fromStdString(frame.getFunctionName()));
+      auto function_name = frame.getFunctionName();
+      item->setText(2, QString::fromUtf8(function_name.data(), function_name.size()));
 
       if (not frame.getSymbol()) continue;
       const Symbol* sym = frame.getSymbol();
@@ -0,0 +1,277 @@
+#include "TraceView.h"
+#include "gui/TracerPanel.h"
+#include <QColor>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSignalBlocker>
+#include <QVBoxLayout>
+#include <fstream>
+
+namespace ldb::gui {
+
+  namespace {
+    // Interval between two refreshes of the table while the process runs
+    constexpr int kRefreshInterval = 500;
+
+    // Leading columns of the table: the index of the hit and its time
+    constexpr int kHitColumns = 2;
+
+    QString sliceToString(std::span<const uint8_t> slice) {
+      QString res;
+      res.reserve(slice.size() * 3);
+      for (auto byte : slice) {
+        if (not res.isEmpty()) res += ' ';
+        res += QString::number(byte, 16).rightJustified(2, '0');
+      }
+      return res;
+    }
+  }// namespace
+
+  TraceModel::TraceModel(QObject* parent, TracerPanel* tp)
+      : QAbstractTableModel(parent), tracer_panel(tp) {}
+
+  int TraceModel::rowCount(const QModelIndex& parent) const {
+    if (parent.isValid()) return 0;
+    return size;
+  }
+
+  int TraceModel::columnCount(const QModelIndex& parent) const {
+    if (parent.isValid() or not buffer) return 0;
+    return kHitColumns + buffer->getColumns().size();
+  }
+
+  QVariant TraceModel::data(const QModelIndex& index, int role) const {
+    if (not index.isValid() or not buffer or index.row() >= size) return {};
+    if (role != Qt::DisplayRole and role != Qt::ForegroundRole) return {};
+    // Hits are recorded by the tracer thread
+    auto lock = tracer_panel->lockTracer();
+
+    // Rows are resolved from the refresh, hits recorded since then do not move them
+    uint64_t row = first + index.row();
+    // Rows overwritten or cleared since the last refresh are not shown anymore
+    bool overwritten = row < buffer->getFirst() or row >= buffer->getRecorded();
+    int column = index.column() - kHitColumns;
+    bool available = not overwritten and
+                     (column < 0 or (buffer->getColumns()[column].slice_size
+                                             ? buffer->getSlice(column, row).has_value()
+                                             : buffer->getValue(column, row).has_value()));
+    if (role == Qt::ForegroundRole) return available ? QVariant() : QVariant(QColor(Qt::gray));
+
+    if (index.column() == 0) return QVariant::fromValue(row);
+    if (overwritten) return "<overwritten>";
+    if (index.column() == 1) {
+      // Relative to the oldest row shown
+      double elapsed = buffer->getTimestamp(row) - start;
+      return QString::number(elapsed / 1e6, 'f', 3);
+    }
+
+    if (not available) return "<unavailable>";
+    if (buffer->getColumns()[column].slice_size)
+      return sliceToString(*buffer->getSlice(column, row));
+    int64_t value = *buffer->getValue(column, row);
+    return QString::number(value) + " (0x" + QString::number(uint64_t(value), 16) + ")";
+  }
+
+  QVariant TraceModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole or orientation != Qt::Horizontal or not buffer) return {};
+    switch (section) {
+      case 0:
+        return "Hit";
+      case 1:
+        return "Time (ms)";
+      default: {
+        const auto& column = buffer->getColumns()[section - kHitColumns];
+        QString name = QString::fromStdString(column.name);
+        if (column.slice_size) name += ":" + QString::number(column.slice_size);
+        return name;
+      }
+    }
+  }
+
+  void TraceModel::setBuffer(std::shared_ptr<TraceBuffer> new_buffer) {
+    beginResetModel();
+    buffer = std::move(new_buffer);
+    {
+      auto lock = tracer_panel->lockTracer();
+      shown = buffer ? buffer->getRecorded() : 0;
+      first = buffer ? buffer->getFirst() : 0;
+      size = buffer ? buffer->getSize() : 0;
+      start = size ? buffer->getTimestamp(first) : 0;
+    }
+    endResetModel();
+  }
+
+  void TraceModel::refresh() {
+    if (not buffer or buffer->getRecorded() == shown) return;
+    // Rows move up once the buffer is full, so the whole view is reset
+    beginResetModel();
+    {
+      auto lock = tracer_panel->lockTracer();
+      shown = buffer->getRecorded();
+      first = buffer->getFirst();
+      size = buffer->getSize();
+      start = size ? buffer->getTimestamp(first) : 0;
+    }
+    endResetModel();
+  }
+
+  TraceView::TraceView(TracerPanel* parent) : QWidget(parent), TracerView(parent) {
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+
+    auto* add_layout = new QHBoxLayout();
+    location = new QLineEdit(this);
+    location->setPlaceholderText("Function or address");
+    add_layout->addWidget(location, 1);
+    columns = new QLineEdit(this);
+    columns->setPlaceholderText("Captured values, e.g. rdi, rsi, *(long*)rdi, rsi:16");
+    add_layout->addWidget(columns, 3);
+    auto* add_button = new QPushButton("Add", this);
+    add_layout->addWidget(add_button);
+    layout->addLayout(add_layout);
+
+    auto* select_layout = new QHBoxLayout();
+    trace_points = new QComboBox(this);
+    select_layout->addWidget(trace_points, 1);
+    auto* clear_button = new QPushButton("Clear", this);
+    select_layout->addWidget(clear_button);
+    auto* export_button = new QPushButton("Export", this);
+    select_layout->addWidget(export_button);
+    layout->addLayout(select_layout);
+
+    table = new QTableView(this);
+    table->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    layout->addWidget(table);
+
+    model = new TraceModel(this, parent);
+    table->setModel(model);
+
+    connect(add_button, &QPushButton::clicked, this, &TraceView::addTracePoint);
+    connect(columns, &QLineEdit::returnPressed, this, &TraceView::addTracePoint);
+    connect(clear_button, &QPushButton::clicked, this, &TraceView::clearTrace);
+    connect(export_button, &QPushButton::clicked, this, &TraceView::exportTrace);
+    connect(trace_points, &QComboBox::currentIndexChanged, this, &TraceView::selectTracePoint);
+
+    refresh_timer = new QTimer(this);
+    connect(refresh_timer, &QTimer::timeout, model, &TraceModel::refresh);
+    refresh_timer->start(kRefreshInterval);
+
+    connect(parent, &TracerPanel::executionStarted, this, &TraceView::clearView);
+    // The process stopped, show its last hits right away
+    connect(parent, &TracerPanel::signalReceived, model, &TraceModel::refresh);
+    connect(parent, &TracerPanel::executionEnded, model, &TraceModel::refresh);
+  }
+
+  void TraceView::addTracePoint() {
+    auto* tracer = tracer_panel->getTracer();
+    if (not tracer) return;
+    auto* breakpoints = tracer->getBreakPointHandler();
+    if (not breakpoints) return;
+
+    std::string name = location->text().trimmed().toStdString();
+    bool is_address = false;
+    Elf64_Addr value = location->text().trimmed().toULongLong(&is_address, 16);
+    // The symbol table is updated by the tracer thread
+    std::optional<Elf64_Addr> addr = tracer->execute([&]() -> std::optional<Elf64_Addr> {
+      if (name.starts_with("0x") and is_address) return value;
+      const auto* symbols = tracer->getSymbolTable();
+      const auto* symbol = symbols ? (*symbols)[name] : nullptr;
+      if (symbol) return symbol->getAddress();
+      return std::nullopt;
+    });
+    if (not addr) {
+      QMessageBox::warning(this, "Trace point", "Unknown function: " + location->text());
+      return;
+    }
+
+    try {
+      auto buffer = std::make_shared<TraceBuffer>(
+              TraceBuffer::parseColumns(columns->text().toStdString()));
+      tracer->execute([&]() { breakpoints->addTracePoint(*addr, buffer); });
+    } catch (const std::exception& e) {
+      QMessageBox::warning(this, "Trace point", e.what());
+      return;
+    }
+    updateTracePoints();
+    trace_points->setCurrentIndex(trace_points->findData(QVariant::fromValue(*addr)));
+  }
+
+  void TraceView::updateTracePoints() {
+    auto* tracer = tracer_panel->getTracer();
+    std::vector<QString> labels;
+    {
+      auto lock = tracer_panel->lockTracer();
+      if (tracer and tracer->getBreakPointHandler())
+        buffers = tracer->getBreakPointHandler()->getTracePoints();
+
+      const auto* symbols = tracer ? tracer->getSymbolTable() : nullptr;
+      for (const auto& [addr, buffer] : buffers) {
+        QString label = "0x" + QString::number(addr, 16);
+        const auto* symbol = symbols ? (*symbols)[addr] : nullptr;
+        if (symbol) {
+          auto name = symbol->getDemangledName();
+          label += " " + QString::fromUtf8(name.data(), name.size());
+        }
+        labels.push_back(label);
+      }
+    }
+
+    QSignalBlocker blocker(trace_points);
+    auto selected = trace_points->currentData();
+    trace_points->clear();
+    auto label = labels.begin();
+    for (const auto& [addr, buffer] : buffers)
+      trace_points->addItem(*label++, QVariant::fromValue(addr));
+    int index = trace_points->findData(selected);
+    trace_points->setCurrentIndex(index < 0 ? 0 : index);
+    selectTracePoint(trace_points->currentIndex());
+  }
+
+  void TraceView::selectTracePoint(int index) {
+    if (index < 0) {
+      model->setBuffer(nullptr);
+      return;
+    }
+    auto it = buffers.find(trace_points->itemData(index).value<Elf64_Addr>());
+    model->setBuffer(it == buffers.end() ? nullptr : it->second);
+  }
+
+  void TraceView::clearTrace() {
+    if (not model->getBuffer()) return;
+    {
+      auto lock = tracer_panel->lockTracer();
+      model->getBuffer()->clear();
+    }
+    model->setBuffer(model->getBuffer());
+  }
+
+  void TraceView::exportTrace() {
+    auto buffer = model->getBuffer();
+    if (not buffer) return;
+    QString path = QFileDialog::getSaveFileName(this, "Export trace", "trace.ldbtrace");
+    if (path.isEmpty()) return;
+
+    std::ofstream file(path.toStdString(), std::ios::binary);
+    bool written = false;
+    {
+      auto lock = tracer_panel->lockTracer();
+      written = file and buffer->exportTo(file);
+    }
+    if (not written)
+      QMessageBox::warning(this, "Export trace", "Failed to write " + path);
+  }
+
+  void TraceView::clearView() {
+    buffers.clear();
+    updateTracePoints();
+  }
+
+}// namespace ldb::gui
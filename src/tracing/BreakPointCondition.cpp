@@ -0,0 +1,564 @@
+#include "BreakPointCondition.h"
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace ldb {
+
+  namespace {
+    struct Token {
+      enum class Kind { kNumber, kIdentifier, kPunctuator, kEnd };
+      Kind kind;
+      std::string_view text;
+      size_t position;
+      uint64_t value = 0;
+      bool is_unsigned = false;
+    };
+
+    // Longest punctuators first, so "<<" is not read as two "<"
+    constexpr std::string_view kPunctuators[] = {"||", "&&", "==", "!=", "<=", ">=", "<<", ">>",
+                                                 "|",  "^",  "&",  "<",  ">",  "+",  "-",  "*",
+                                                 "/",  "%",  "!",  "~",  "(",  ")"};
+
+    std::vector<Token> tokenize(std::string_view source) {
+      std::vector<Token> res;
+      size_t i = 0;
+      while (i < source.size()) {
+        if (std::isspace(static_cast<unsigned char>(source[i]))) {
+          i++;
+          continue;
+        }
+
+        size_t start = i;
+        if (std::isdigit(static_cast<unsigned char>(source[i]))) {
+          Token token{Token::Kind::kNumber, {}, start};
+          int base = 10;
+          if (source.substr(i, 2) == "0x" or source.substr(i, 2) == "0X") {
+            base = 16;
+            i += 2;
+          }
+          size_t digits = i;
+          for (; i < source.size() and std::isxdigit(static_cast<unsigned char>(source[i])); i++) {
+            int digit = std::isdigit(static_cast<unsigned char>(source[i]))
+                                ? source[i] - '0'
+                                : std::tolower(static_cast<unsigned char>(source[i])) - 'a' + 10;
+            if (digit >= base) break;
+            if (token.value > (UINT64_MAX - digit) / base)
+              throw std::runtime_error("Integer literal too large at " + std::to_string(start));
+            token.value = token.value * base + digit;
+          }
+          if (i == digits) throw std::runtime_error("Invalid number at " + std::to_string(start));
+          if (i < source.size() and (source[i] == 'u' or source[i] == 'U')) {
+            token.is_unsigned = true;
+            i++;
+          }
+          // As in C, a hexadecimal literal that does not fit in a long is unsigned
+          token.is_unsigned |= token.value > uint64_t(INT64_MAX);
+          token.text = source.substr(start, i - start);
+          res.push_back(token);
+          continue;
+        }
+
+        if (std::isalpha(static_cast<unsigned char>(source[i])) or source[i] == '_' or
+            source[i] == '$') {
+          i++;
+          while (i < source.size() and
+                 (std::isalnum(static_cast<unsigned char>(source[i])) or source[i] == '_'))
+            i++;
+          res.push_back({Token::Kind::kIdentifier, source.substr(start, i - start), start});
+          continue;
+        }
+
+        bool found = false;
+        for (auto punctuator : kPunctuators) {
+          if (source.substr(i, punctuator.size()) != punctuator) continue;
+          res.push_back({Token::Kind::kPunctuator, punctuator, start});
+          i += punctuator.size();
+          found = true;
+          break;
+        }
+        if (not found)
+          throw std::runtime_error("Unexpected character '" + std::string(1, source[i]) + "' at " +
+                                   std::to_string(start));
+      }
+      res.push_back({Token::Kind::kEnd, {}, source.size()});
+      return res;
+    }
+
+    struct Register {
+      uint32_t index;
+      // The low 32 bits of the register, as an int
+      bool low = false;
+    };
+
+    constexpr uint32_t registerIndex(size_t offset) {
+      return offset / sizeof(unsigned long long);
+    }
+
+    const std::unordered_map<std::string_view, Register>& getRegisters() {
+      static const std::unordered_map<std::string_view, Register> registers = {
+              {"rax", {registerIndex(offsetof(user_regs_struct, rax))}},
+              {"rbx", {registerIndex(offsetof(user_regs_struct, rbx))}},
+              {"rcx", {registerIndex(offsetof(user_regs_struct, rcx))}},
+              {"rdx", {registerIndex(offsetof(user_regs_struct, rdx))}},
+              {"rsi", {registerIndex(offsetof(user_regs_struct, rsi))}},
+              {"rdi", {registerIndex(offsetof(user_regs_struct, rdi))}},
+              {"rbp", {registerIndex(offsetof(user_regs_struct, rbp))}},
+              {"rsp", {registerIndex(offsetof(user_regs_struct, rsp))}},
+              {"r8", {registerIndex(offsetof(user_regs_struct, r8))}},
+              {"r9", {registerIndex(offsetof(user_regs_struct, r9))}},
+              {"r10", {registerIndex(offsetof(user_regs_struct, r10))}},
+              {"r11", {registerIndex(offsetof(user_regs_struct, r11))}},
+              {"r12", {registerIndex(offsetof(user_regs_struct, r12))}},
+              {"r13", {registerIndex(offsetof(user_regs_struct, r13))}},
+              {"r14", {registerIndex(offsetof(user_regs_struct, r14))}},
+              {"r15", {registerIndex(offsetof(user_regs_struct, r15))}},
+              {"rip", {registerIndex(offsetof(user_regs_struct, rip))}},
+              {"eflags", {registerIndex(offsetof(user_regs_struct, eflags))}},
+              {"orig_rax", {registerIndex(offsetof(user_regs_struct, orig_rax))}},
+              {"fs_base", {registerIndex(offsetof(user_regs_struct, fs_base))}},
+              {"gs_base", {registerIndex(offsetof(user_regs_struct, gs_base))}},
+              {"eax", {registerIndex(offsetof(user_regs_struct, rax)), true}},
+              {"ebx", {registerIndex(offsetof(user_regs_struct, rbx)), true}},
+              {"ecx", {registerIndex(offsetof(user_regs_struct, rcx)), true}},
+              {"edx", {registerIndex(offsetof(user_regs_struct, rdx)), true}},
+              {"esi", {registerIndex(offsetof(user_regs_struct, rsi)), true}},
+              {"edi", {registerIndex(offsetof(user_regs_struct, rdi)), true}},
+              {"ebp", {registerIndex(offsetof(user_regs_struct, rbp)), true}},
+              {"esp", {registerIndex(offsetof(user_regs_struct, rsp)), true}},
+              {"r8d", {registerIndex(offsetof(user_regs_struct, r8)), true}},
+              {"r9d", {registerIndex(offsetof(user_regs_struct, r9)), true}},
+              {"r10d", {registerIndex(offsetof(user_regs_struct, r10)), true}},
+              {"r11d", {registerIndex(offsetof(user_regs_struct, r11)), true}},
+              {"r12d", {registerIndex(offsetof(user_regs_struct, r12)), true}},
+              {"r13d", {registerIndex(offsetof(user_regs_struct, r13)), true}},
+              {"r14d", {registerIndex(offsetof(user_regs_struct, r14)), true}},
+              {"r15d", {registerIndex(offsetof(user_regs_struct, r15)), true}},
+      };
+      return registers;
+    }
+
+    // C type of a sub-expression
+    struct Type {
+      // Size of the value, or of the pointed value for pointers
+      uint8_t size = 8;
+      bool is_unsigned = false;
+      uint8_t indirection = 0;
+
+      // Size of the value pointed to, which is a pointer itself past the first indirection
+      uint8_t getPointeeSize() const {
+        return indirection > 1 ? 8 : size;
+      }
+    };
+
+    constexpr Type kLong = {};
+    constexpr Type kInt = {4, false, 0};
+
+    int64_t extend(uint64_t value, uint32_t size, bool is_unsigned) {
+      if (size >= 8) return value;
+      uint32_t shift = 64 - 8 * size;
+      if (is_unsigned) return (value << shift) >> shift;
+      return int64_t(value << shift) >> shift;
+    }
+  }// namespace
+
+  /**
+   * @brief Recursive descent compiler of conditions, which also tracks the C type of every
+   * sub-expression, for pointer arithmetic, dereferences and unsigned operations
+   */
+  class ConditionCompiler {
+  public:
+    explicit ConditionCompiler(BreakPointCondition& condition)
+        : condition(condition), tokens(tokenize(condition.source)) {}
+
+    void compile() {
+      if (tokens.front().kind == Token::Kind::kEnd) throw std::runtime_error("Empty condition");
+      parseBinary(0);
+      if (peek().kind != Token::Kind::kEnd) fail("Unexpected '" + std::string(peek().text) + "'");
+    }
+
+  private:
+    // Binary operators by precedence level, from the loosest one
+    static constexpr size_t kLevels = 10;
+
+    const Token& peek() const {
+      return tokens[pos];
+    }
+
+    bool accept(std::string_view punctuator) {
+      if (peek().kind != Token::Kind::kPunctuator or peek().text != punctuator) return false;
+      pos++;
+      return true;
+    }
+
+    void expect(std::string_view punctuator) {
+      if (not accept(punctuator)) fail("Expected '" + std::string(punctuator) + "'");
+    }
+
+    [[noreturn]] void fail(const std::string& message) const {
+      throw std::runtime_error(message + " at " + std::to_string(peek().position));
+    }
+
+    void emit(BreakPointCondition::Op op, int stack_change, bool is_unsigned = false,
+              uint32_t arg = 0) {
+      condition.code.push_back({op, is_unsigned, arg});
+      depth += stack_change;
+      if (depth > BreakPointCondition::kMaxDepth) fail("Condition too deeply nested");
+    }
+
+    void emitConstant(int64_t value) {
+      condition.constants.push_back(value);
+      emit(BreakPointCondition::Op::kConstant, 1, false, condition.constants.size() - 1);
+    }
+
+    static std::optional<BreakPointCondition::Op> getOperator(size_t level, std::string_view op) {
+      using Op = BreakPointCondition::Op;
+      switch (level) {
+        case 0:
+          if (op == "||") return Op::kJumpIfNotZero;
+          break;
+        case 1:
+          if (op == "&&") return Op::kJumpIfZero;
+          break;
+        case 2:
+          if (op == "|") return Op::kOr;
+          break;
+        case 3:
+          if (op == "^") return Op::kXor;
+          break;
+        case 4:
+          if (op == "&") return Op::kAnd;
+          break;
+        case 5:
+          if (op == "==") return Op::kEqual;
+          if (op == "!=") return Op::kNotEqual;
+          break;
+        case 6:
+          if (op == "<") return Op::kLess;
+          if (op == "<=") return Op::kLessEqual;
+          if (op == ">") return Op::kGreater;
+          if (op == ">=") return Op::kGreaterEqual;
+          break;
+        case 7:
+          if (op == "<<") return Op::kShiftLeft;
+          if (op == ">>") return Op::kShiftRight;
+          break;
+        case 8:
+          if (op == "+") return Op::kAdd;
+          if (op == "-") return Op::kSubtract;
+          break;
+        case 9:
+          if (op == "*") return Op::kMultiply;
+          if (op == "/") return Op::kDivide;
+          if (op == "%") return Op::kModulo;
+          break;
+      }
+      return std::nullopt;
+    }
+
+    Type parseBinary(size_t level) {
+      using Op = BreakPointCondition::Op;
+      if (level == kLevels) return parseUnary();
+
+      Type lhs = parseBinary(level + 1);
+      while (peek().kind == Token::Kind::kPunctuator) {
+        auto op = getOperator(level, peek().text);
+        if (not op) break;
+        pos++;
+
+        if (*op == Op::kJumpIfZero or *op == Op::kJumpIfNotZero) {
+          // Short-circuit: the jump either keeps the result on the stack, or pops the left operand
+          size_t jump = condition.code.size();
+          emit(*op, -1);
+          parseBinary(level + 1);
+          emit(Op::kToBool, 0);
+          condition.code[jump].arg = condition.code.size();
+          lhs = kInt;
+          continue;
+        }
+
+        Type rhs = parseBinary(level + 1);
+        // Pointer arithmetic, on the right operand only
+        if ((*op == Op::kAdd or *op == Op::kSubtract) and lhs.indirection and
+            not rhs.indirection and lhs.getPointeeSize() > 1) {
+          emitConstant(lhs.getPointeeSize());
+          emit(Op::kMultiply, -1);
+        }
+
+        // Every value is promoted to 64 bits, which is unsigned if a 64 bits operand is
+        bool is_unsigned = lhs.indirection or rhs.indirection or
+                           (lhs.is_unsigned and (lhs.size == 8 or rhs.is_unsigned)) or
+                           (rhs.is_unsigned and (rhs.size == 8 or lhs.is_unsigned));
+        emit(*op, -1, is_unsigned);
+
+        if (*op >= Op::kEqual) lhs = kInt;
+        else if ((*op == Op::kAdd or *op == Op::kSubtract) and lhs.indirection and
+                 not rhs.indirection)
+          continue;
+        else
+          lhs = {8, is_unsigned, 0};
+      }
+      return lhs;
+    }
+
+    Type parseUnary() {
+      using Op = BreakPointCondition::Op;
+      if (accept("+")) return parseUnary();
+      if (accept("-")) {
+        Type type = parseUnary();
+        emit(Op::kNegate, 0);
+        return {8, type.is_unsigned and type.size == 8, 0};
+      }
+      if (accept("!")) {
+        parseUnary();
+        emit(Op::kNot, 0);
+        return kInt;
+      }
+      if (accept("~")) {
+        Type type = parseUnary();
+        emit(Op::kComplement, 0);
+        return {8, type.is_unsigned and type.size == 8, 0};
+      }
+      if (accept("*")) {
+        Type type = parseUnary();
+        // Registers and integers point to longs
+        if (not type.indirection) type = {8, false, 1};
+        if (type.indirection > 1) {
+          emit(Op::kLoad, 0, true, 8);
+          return {type.size, type.is_unsigned, uint8_t(type.indirection - 1)};
+        }
+        emit(Op::kLoad, 0, type.is_unsigned, type.size);
+        return {type.size, type.is_unsigned, 0};
+      }
+
+      // A cast, since parenthesized expressions never start with a type name
+      if (peek().kind == Token::Kind::kPunctuator and peek().text == "(" and
+          isTypeName(tokens[pos + 1])) {
+        pos++;
+        Type cast = parseTypeName();
+        expect(")");
+        parseUnary();
+        if (not cast.indirection and cast.size < 8)
+          emit(Op::kExtend, 0, cast.is_unsigned, cast.size);
+        return cast;
+      }
+      return parsePrimary();
+    }
+
+    Type parsePrimary() {
+      using Op = BreakPointCondition::Op;
+      const Token& token = peek();
+      switch (token.kind) {
+        case Token::Kind::kNumber:
+          pos++;
+          emitConstant(token.value);
+          return {8, token.is_unsigned, 0};
+        case Token::Kind::kIdentifier: {
+          std::string_view name = token.text;
+          if (name.starts_with('$')) name.remove_prefix(1);
+          if (name == "reached") {
+            pos++;
+            emit(Op::kReached, 1);
+            return {8, true, 0};
+          }
+          const auto& registers = getRegisters();
+          auto it = registers.find(name);
+          if (it == registers.end()) fail("Unknown register '" + std::string(token.text) + "'");
+          pos++;
+          emit(Op::kRegister, 1, false, it->second.index);
+          if (not it->second.low) return kLong;
+          emit(Op::kExtend, 0, false, 4);
+          return kInt;
+        }
+        case Token::Kind::kPunctuator:
+          if (accept("(")) {
+            Type type = parseBinary(0);
+            expect(")");
+            return type;
+          }
+          break;
+        case Token::Kind::kEnd:
+          fail("Unexpected end of condition");
+      }
+      fail("Unexpected '" + std::string(token.text) + "'");
+    }
+
+    static const std::unordered_map<std::string_view, Type>& getTypes() {
+      static const std::unordered_map<std::string_view, Type> types = {
+              {"char", {1, false, 0}},    {"short", {2, false, 0}},   {"int", kInt},
+              {"long", kLong},            {"bool", {1, true, 0}},     {"void", {1, true, 0}},
+              {"int8_t", {1, false, 0}},  {"int16_t", {2, false, 0}}, {"int32_t", kInt},
+              {"int64_t", kLong},         {"uint8_t", {1, true, 0}},  {"uint16_t", {2, true, 0}},
+              {"uint32_t", {4, true, 0}}, {"uint64_t", {8, true, 0}}, {"size_t", {8, true, 0}},
+              {"ssize_t", kLong},         {"intptr_t", kLong},        {"uintptr_t", {8, true, 0}}};
+      return types;
+    }
+
+    static bool isTypeName(const Token& token) {
+      return token.kind == Token::Kind::kIdentifier and
+             (getTypes().contains(token.text) or token.text == "signed" or
+              token.text == "unsigned" or token.text == "const");
+    }
+
+    Type parseTypeName() {
+      std::optional<Type> base;
+      std::optional<bool> is_unsigned;
+      while (isTypeName(peek())) {
+        std::string_view name = peek().text;
+        pos++;
+        if (name == "const") continue;
+        if (name == "signed" or name == "unsigned") {
+          is_unsigned = name == "unsigned";
+          continue;
+        }
+        // "long long", "long int" and "short int" are the same as their first word
+        if (base and (name == "int" or name == "long")) continue;
+        if (base) fail("Invalid type");
+        base = getTypes().at(name);
+      }
+      Type type = base.value_or(kInt);
+      if (is_unsigned) type.is_unsigned = *is_unsigned;
+      while (accept("*")) type.indirection++;
+      return type;
+    }
+
+    BreakPointCondition& condition;
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    size_t depth = 0;
+  };
+
+  BreakPointCondition::BreakPointCondition(std::string_view source) : source(source) {
+    ConditionCompiler(*this).compile();
+  }
+
+  std::optional<int64_t> BreakPointCondition::evaluate(const user_regs_struct& regs,
+                                                       uint64_t reached,
+                                                       const RemoteMemory& memory) const {
+    std::array<int64_t, kMaxDepth> stack;
+    size_t top = 0;
+    const auto* registers = reinterpret_cast<const unsigned long long*>(&regs);
+
+    for (size_t pc = 0; pc < code.size(); pc++) {
+      const auto& ins = code[pc];
+      switch (ins.op) {
+        case Op::kConstant:
+          stack[top++] = constants[ins.arg];
+          continue;
+        case Op::kRegister:
+          stack[top++] = registers[ins.arg];
+          continue;
+        case Op::kReached:
+          stack[top++] = reached;
+          continue;
+        default:
+          break;
+      }
+
+      int64_t& a = stack[top - 1];
+      switch (ins.op) {
+        case Op::kLoad: {
+          uint64_t value = 0;
+          if (not memory.read(a, &value, ins.arg)) return std::nullopt;
+          a = extend(value, ins.arg, ins.is_unsigned);
+          continue;
+        }
+        case Op::kExtend:
+          a = extend(a, ins.arg, ins.is_unsigned);
+          continue;
+        case Op::kNegate:
+          a = 0 - uint64_t(a);
+          continue;
+        case Op::kNot:
+          a = a == 0;
+          continue;
+        case Op::kComplement:
+          a = ~a;
+          continue;
+        case Op::kToBool:
+          a = a != 0;
+          continue;
+        case Op::kJumpIfZero:
+          if (a == 0) pc = ins.arg - 1;
+          else
+            top--;
+          continue;
+        case Op::kJumpIfNotZero:
+          if (a != 0) {
+            a = 1;
+            pc = ins.arg - 1;
+          } else
+            top--;
+          continue;
+        default:
+          break;
+      }
+
+      // Binary operators pop their right operand, and replace the left one by the result
+      int64_t sb = stack[--top];
+      uint64_t b = sb;
+      int64_t& lhs = stack[top - 1];
+      uint64_t ua = lhs;
+      switch (ins.op) {
+        case Op::kAdd:
+          lhs = ua + b;
+          break;
+        case Op::kSubtract:
+          lhs = ua - b;
+          break;
+        case Op::kMultiply:
+          lhs = ua * b;
+          break;
+        case Op::kDivide:
+        case Op::kModulo:
+          if (b == 0) return std::nullopt;
+          if (ins.is_unsigned) lhs = ins.op == Op::kDivide ? ua / b : ua % b;
+          // INT64_MIN / -1 overflows
+          else if (sb == -1)
+            lhs = ins.op == Op::kDivide ? 0 - ua : 0;
+          else
+            lhs = ins.op == Op::kDivide ? lhs / sb : lhs % sb;
+          break;
+        case Op::kShiftLeft:
+          lhs = ua << (b & 63);
+          break;
+        case Op::kShiftRight:
+          lhs = ins.is_unsigned ? int64_t(ua >> (b & 63)) : lhs >> (b & 63);
+          break;
+        case Op::kAnd:
+          lhs = ua & b;
+          break;
+        case Op::kOr:
+          lhs = ua | b;
+          break;
+        case Op::kXor:
+          lhs = ua ^ b;
+          break;
+        case Op::kEqual:
+          lhs = ua == b;
+          break;
+        case Op::kNotEqual:
+          lhs = ua != b;
+          break;
+        case Op::kLess:
+          lhs = ins.is_unsigned ? ua < b : lhs < sb;
+          break;
+        case Op::kLessEqual:
+          lhs = ins.is_unsigned ? ua <= b : lhs <= sb;
+          break;
+        case Op::kGreater:
+          lhs = ins.is_unsigned ? ua > b : lhs > sb;
+          break;
+        case Op::kGreaterEqual:
+          lhs = ins.is_unsigned ? ua >= b : lhs >= sb;
+          break;
+        default:
+          break;
+      }
+    }
+    return stack[0];
+  }
+
+}// namespace ldb
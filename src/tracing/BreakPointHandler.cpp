@@ -1,41 +1,314 @@
 #include "BreakPointHandler.h"
+#include "RemoteMemory.h"
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <sys/user.h>
 
 namespace ldb {
 
-  BreakPointHandler::BreakPointHandler(const pid_t pid) : pid(pid){};
+  namespace {
+    /**
+     * @brief Returns true if the instruction has no effect at all, so it can be skipped
+     */
+    bool isNop(std::span<const uint8_t> code) {
+      // endbr64 / endbr32, the first instruction of most functions with CET enabled
+      if (code.size() == 4 and code[0] == 0xF3 and code[1] == 0x0F and code[2] == 0x1E and
+          (code[3] == 0xFA or code[3] == 0xFB))
+        return true;
+
+      // Padding nops may have any number of operand size or segment prefixes, but no REX
+      size_t pos = 0;
+      while (pos < code.size() and (code[pos] == 0x66 or code[pos] == 0x2E)) pos++;
+      if (pos + 1 == code.size() and code[pos] == 0x90) return true;
+      // nop r/m, whose ModRM reg field must be 0
+      return pos + 2 < code.size() and code[pos] == 0x0F and code[pos + 1] == 0x1F and
+             ((code[pos + 2] >> 3) & 7) == 0;
+    }
+
+    /**
+     * @brief Returns the register pushed by a push r64, which starts most functions without CET
+     */
+    std::optional<uint8_t> getPushedRegister(std::span<const uint8_t> code) {
+      if (code.size() == 1 and code[0] >= 0x50 and code[0] <= 0x57) return code[0] - 0x50;
+      // REX.B selects r8 to r15
+      if (code.size() == 2 and code[0] == 0x41 and code[1] >= 0x50 and code[1] <= 0x57)
+        return code[1] - 0x50 + 8;
+      return std::nullopt;
+    }
+
+    uint64_t getRegister(const user_regs_struct& regs, uint8_t reg) {
+      switch (reg) {
+        case 0:
+          return regs.rax;
+        case 1:
+          return regs.rcx;
+        case 2:
+          return regs.rdx;
+        case 3:
+          return regs.rbx;
+        case 4:
+          return regs.rsp;
+        case 5:
+          return regs.rbp;
+        case 6:
+          return regs.rsi;
+        case 7:
+          return regs.rdi;
+        case 8:
+          return regs.r8;
+        case 9:
+          return regs.r9;
+        case 10:
+          return regs.r10;
+        case 11:
+          return regs.r11;
+        case 12:
+          return regs.r12;
+        case 13:
+          return regs.r13;
+        case 14:
+          return regs.r14;
+        default:
+          return regs.r15;
+      }
+    }
+  }// namespace
+
+  BreakPointHandler::BreakPointHandler(const pid_t pid)
+      : pid(pid), hardware(pid),
+        pages(pid, [this](long number, const std::array<uint64_t, 6>& args) {
+          return injectSyscall(number, args);
+        }){};
 
   void BreakPointHandler::add(const Symbol& sym) {
+    // Breakpoints are displayed with their source location
+    if (const auto* table = sym.getTable()) table->loadDebugInfo(sym.getAddress());
     breakPoints.add(pid, sym.getAddress());
+    // A coverage probe at the same address is now a break point of the user, which is kept
+    coverage_points.erase(sym.getAddress());
+  }
+
+  size_t BreakPointHandler::add(std::span<const Elf64_Addr> addrs) {
+    for (auto addr : addrs) coverage_points.erase(addr);
+    return breakPoints.add(pid, addrs);
+  }
+
+  void BreakPointHandler::remove(std::span<const Elf64_Addr> addrs) {
+    breakPoints.remove(pid, addrs);
+    for (auto addr : addrs) forgetBreakpoint(addr);
   }
 
   void BreakPointHandler::remove(const Symbol& sym) {
     breakPoints.remove(pid, sym.getAddress());
+    forgetBreakpoint(sym.getAddress());
   }
 
   void BreakPointHandler::removeAll() {
     breakPoints.removeAll();
+    internal.clear();
+    pending.clear();
+    pending_actions.clear();
+    actions.clear();
+    for (auto& [addr, point] : return_points) point.profiler->clearCalls();
+    return_points.clear();
+    coverage_points.clear();
+    displaced.clear();
+    scratch_content = std::nullopt;
   }
 
-  const std::vector<std::string> BreakPointHandler::saveBreakpoints(const SymbolTable& symbols) {
-    std::vector<std::string> res;
-    const auto& bps = breakPoints.getBreakPoints();
-    for (auto it = bps.cbegin(); it != bps.end(); ++it) {
-      res.push_back(symbols.findInTable(it->first).first->getName());
+  void BreakPointHandler::addInternal(Elf64_Addr addr, InternalCallback callback) {
+    if (not breakPoints.isBreakPoint(addr)) breakPoints.add(pid, addr);
+    coverage_points.erase(addr);
+    internal[addr] = std::move(callback);
+  }
+
+  void BreakPointHandler::addPending(const std::string& name) {
+    if (std::find(pending.begin(), pending.end(), name) == pending.end()) pending.push_back(name);
+  }
+
+  size_t BreakPointHandler::resolvePending(const SymbolTable& symbols) {
+    std::vector<const Symbol*> found;
+    std::vector<SavedBreakPoint> restored;
+    std::erase_if(pending, [&](const std::string& name) {
+      const auto* sym = symbols[name];
+      if (not sym) return false;
+      found.push_back(sym);
+      if (auto it = pending_actions.find(name); it != pending_actions.end()) {
+        restored.push_back(std::move(it->second));
+        pending_actions.erase(it);
+      } else {
+        restored.push_back({name});
+      }
+      return true;
+    });
+    addSymbols(found);
+    for (size_t i = 0; i < found.size(); i++) restoreAction(found[i]->getAddress(), restored[i]);
+    return found.size();
+  }
+
+  void BreakPointHandler::addSymbols(std::span<const Symbol* const> symbols) {
+    std::vector<Elf64_Addr> addrs;
+    addrs.reserve(symbols.size());
+    for (const auto* sym : symbols) {
+      if (const auto* table = sym->getTable()) table->loadDebugInfo(sym->getAddress());
+      addrs.push_back(sym->getAddress());
+    }
+    breakPoints.add(pid, addrs);
+  }
+
+  void BreakPointHandler::unloadObject(const SymbolTable& symbols,
+                                       const std::filesystem::path& object_file) {
+    std::vector<Elf64_Addr> unloaded;
+    for (const auto& [addr, original] : breakPoints.getBreakPoints()) {
+      auto [sym, table] = symbols.findInTable(addr);
+      if (not sym or table->getObjectFile() != object_file) continue;
+      unloaded.push_back(addr);
+      if (internal.contains(addr)) continue;
+      std::string name(sym->getName());
+      addPending(name);
+      // The action is set again when the library is loaded back
+      if (auto it = actions.find(addr); it != actions.end())
+        pending_actions[name] = {name, addr, it->second.action, it->second.reached,
+                                 it->second.hits};
+    }
+
+    for (auto addr : unloaded) {
+      breakPoints.forget(addr);
+      internal.erase(addr);
+      forgetBreakpoint(addr);
+    }
+  }
+
+  std::vector<BreakPointHandler::SavedBreakPoint>
+  BreakPointHandler::saveBreakpoints(const SymbolTable& symbols) {
+    std::vector<SavedBreakPoint> res;
+    // Pending break points are kept as well, their library may be loaded in the next execution
+    for (const auto& name : pending) {
+      auto it = pending_actions.find(name);
+      res.push_back(it != pending_actions.end() ? it->second : SavedBreakPoint{name});
+    }
+
+    for (const auto& [addr, original] : breakPoints.getBreakPoints()) {
+      // Internal break points are set again by the tracer, and probes by the coverage
+      if (internal.contains(addr) or coverage_points.contains(addr)) continue;
+      auto state = actions.find(addr);
+      auto point = return_points.find(addr);
+      if (point != return_points.end() and point->second.owned and state == actions.end())
+        continue;
+
+      const auto* sym = symbols.findInTable(addr).first;
+      if (not sym) continue;
+      SavedBreakPoint saved{std::string(sym->getName()), addr};
+      if (state != actions.end()) {
+        saved.action = state->second.action;
+        saved.reached = state->second.reached;
+        saved.hits = state->second.hits;
+      }
+      res.push_back(std::move(saved));
     }
     return res;
   }
 
   void BreakPointHandler::resetPid(const pid_t p) {
     pid = p;
+    // The int3 of the table were written into the previous process, the new one has none of them
+    breakPoints.removeAll();
+    // The new process has not reached its entry point yet
+    scratch = std::nullopt;
+    scratch_content = std::nullopt;
+    scratch_syscall = false;
+    displaced.clear();
+    // Return addresses are not break points in the new process
+    for (auto& [addr, point] : return_points) point.profiler->clearCalls();
+    return_points.clear();
+    // Probes are addresses of the previous process
+    coverage = nullptr;
+    coverage_points.clear();
+    hardware.reset(p);
+    pages.reset(p);
+  }
+
+  void BreakPointHandler::setScratchArea(Elf64_Addr addr) {
+    scratch = addr;
+    scratch_content = std::nullopt;
+    scratch_syscall = false;
+    displaced.clear();
+  }
+
+  std::optional<int64_t> BreakPointHandler::injectSyscall(long number,
+                                                          const std::array<uint64_t, 6>& args) {
+    if (not scratch) return std::nullopt;
+    user_regs_struct saved{};
+    if (ptrace(PTRACE_GETREGS, pid, nullptr, &saved) == -1) return std::nullopt;
+
+    if (not scratch_syscall) {
+      errno = 0;
+      long word = ptrace(PTRACE_PEEKTEXT, pid, *scratch, nullptr);
+      if (errno != 0) return std::nullopt;
+      constexpr uint8_t kSyscall[] = {0x0F, 0x05};
+      std::memcpy(&word, kSyscall, sizeof(kSyscall));
+      if (ptrace(PTRACE_POKETEXT, pid, *scratch, word) == -1) return std::nullopt;
+      scratch_content = std::nullopt;
+      scratch_syscall = true;
+    }
+
+    user_regs_struct regs = saved;
+    regs.rip = *scratch;
+    regs.rax = number;
+    // Not a syscall to restart, whatever the process was doing when it stopped
+    regs.orig_rax = -1;
+    regs.rdi = args[0];
+    regs.rsi = args[1];
+    regs.rdx = args[2];
+    regs.r10 = args[3];
+    regs.r8 = args[4];
+    regs.r9 = args[5];
+    ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+    ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (not WIFSTOPPED(status)) return std::nullopt;
+
+    std::optional<int64_t> res;
+    // The process may have been stopped by a signal before the syscall ran
+    if (ptrace(PTRACE_GETREGS, pid, nullptr, &regs) != -1 and regs.rip == *scratch + 2)
+      res = static_cast<int64_t>(regs.rax);
+    ptrace(PTRACE_SETREGS, pid, nullptr, &saved);
+    return res;
   }
 
   void BreakPointHandler::refreshBreakPoint(const SymbolTable& symbols,
-                                            const std::vector<std::string>& old) {
-    this->pid = pid;
+                                            const std::vector<SavedBreakPoint>& old) {
+    removeAll();
 
-    breakPoints.removeAll();
+    std::vector<const Symbol*> found;
+    std::vector<const SavedBreakPoint*> restored;
+    for (const auto& saved : old) {
+      // The symbol may have been removed since the last execution, or belong to a library that is
+      // not loaded yet
+      if (const auto* sym = symbols[saved.name]) {
+        found.push_back(sym);
+        restored.push_back(&saved);
+      } else {
+        addPending(saved.name);
+        if (saved.action) pending_actions[saved.name] = saved;
+      }
+    }
+    addSymbols(found);
+    for (size_t i = 0; i < found.size(); i++) restoreAction(found[i]->getAddress(), *restored[i]);
+  }
 
-    for (auto& i : old) { add(*symbols[i]); }
+  void BreakPointHandler::restoreAction(Elf64_Addr addr, const SavedBreakPoint& saved) {
+    if (not saved.action) return;
+    // The statistics of a profiled function follow it to its new address
+    if (saved.action->profiler) saved.action->profiler->moveFunction(saved.address, addr);
+    setAction(addr, *saved.action);
+    auto& state = actions[addr];
+    state.reached = saved.reached;
+    state.hits = saved.hits;
   }
 
   bool BreakPointHandler::isBreakPoint(const Elf64_Addr addr) const {
@@ -48,26 +321,329 @@ namespace ldb {
     return isBreakPoint(rip - 1);
   }
 
-  bool BreakPointHandler::resetBreakpoint() {
-    if (not isAtBreakpoint()) return false;
+  std::optional<bool> BreakPointHandler::handleInternalBreakpoint(user_regs_struct& regs) {
+    Elf64_Addr addr = regs.rip - 1;
+    auto it = internal.find(addr);
+    if (it == internal.end()) return std::nullopt;
+
+    // The callback may add or remove break points, including this one
+    auto callback = it->second;
+    bool changed = callback();
+    if (isInternalBreakPoint(addr)) resetBreakpoint(regs);
+    else {
+      regs.rip = addr;
+      ptrace(PTRACE_POKEUSER, pid, 8 * RIP, addr);
+    }
+    return changed;
+  }
+
+  void BreakPointHandler::setAction(Elf64_Addr addr, BreakPointAction action) {
+    if (not isBreakPoint(addr)) breakPoints.add(pid, addr);
+    actions[addr].action = std::move(action);
+  }
+
+  void BreakPointHandler::setCondition(Elf64_Addr addr, std::string_view condition,
+                                       uint64_t ignore_count) {
+    BreakPointAction action;
+    if (not condition.empty()) action.condition.emplace(condition);
+    action.auto_continue = false;
+    action.ignore_count = ignore_count;
+
+    auto it = actions.find(addr);
+    if (it != actions.end()) action.log = it->second.action.log;
+    setAction(addr, std::move(action));
+  }
+
+  void BreakPointHandler::addTracePoint(Elf64_Addr addr, std::shared_ptr<TraceBuffer> trace) {
+    BreakPointAction action;
+    action.trace = std::move(trace);
+    setAction(addr, std::move(action));
+  }
+
+  std::map<Elf64_Addr, std::shared_ptr<TraceBuffer>> BreakPointHandler::getTracePoints() const {
+    std::map<Elf64_Addr, std::shared_ptr<TraceBuffer>> res;
+    for (const auto& [addr, state] : actions)
+      if (state.action.trace) res.emplace(addr, state.action.trace);
+    return res;
+  }
+
+  std::map<Elf64_Addr, std::shared_ptr<FunctionProfiler>>
+  BreakPointHandler::getProfilePoints() const {
+    std::map<Elf64_Addr, std::shared_ptr<FunctionProfiler>> res;
+    for (const auto& [addr, state] : actions)
+      if (state.action.profiler) res.emplace(addr, state.action.profiler);
+    return res;
+  }
+
+  void BreakPointHandler::clearAction(Elf64_Addr addr) {
+    actions.erase(addr);
+  }
+
+  uint64_t BreakPointHandler::getHitCount(Elf64_Addr addr) const {
+    auto it = actions.find(addr);
+    return it == actions.end() ? 0 : it->second.hits;
+  }
+
+  void BreakPointHandler::addProfilePoint(Elf64_Addr addr,
+                                          std::shared_ptr<FunctionProfiler> profiler) {
+    BreakPointAction action;
+    action.profiler = std::move(profiler);
+    setAction(addr, std::move(action));
+  }
+
+  void BreakPointHandler::enterProfiled(Elf64_Addr addr, const user_regs_struct& regs,
+                                        const std::shared_ptr<FunctionProfiler>& profiler) {
+    auto return_address = profiler->enter(addr, regs, RemoteMemory(pid));
+    // Calls abandoned by a longjmp may release return addresses
+    releaseReturnPoints(*profiler);
+    if (not return_address or return_points.contains(*return_address)) return;
+
+    bool owned = not isBreakPoint(*return_address);
+    if (owned) breakPoints.add(pid, *return_address);
+    return_points.emplace(*return_address, ReturnPoint{profiler, owned});
+  }
+
+  void BreakPointHandler::releaseReturnPoints(FunctionProfiler& profiler) {
+    std::vector<Elf64_Addr> removed;
+    for (auto addr : profiler.takeReleased()) {
+      auto it = return_points.find(addr);
+      if (it == return_points.end() or it->second.profiler.get() != &profiler) continue;
+      if (it->second.owned and not actions.contains(addr) and not internal.contains(addr))
+        removed.push_back(addr);
+      return_points.erase(it);
+    }
+    if (not removed.empty()) remove(removed);
+  }
+
+  size_t BreakPointHandler::startCoverage(std::shared_ptr<CodeCoverage> new_coverage) {
+    stopCoverage();
+    coverage = std::move(new_coverage);
+
+    std::vector<Elf64_Addr> addrs;
+    for (auto addr : coverage->getAddresses())
+      if (not isBreakPoint(addr)) addrs.push_back(addr);
+    size_t res = breakPoints.add(pid, addrs);
+    // Probes that could not be written are not break points
+    for (auto addr : addrs)
+      if (isBreakPoint(addr)) coverage_points.insert(addr);
+    return res;
+  }
+
+  void BreakPointHandler::stopCoverage() {
+    std::vector<Elf64_Addr> addrs(coverage_points.begin(), coverage_points.end());
+    coverage_points.clear();
+    remove(addrs);
+    coverage = nullptr;
+  }
+
+  bool BreakPointHandler::handleActionBreakpoint(user_regs_struct& regs) {
+    if (actions.empty() and return_points.empty() and not coverage) return false;
+    Elf64_Addr addr = regs.rip - 1;
+
+    if (coverage) {
+      coverage->cover(addr);
+      // The probe is gone for good, and the process runs the original instruction
+      if (coverage_points.erase(addr) and not actions.contains(addr) and
+          not return_points.contains(addr)) {
+        remove(std::span<const Elf64_Addr>(&addr, 1));
+        regs.rip = addr;
+        ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+        return true;
+      }
+    }
+
+    if (auto point = return_points.find(addr); point != return_points.end()) {
+      // The profiler may release this very break point
+      auto profiler = point->second.profiler;
+      bool owned = point->second.owned;
+      profiler->leave(addr, regs);
+      releaseReturnPoints(*profiler);
+      if (not isBreakPoint(addr)) {
+        regs.rip = addr;
+        ptrace(PTRACE_SETREGS, pid, nullptr, &regs);
+        return true;
+      }
+      // Otherwise, the break point is also an action break point, or the user's own
+      if (not actions.contains(addr)) {
+        if (not owned) return false;
+        stepOver(addr, &regs);
+        return true;
+      }
+    }
+
+    auto it = actions.find(addr);
+    if (it == actions.end()) return false;
+
+    auto& [action, reached, hits] = it->second;
+    reached++;
+    if (action.condition) {
+      auto value = action.condition->evaluate(regs, reached, RemoteMemory(pid));
+      // The stop is reported, so the user sees why the condition failed
+      if (not value) {
+        std::stringstream ss;
+        ss << "Failed to evaluate the condition of breakpoint 0x" << std::hex << addr << ": "
+           << action.condition->getSource();
+        messages.push_back({true, ss.str()});
+        return false;
+      }
+      if (*value == 0) {
+        stepOver(addr, &regs);
+        return true;
+      }
+    }
+
+    hits++;
+    if (action.trace) action.trace->record(regs, reached, RemoteMemory(pid));
+    if (action.profiler) enterProfiled(addr, regs, action.profiler);
+    if (action.log) {
+      // The first arguments of the function, following the System V calling convention
+      std::stringstream ss;
+      ss << "Breakpoint 0x" << std::hex << addr << " hit: rdi=0x" << regs.rdi << " rsi=0x"
+         << regs.rsi << " rdx=0x" << regs.rdx;
+      ss << std::dec << " (" << hits << " hits)";
+      messages.push_back({false, ss.str()});
+    }
+    if (not action.auto_continue and hits > action.ignore_count) return false;
+
+    stepOver(addr, &regs);
+    return true;
+  }
+
+  bool BreakPointHandler::resetBreakpoint(user_regs_struct& regs) {
+    if (regs.rip <= 1 or not isBreakPoint(regs.rip - 1)) return false;
+    stepOver(regs.rip - 1, &regs);
+    return true;
+  }
+
+  void BreakPointHandler::stepOver(Elf64_Addr addr, user_regs_struct* regs) {
+    const auto& step = prepareDisplaced(addr);
+    if (step.nop) {
+      ptrace(PTRACE_POKEUSER, pid, 8 * RIP, addr + step.length);
+      return;
+    }
+    if (step.push_register and regs) {
+      uint64_t value = getRegister(*regs, *step.push_register);
+      regs->rsp -= sizeof(uint64_t);
+      regs->rip = addr + step.length;
+      ptrace(PTRACE_POKEDATA, pid, regs->rsp, value);
+      ptrace(PTRACE_SETREGS, pid, nullptr, regs);
+      return;
+    }
+    if (stepDisplaced(addr)) return;
+
+    restoreInstruction(addr);
+    executeInstruction(addr);
+    restoreBreakpoint(addr);
+  }
+
+  const BreakPointHandler::DisplacedInstruction&
+  BreakPointHandler::prepareDisplaced(Elf64_Addr addr) {
+    auto it = displaced.find(addr);
+    if (it != displaced.end()) return it->second;
+
+    DisplacedInstruction res;
+    std::array<uint8_t, kScratchSize> original{};
+    if (RemoteMemory(pid).read(addr, original.data(), original.size())) {
+      // This break point, and the ones right after it, hide the original bytes
+      breakPoints.restoreOriginal(addr, original);
+
+      auto info = decodeInstruction(original);
+      if (info and info->control_flow != ControlFlow::kUnsupported) {
+        res.code = original;
+        res.length = info->length;
+        res.control_flow = info->control_flow;
+        res.relocatable = scratch.has_value();
+        std::span<const uint8_t> code(original.data(), info->length);
+        res.nop = isNop(code);
+        res.push_register = getPushedRegister(code);
+      }
+
+      // RIP-relative operands must still point to the same data from the copy
+      if (res.relocatable and info->rip_displacement) {
+        int32_t disp;
+        std::memcpy(&disp, original.data() + *info->rip_displacement, sizeof(disp));
+        int64_t moved = int64_t(disp) + static_cast<int64_t>(addr - *scratch);
+        if (moved < INT32_MIN or moved > INT32_MAX) {
+          // Too far from the scratch area, which is usually in another object
+          res.relocatable = false;
+        } else {
+          disp = static_cast<int32_t>(moved);
+          std::memcpy(res.code.data() + *info->rip_displacement, &disp, sizeof(disp));
+        }
+      }
+    }
+    return displaced.emplace(addr, res).first->second;
+  }
+
+  bool BreakPointHandler::stepDisplaced(Elf64_Addr addr) {
+    if (not scratch) return false;
+    // A break point in the scratch area would be overwritten by the copy
+    const auto& bps = breakPoints.getBreakPoints();
+    auto near = bps.lower_bound(*scratch);
+    if (near != bps.end() and near->first < *scratch + kScratchSize) return false;
+
+    const auto& step = prepareDisplaced(addr);
+    if (not step.relocatable) return false;
+
+    if (scratch_content != addr) {
+      for (size_t i = 0; i < kScratchSize; i += sizeof(long)) {
+        long word;
+        std::memcpy(&word, step.code.data() + i, sizeof(word));
+        ptrace(PTRACE_POKETEXT, pid, *scratch + i, word);
+      }
+      scratch_content = addr;
+      scratch_syscall = false;
+    }
+
+    ptrace(PTRACE_POKEUSER, pid, 8 * RIP, *scratch);
+    if (not WIFSTOPPED(singleStep())) return true;
+
+    // The instruction did not run if the step failed
     Elf64_Addr rip = ptrace(PTRACE_PEEKUSER, pid, 8 * RIP, NULL);
-    if (rip <= 1) return false;
+    bool executed = rip != *scratch;
+    bool absolute = step.control_flow == ControlFlow::kAbsoluteBranch or
+                    step.control_flow == ControlFlow::kAbsoluteCall;
+    // Anything but an absolute target was computed from the copy
+    if (not executed or not absolute) rip = rip - *scratch + addr;
+    ptrace(PTRACE_POKEUSER, pid, 8 * RIP, rip);
 
-    restoreInstruction(rip - 1);
-    executeInstruction(rip - 1);
-    restoreBreakpoint(rip - 1);
+    // Calls pushed the return address of the copy
+    bool call = step.control_flow == ControlFlow::kRelativeCall or
+                step.control_flow == ControlFlow::kAbsoluteCall;
+    if (executed and call) {
+      Elf64_Addr rsp = ptrace(PTRACE_PEEKUSER, pid, 8 * RSP, NULL);
+      ptrace(PTRACE_POKEDATA, pid, rsp, addr + step.length);
+    }
     return true;
   }
 
+  int BreakPointHandler::singleStep() {
+    int status = 0;
+    int pending = 0;
+    ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL);
+    waitpid(pid, &status, 0);
+    // Stopped by a signal before the instruction ran: the step suppresses it, it is sent back after
+    while (WIFSTOPPED(status) and WSTOPSIG(status) != SIGTRAP) {
+      pending = WSTOPSIG(status);
+      if (ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) == -1) break;
+      waitpid(pid, &status, 0);
+    }
+    if (pending) kill(pid, pending);
+    return status;
+  }
+
+  void BreakPointHandler::forgetBreakpoint(Elf64_Addr addr) {
+    actions.erase(addr);
+    displaced.erase(addr);
+    if (scratch_content == addr) scratch_content = std::nullopt;
+  }
+
   void BreakPointHandler::restoreInstruction(const Elf64_Addr addr) {
     if (currentAddr) throw std::runtime_error("Old breakpoint not submitted");
 
-    auto it = breakPoints.getBreakPoints().find(addr);
-    if (it == breakPoints.getBreakPoints().end()) throw std::runtime_error("Breakpoint not found");
-
+    breakPoints.disable(pid, addr);
     currentAddr = addr;
 
-    ptrace(PTRACE_POKETEXT, pid, addr, it->second);
     ptrace(PTRACE_POKEUSER, pid, 8 * RIP, addr);
   }
 
@@ -75,20 +651,14 @@ namespace ldb {
     if (not currentAddr or currentAddr != addr)
       throw std::runtime_error("No breakpoint to execute");
 
-    ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL);
-
-    waitpid(pid, NULL, 0);
+    singleStep();
   }
 
   void BreakPointHandler::restoreBreakpoint(Elf64_Addr addr) {
     if (not currentAddr or currentAddr.value() != addr)
       throw std::runtime_error("No breakpoint to submit");
 
-    auto it = breakPoints.getBreakPoints().find(currentAddr.value());
-    if (it == breakPoints.getBreakPoints().end()) throw std::runtime_error("Breakpoint not found");
-
-    const unsigned long bpInstruction = (it->second & 0xFFFFFFFFFFFFFF00) | 0x00000000000000CC;
-    ptrace(PTRACE_POKETEXT, pid, addr, bpInstruction);
+    breakPoints.enable(pid, addr);
     currentAddr = std::nullopt;
   }
 
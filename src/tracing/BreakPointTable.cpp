@@ -1,27 +1,141 @@
 #include "BreakPointTable.h"
+#include "RemoteMemory.h"
+#include <algorithm>
 
 
 namespace ldb {
 
-  void BreakPointTable::add(const pid_t pid, const Elf64_Addr addr) {
-    const unsigned long instruction = ptrace(PTRACE_PEEKTEXT, pid, addr, NULL);
-    static const unsigned long bpInstruction =
-            (instruction & 0xFFFFFFFFFFFFFF00) | 0x00000000000000CC;
-    ptrace(PTRACE_POKETEXT, pid, addr, bpInstruction);
-    breakPoints.emplace(addr, instruction);
+  namespace {
+    constexpr Elf64_Addr kPageSize = 4096;
+
+    Elf64_Addr getPage(Elf64_Addr addr) {
+      return addr & ~(kPageSize - 1);
+    }
+  }// namespace
+
+  std::vector<Elf64_Addr>
+  BreakPointTable::patch(const pid_t pid, std::span<const Elf64_Addr> addrs,
+                         const std::function<uint8_t(Elf64_Addr, uint8_t)>& patch) {
+    // Every run spans the addresses of a page, so a run never reaches an unmapped page
+    struct Run {
+      size_t first;
+      size_t count;
+      size_t offset;
+    };
+    std::vector<Run> runs;
+    std::vector<RemoteMemory::Chunk> chunks;
+    size_t total = 0;
+    for (size_t i = 0; i < addrs.size();) {
+      size_t end = i + 1;
+      while (end < addrs.size() and getPage(addrs[end]) == getPage(addrs[i])) end++;
+      size_t size = addrs[end - 1] - addrs[i] + 1;
+      runs.push_back({i, end - i, total});
+      chunks.push_back({addrs[i], nullptr, size});
+      total += size;
+      i = end;
+    }
+
+    std::vector<uint8_t> buffer(total);
+    for (size_t i = 0; i < runs.size(); i++) chunks[i].buffer = buffer.data() + runs[i].offset;
+
+    RemoteMemory memory(pid);
+    std::vector<bool> valid(runs.size(), true);
+    // A single page that cannot be read fails the whole batch, which is then read page by page
+    if (not memory.read(chunks)) {
+      for (size_t i = 0; i < runs.size(); i++)
+        valid[i] = memory.read(chunks[i].address, chunks[i].buffer, chunks[i].size);
+    }
+
+    std::vector<RemoteMemory::Chunk> writes;
+    std::vector<size_t> written;
+    for (size_t i = 0; i < runs.size(); i++) {
+      if (not valid[i]) continue;
+      auto* bytes = static_cast<uint8_t*>(chunks[i].buffer);
+      for (size_t j = runs[i].first; j < runs[i].first + runs[i].count; j++) {
+        auto& byte = bytes[addrs[j] - chunks[i].address];
+        byte = patch(addrs[j], byte);
+      }
+      writes.push_back(chunks[i]);
+      written.push_back(i);
+    }
+
+    if (not memory.write(writes)) {
+      for (size_t i = 0; i < writes.size(); i++)
+        valid[written[i]] = memory.write(writes[i].address, writes[i].buffer, writes[i].size);
+    }
+
+    std::vector<Elf64_Addr> failed;
+    for (size_t i = 0; i < runs.size(); i++) {
+      if (valid[i]) continue;
+      failed.insert(failed.end(), addrs.begin() + runs[i].first,
+                    addrs.begin() + runs[i].first + runs[i].count);
+    }
+    return failed;
+  }
+
+  bool BreakPointTable::add(const pid_t pid, const Elf64_Addr addr) {
+    return add(pid, std::span<const Elf64_Addr>(&addr, 1)) == 1;
+  }
+
+  size_t BreakPointTable::add(const pid_t pid, std::span<const Elf64_Addr> addrs) {
+    std::vector<Elf64_Addr> sorted;
+    sorted.reserve(addrs.size());
+    for (auto addr : addrs)
+      if (not isBreakPoint(addr)) sorted.push_back(addr);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    auto failed = patch(pid, sorted, [this](Elf64_Addr addr, uint8_t original) {
+      breakPoints.emplace(addr, original);
+      return kInt3;
+    });
+    // The original byte was read, but the int3 could not be written
+    for (auto addr : failed) breakPoints.erase(addr);
+    return sorted.size() - failed.size();
   }
 
   void BreakPointTable::remove(const pid_t pid, const Elf64_Addr addr) {
-    auto it = breakPoints.find(addr);
-    if (it == breakPoints.end()) throw std::runtime_error("Breakpoint not found");
-    ptrace(PTRACE_POKETEXT, pid, addr, it->second);
-    breakPoints.erase(it);
+    if (not isBreakPoint(addr)) throw std::runtime_error("Breakpoint not found");
+    remove(pid, std::span<const Elf64_Addr>(&addr, 1));
+  }
+
+  void BreakPointTable::remove(const pid_t pid, std::span<const Elf64_Addr> addrs) {
+    std::vector<Elf64_Addr> sorted;
+    sorted.reserve(addrs.size());
+    for (auto addr : addrs)
+      if (isBreakPoint(addr)) sorted.push_back(addr);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    patch(pid, sorted, [this](Elf64_Addr addr, uint8_t) { return breakPoints.at(addr); });
+    // Break points that could not be restored are in unmapped code, and are dropped as well
+    for (auto addr : sorted) breakPoints.erase(addr);
   }
 
   void BreakPointTable::removeAll() {
     breakPoints.clear();
   }
 
+  void BreakPointTable::forget(const Elf64_Addr addr) {
+    breakPoints.erase(addr);
+  }
+
+  void BreakPointTable::disable(const pid_t pid, const Elf64_Addr addr) {
+    auto it = breakPoints.find(addr);
+    if (it == breakPoints.end()) throw std::runtime_error("Breakpoint not found");
+    RemoteMemory(pid).write(addr, &it->second, 1);
+  }
+
+  void BreakPointTable::enable(const pid_t pid, const Elf64_Addr addr) {
+    if (not isBreakPoint(addr)) throw std::runtime_error("Breakpoint not found");
+    RemoteMemory(pid).write(addr, &kInt3, 1);
+  }
+
+  void BreakPointTable::restoreOriginal(const Elf64_Addr addr, std::span<uint8_t> code) const {
+    for (auto it = breakPoints.lower_bound(addr);
+         it != breakPoints.end() and it->first < addr + code.size(); ++it)
+      code[it->first - addr] = it->second;
+  }
 
   const bool BreakPointTable::isBreakPoint(const Elf64_Addr addr) const {
     return breakPoints.find(addr) != breakPoints.end();
@@ -30,8 +144,8 @@ namespace ldb {
 
   std::ostream& operator<<(std::ostream& os, const BreakPointTable& info) {
     for (auto it = info.breakPoints.begin(); it != info.breakPoints.end(); it++)
-      os << "[" << std::hex << it->first << ": " << it->second << "]" << std::endl;
+      os << "[" << std::hex << it->first << ": " << int(it->second) << "]" << std::endl;
     return os;
   }
 
-}// namespace ldb
\ No newline at end of file
+}// namespace ldb
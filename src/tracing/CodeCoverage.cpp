@@ -0,0 +1,115 @@
+#include "CodeCoverage.h"
+#include <algorithm>
+#include <map>
+
+namespace ldb {
+
+  CodeCoverage::CodeCoverage(const SymbolTable& symbols, const std::filesystem::path& object_file,
+                             Granularity granularity)
+      : object_file(object_file), granularity(granularity) {
+    files.emplace_back();
+
+    for (const SymbolTable* curr = &symbols; curr != nullptr; curr = curr->getNext()) {
+      if (curr->getObjectFile() != object_file) continue;
+      for (const auto& symbol : *curr) {
+        Elf64_Addr entry = symbol.getAddress();
+        // Aliases share the probes of the first symbol
+        if (probe_indexes.contains(entry)) continue;
+
+        std::vector<Elf64_Addr> addresses;
+        if (granularity == Granularity::kLine and symbol.getSize() > 0)
+          addresses = symbols.findLineStarts(entry, entry + symbol.getSize());
+        // The entry always comes first, whether the line table starts a line there or not
+        addresses.erase(std::remove(addresses.begin(), addresses.end(), entry), addresses.end());
+        addresses.insert(addresses.begin(), entry);
+
+        Function function{std::string(symbol.getDemangledName()), 0, 0, probes.size(), 0};
+        for (auto addr : addresses) {
+          if (not probe_indexes.try_emplace(addr, probes.size()).second) continue;
+          Probe probe{addr, uint32_t(functions.size()), 0, 0};
+          if (auto location = symbols.findLocation(addr)) {
+            probe.file = getFileIndex(location->file);
+            probe.line = location->line;
+          }
+          probes.push_back(probe);
+        }
+        function.file = probes[function.first_probe].file;
+        function.line = probes[function.first_probe].line;
+        function.probe_count = probes.size() - function.first_probe;
+        functions.push_back(std::move(function));
+      }
+    }
+  }
+
+  uint32_t CodeCoverage::getFileIndex(const std::filesystem::path& file) {
+    auto [it, inserted] = file_indexes.try_emplace(file.string(), files.size());
+    if (inserted) files.push_back(file);
+    return it->second;
+  }
+
+  std::vector<Elf64_Addr> CodeCoverage::getAddresses() const {
+    std::vector<Elf64_Addr> res;
+    res.reserve(probes.size());
+    for (const auto& probe : probes) res.push_back(probe.address);
+    std::sort(res.begin(), res.end());
+    return res;
+  }
+
+  bool CodeCoverage::cover(Elf64_Addr address) {
+    auto it = probe_indexes.find(address);
+    if (it == probe_indexes.end() or probes[it->second].covered) return false;
+    probes[it->second].covered = true;
+    covered++;
+    return true;
+  }
+
+  bool CodeCoverage::exportLcov(std::ostream& os) const {
+    // Sorted by file and line, as lcov writes them
+    std::map<uint32_t, std::vector<const Function*>> file_functions;
+    for (const auto& function : functions) file_functions[function.file].push_back(&function);
+    std::map<uint32_t, std::map<uint32_t, bool>> file_lines;
+    for (const auto& probe : probes) {
+      if (probe.line == 0) continue;
+      file_lines[probe.file][probe.line] |= probe.covered;
+    }
+
+    os << "TN:\n";
+    for (const auto& [file, listed] : file_functions) {
+      // Functions without line information are listed under the object file
+      os << "SF:" << (file ? files[file] : object_file).string() << '\n';
+      size_t hit = 0;
+      for (const auto* function : listed)
+        os << "FN:" << function->line << ',' << function->name << '\n';
+      for (const auto* function : listed) {
+        os << "FNDA:" << isCovered(*function) << ',' << function->name << '\n';
+        hit += isCovered(*function);
+      }
+      os << "FNF:" << listed.size() << "\nFNH:" << hit << '\n';
+
+      auto lines = file_lines.find(file);
+      if (lines != file_lines.end()) {
+        hit = 0;
+        for (const auto& [line, line_covered] : lines->second) {
+          os << "DA:" << line << ',' << line_covered << '\n';
+          hit += line_covered;
+        }
+        os << "LF:" << lines->second.size() << "\nLH:" << hit << '\n';
+      }
+      os << "end_of_record\n";
+    }
+
+    // Files only reached by the lines of functions defined elsewhere, e.g. inlined from a header
+    for (const auto& [file, lines] : file_lines) {
+      if (file_functions.contains(file)) continue;
+      os << "SF:" << files[file].string() << '\n';
+      size_t hit = 0;
+      for (const auto& [line, line_covered] : lines) {
+        os << "DA:" << line << ',' << line_covered << '\n';
+        hit += line_covered;
+      }
+      os << "LF:" << lines.size() << "\nLH:" << hit << "\nend_of_record\n";
+    }
+    return os.good();
+  }
+
+}// namespace ldb
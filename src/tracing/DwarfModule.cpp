@@ -0,0 +1,362 @@
+#include "DwarfModule.h"
+#include "DwarfReader.h"
+#include "SymbolTable.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tscl.hpp>
+
+namespace ldb {
+
+  namespace {
+    // Below this number of compute units, they are decoded sequentially
+    constexpr size_t kParallelThreshold = 16;
+
+    // A debug handle over an object already mapped in memory, owned by a single thread
+    struct DwarfHandle {
+      explicit DwarfHandle(MappedFile* file) {
+        elf = elf_memory(file->data(), file->size());
+        if (elf and dwarf_elf_init(elf, DW_DLC_READ, nullptr, nullptr, &dbg, nullptr) != DW_DLV_OK)
+          dbg = nullptr;
+      }
+
+      ~DwarfHandle() {
+        if (dbg) dwarf_finish(dbg, nullptr);
+        if (elf) elf_end(elf);
+      }
+
+      DwarfHandle(const DwarfHandle& other) = delete;
+      DwarfHandle& operator=(const DwarfHandle& other) = delete;
+
+      Elf* elf = nullptr;
+      Dwarf_Debug dbg = nullptr;
+    };
+  }// namespace
+
+  DwarfModule::DwarfModule(std::filesystem::path object_file)
+      : object_file(std::move(object_file)) {}
+
+  DwarfModule::~DwarfModule() {
+    if (dbg) dwarf_finish(dbg, nullptr);
+    if (elf) elf_end(elf);
+  }
+
+  bool DwarfModule::isLazyLoadingEnabled() {
+    static const bool enabled = []() {
+      const char* env = std::getenv("LDB_LAZY_DWARF");
+      return not env or std::string_view(env) != "0";
+    }();
+    return enabled;
+  }
+
+  std::optional<Dwarf_Off> DwarfModule::findUnit(Elf64_Addr addr) const {
+    // Find the last range starting at or before addr
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), addr,
+                               [](Elf64_Addr a, const UnitRange& r) { return a < r.start; });
+    if (it == ranges.begin()) return std::nullopt;
+    --it;
+    if (addr >= it->end) return std::nullopt;
+    return it->cu_offset;
+  }
+
+  bool DwarfModule::load(Elf64_Addr addr, SymbolTable& symbols) {
+    std::lock_guard lock(mutex);
+    if (all_decoded or not open()) return all_decoded;
+
+    auto cu_offset = findUnit(addr);
+    if (not cu_offset) return false;
+    decode(*cu_offset, symbols);
+    return true;
+  }
+
+  std::vector<std::string> DwarfModule::loadAll(SymbolTable& symbols) {
+    std::lock_guard lock(mutex);
+    std::vector<std::string> errors;
+    if (all_decoded or not open()) return errors;
+    all_decoded = true;
+
+    std::vector<Dwarf_Off> pending;
+    for (auto cu_offset : units)
+      if (decoded.insert(cu_offset).second) pending.push_back(cu_offset);
+
+    auto collect = [&](UnitResult&& result) {
+      auto error = merge(std::move(result), symbols);
+      if (not error.empty()) errors.push_back(std::move(error));
+    };
+
+    // Not worth spawning handles for a few units
+    if (pending.size() < kParallelThreshold) {
+      for (auto cu_offset : pending) collect(readUnit(dbg, cu_offset));
+      return errors;
+    }
+
+    // A Dwarf_Debug cannot be shared between threads, so every worker opens its own over the
+    // same mapping. Units are decoded into their own slot, and merged afterwards in order
+    std::vector<UnitResult> results(pending.size());
+    tbb::enumerable_thread_specific<DwarfHandle> handles(file.get());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, pending.size()),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                        auto& handle = handles.local();
+                        for (size_t i = range.begin(); i != range.end(); i++) {
+                          if (not handle.dbg) {
+                            results[i].error = "dwarf_elf_init failed";
+                            continue;
+                          }
+                          results[i] = readUnit(handle.dbg, pending[i]);
+                        }
+                      });
+
+    for (auto& result : results) collect(std::move(result));
+    return errors;
+  }
+
+  bool DwarfModule::isDecoded() {
+    std::lock_guard lock(mutex);
+    return all_decoded;
+  }
+
+  void DwarfModule::setDecoded() {
+    std::lock_guard lock(mutex);
+    all_decoded = true;
+  }
+
+  std::optional<SourceLocation> DwarfModule::findLocation(Elf64_Addr addr) {
+    std::lock_guard lock(mutex);
+    if (not open()) return std::nullopt;
+
+    auto cu_offset = findUnit(addr);
+    if (not cu_offset) return std::nullopt;
+    const auto* table = getLineTable(*cu_offset);
+    if (not table) return std::nullopt;
+    return table->find(addr);
+  }
+
+  std::vector<Elf64_Addr> DwarfModule::findAddresses(const std::filesystem::path& file,
+                                                     size_t line) {
+    std::lock_guard lock(mutex);
+    std::vector<Elf64_Addr> res;
+    if (not open()) return res;
+
+    for (auto cu_offset : units) {
+      const auto* table = getLineTable(cu_offset);
+      if (not table) continue;
+      auto addresses = table->findAddresses(file, line);
+      res.insert(res.end(), addresses.begin(), addresses.end());
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+  }
+
+  std::vector<Elf64_Addr> DwarfModule::findLineStarts(Elf64_Addr start, Elf64_Addr end) {
+    std::lock_guard lock(mutex);
+    if (not open()) return {};
+
+    auto cu_offset = findUnit(start);
+    if (not cu_offset) return {};
+    const auto* table = getLineTable(*cu_offset);
+    if (not table) return {};
+    return table->findLineStarts(start, end);
+  }
+
+  const LineTable* DwarfModule::getLineTable(Dwarf_Off cu_offset) {
+    auto it = line_tables.find(cu_offset);
+    if (it != line_tables.end()) return it->second.get();
+
+    // A unit that failed once would fail again, its table is stored either way
+    auto& table = line_tables[cu_offset];
+    Dwarf_Die cu_die = nullptr;
+    if (dwarf_offdie(dbg, cu_offset, &cu_die, nullptr) != DW_DLV_OK) return nullptr;
+    try {
+      table = std::make_unique<LineTable>(dbg, cu_die);
+    } catch (std::exception& e) {
+      tscl::logger("Failed to read the line table of " + object_file.string() + ": " + e.what(),
+                   tscl::Log::Warning);
+    }
+    dwarf_dealloc(dbg, cu_die, DW_DLA_DIE);
+    return table.get();
+  }
+
+  void DwarfModule::decode(Dwarf_Off cu_offset, SymbolTable& symbols) {
+    // A unit that failed once would fail again, it is marked as decoded either way
+    if (not decoded.insert(cu_offset).second) return;
+    auto error = merge(readUnit(dbg, cu_offset), symbols);
+    if (not error.empty())
+      tscl::logger("Failed to read the debug information of " + object_file.string() + ": " + error,
+                   tscl::Log::Warning);
+  }
+
+  DwarfModule::UnitResult DwarfModule::readUnit(Dwarf_Debug handle, Dwarf_Off cu_offset) {
+    UnitResult res;
+    try {
+      res.functions = decodeDwarfUnit(handle, cu_offset);
+    } catch (std::exception& e) { res.error = e.what(); }
+    return res;
+  }
+
+  std::string DwarfModule::merge(UnitResult&& result, SymbolTable& symbols) {
+    mergeDwarfFunctions(std::move(result.functions), symbols);
+    return std::move(result.error);
+  }
+
+  bool DwarfModule::open() {
+    if (is_open) return dbg != nullptr;
+    is_open = true;
+
+    try {
+      file = std::make_unique<MappedFile>(object_file);
+    } catch (std::exception&) { return false; }
+
+    elf = elf_memory(file->data(), file->size());
+    if (not elf) return false;
+
+    if (dwarf_elf_init(elf, DW_DLC_READ, nullptr, nullptr, &dbg, nullptr) != DW_DLV_OK) {
+      dbg = nullptr;
+      return false;
+    }
+
+    // Every unit is listed, since loadAll must reach the ones not covered by the aranges
+    Dwarf_Unsigned header_length = 0;
+    Dwarf_Half version = 0;
+    Dwarf_Unsigned abbrev_offset = 0;
+    Dwarf_Half address_size = 0;
+    Dwarf_Unsigned next_header = 0;
+    while (dwarf_next_cu_header(dbg, &header_length, &version, &abbrev_offset, &address_size,
+                                &next_header, nullptr) == DW_DLV_OK) {
+      Dwarf_Die cu_die = nullptr;
+      if (dwarf_siblingof(dbg, nullptr, &cu_die, nullptr) != DW_DLV_OK) continue;
+      Dwarf_Off offset = 0;
+      if (dwarf_dieoffset(cu_die, &offset, nullptr) == DW_DLV_OK) units.push_back(offset);
+      dwarf_dealloc(dbg, cu_die, DW_DLA_DIE);
+    }
+
+    if (not readAranges()) readUnitRanges();
+    std::sort(ranges.begin(), ranges.end(),
+              [](const UnitRange& lhs, const UnitRange& rhs) { return lhs.start < rhs.start; });
+    return true;
+  }
+
+  bool DwarfModule::readAranges() {
+    Dwarf_Arange* aranges = nullptr;
+    Dwarf_Signed count = 0;
+    if (dwarf_get_aranges(dbg, &aranges, &count, nullptr) != DW_DLV_OK) return false;
+
+    ranges.reserve(count);
+    for (Dwarf_Signed i = 0; i < count; i++) {
+      Dwarf_Unsigned segment = 0;
+      Dwarf_Unsigned segment_entry_size = 0;
+      Dwarf_Addr start = 0;
+      Dwarf_Unsigned length = 0;
+      Dwarf_Off cu_offset = 0;
+      if (dwarf_get_arange_info_b(aranges[i], &segment, &segment_entry_size, &start, &length,
+                                  &cu_offset, nullptr) == DW_DLV_OK and
+          length > 0)
+        ranges.push_back({start, start + length, cu_offset});
+      dwarf_dealloc(dbg, aranges[i], DW_DLA_ARANGE);
+    }
+    dwarf_dealloc(dbg, aranges, DW_DLA_LIST);
+    return not ranges.empty();
+  }
+
+  void DwarfModule::readUnitRanges() {
+    for (auto cu_offset : units) {
+      Dwarf_Die cu_die = nullptr;
+      if (dwarf_offdie(dbg, cu_offset, &cu_die, nullptr) != DW_DLV_OK) continue;
+
+      Dwarf_Addr low_pc = 0;
+      Dwarf_Addr high_pc = 0;
+      Dwarf_Half high_form = 0;
+      Dwarf_Form_Class high_class = DW_FORM_CLASS_UNKNOWN;
+      // Units made of several functions placed apart (e.g. in .text.hot) use DW_AT_ranges
+      if (dwarf_lowpc(cu_die, &low_pc, nullptr) == DW_DLV_OK and
+          dwarf_highpc_b(cu_die, &high_pc, &high_form, &high_class, nullptr) == DW_DLV_OK) {
+        if (high_class != DW_FORM_CLASS_ADDRESS) high_pc += low_pc;
+        if (high_pc > low_pc) ranges.push_back({low_pc, high_pc, cu_offset});
+      } else {
+        readRangeList(cu_die, cu_offset);
+      }
+      dwarf_dealloc(dbg, cu_die, DW_DLA_DIE);
+    }
+  }
+
+  void DwarfModule::readRangeList(Dwarf_Die cu_die, Dwarf_Off cu_offset) {
+    Dwarf_Attribute attr = nullptr;
+    if (dwarf_attr(cu_die, DW_AT_ranges, &attr, nullptr) != DW_DLV_OK) return;
+
+    Dwarf_Half version = 0;
+    Dwarf_Half offset_size = 0;
+    Dwarf_Half form = 0;
+    dwarf_get_version_of_die(cu_die, &version, &offset_size);
+    if (dwarf_whatform(attr, &form, nullptr) == DW_DLV_OK) {
+      if (version >= 5 or form == DW_FORM_rnglistx) readRngLists(attr, form, cu_offset);
+      else
+        readDebugRanges(cu_die, attr, cu_offset);
+    }
+    dwarf_dealloc(dbg, attr, DW_DLA_ATTR);
+  }
+
+  void DwarfModule::readDebugRanges(Dwarf_Die cu_die, Dwarf_Attribute attr, Dwarf_Off cu_offset) {
+    Dwarf_Off offset = 0;
+    if (dwarf_global_formref(attr, &offset, nullptr) != DW_DLV_OK) return;
+
+    Dwarf_Ranges* list = nullptr;
+    Dwarf_Signed count = 0;
+    Dwarf_Unsigned byte_count = 0;
+    Dwarf_Off real_offset = 0;
+    if (dwarf_get_ranges_b(dbg, offset, cu_die, &real_offset, &list, &count, &byte_count,
+                           nullptr) != DW_DLV_OK)
+      return;
+
+    // Entries are relative to the base address of the unit, which is its DW_AT_low_pc if any
+    Dwarf_Addr base = 0;
+    dwarf_lowpc(cu_die, &base, nullptr);
+    for (Dwarf_Signed i = 0; i < count; i++) {
+      const auto& entry = list[i];
+      if (entry.dwr_type == DW_RANGES_END) break;
+      if (entry.dwr_type == DW_RANGES_ADDRESS_SELECTION) base = entry.dwr_addr2;
+      else if (entry.dwr_addr2 > entry.dwr_addr1)
+        ranges.push_back({base + entry.dwr_addr1, base + entry.dwr_addr2, cu_offset});
+    }
+    dwarf_dealloc_ranges(dbg, list, count);
+  }
+
+  void DwarfModule::readRngLists(Dwarf_Attribute attr, Dwarf_Half form, Dwarf_Off cu_offset) {
+    // DW_FORM_rnglistx is an index in the offsets table of the unit, other forms an offset
+    Dwarf_Unsigned value = 0;
+    if (form == DW_FORM_rnglistx) {
+      if (dwarf_formudata(attr, &value, nullptr) != DW_DLV_OK) return;
+    } else {
+      Dwarf_Off offset = 0;
+      if (dwarf_global_formref(attr, &offset, nullptr) != DW_DLV_OK) return;
+      value = offset;
+    }
+
+    Dwarf_Rnglists_Head head = nullptr;
+    Dwarf_Unsigned count = 0;
+    Dwarf_Unsigned global_offset = 0;
+    if (dwarf_rnglists_get_rle_head(attr, form, value, &head, &count, &global_offset, nullptr) !=
+        DW_DLV_OK)
+      return;
+
+    // The cooked values are absolute addresses, libdwarf already applied the base addresses
+    for (Dwarf_Unsigned i = 0; i < count; i++) {
+      unsigned length = 0;
+      unsigned code = 0;
+      Dwarf_Unsigned raw_start = 0;
+      Dwarf_Unsigned raw_end = 0;
+      Dwarf_Unsigned start = 0;
+      Dwarf_Unsigned end = 0;
+      if (dwarf_get_rnglists_entry_fields(head, i, &length, &code, &raw_start, &raw_end, &start,
+                                          &end, nullptr) != DW_DLV_OK)
+        break;
+      if (code == DW_RLE_end_of_list) break;
+      if (code == DW_RLE_base_address or code == DW_RLE_base_addressx) continue;
+      if (end > start) ranges.push_back({start, end, cu_offset});
+    }
+    dwarf_dealloc_rnglists_head(head);
+  }
+
+}// namespace ldb
@@ -11,35 +11,32 @@ namespace ldb {
    */
   class DwarfReader {
   public:
-    DwarfReader(Elf* elf);
+    /**
+     * @brief Builds a reader over an initialized debug handle, which it does not own
+     */
+    explicit DwarfReader(Dwarf_Debug dbg);
     ~DwarfReader() = default;
 
     /**
-     * @brief Read the debug dwarf inforamation and populate the symbol table
-     * 
-     * @param symTab symbol table to populate
+     * @brief Read a single compute unit and collect the functions it describes
+     *
+     * @param cu_die debug information entry of the compute unit
+     * @param functions list of functions to fill
      */
-    void populateDwarf(SymbolTable& symTab);
+    void readUnit(Dwarf_Die cu_die, std::vector<DwarfFunction>& functions);
 
     const LANGAGE getLangage() {
       return langsrc;
     }
 
   private:
-    /**
-     * @brief Read the compute unit of dwarf file
-     * 
-     * @param symTab symbol table to populate
-     */
-    void readCu(SymbolTable& symTab);
-
     /**
      * @brief Recurcive reading of the debug information entry of dwarf file
      * 
      * @param die debug information entry to read
-     * @param symTable Symbol table to populate
+     * @param functions list of functions to fill
      */
-    void getDieAndSiblings(const Dwarf_Die die, SymbolTable& symTable);
+    void getDieAndSiblings(const Dwarf_Die die, std::vector<DwarfFunction>& functions);
 
     /**
      * @brief Read the language of the source code
@@ -56,18 +53,22 @@ namespace ldb {
     void loadFileTable(Dwarf_Die die);
 
     /**
-     * @brief Fill the map of type with the basic type
-     * 
+     * @brief Returns the type referenced by the DW_AT_type attribute of an entry
+     *
      * @param die debug information entry to read
+     * @param depth number of types already followed, see resolveType()
+     * @return The interned type, or TypeTable::kUnknown if the entry has none
      */
-    void loadBasicTypeMap(Dwarf_Die die);
+    TypeId getTypeOf(Dwarf_Die die, int depth = 0);
 
     /**
-     * @brief Fill the map of type with the derived type
-     * 
-     * @param die debug information entry to read
+     * @brief Resolve the type entry at the given offset, and the types it is derived from
+     *
+     * @param offset offset of the type entry in .debug_info
+     * @param depth number of types already followed, to stop on malformed cycles
+     * @return The interned type
      */
-    void loadComplexeTypeMap(Dwarf_Die die);
+    TypeId resolveType(Dwarf_Off offset, int depth = 0);
 
     /**
      * @brief Fill function information with arguments and local variables
@@ -75,63 +76,38 @@ namespace ldb {
      * @param die debug information entry to read
      * @param fun function to fill
      */
-    void parseFunction(Dwarf_Die die, Symbol& fun);
+    void parseFunction(Dwarf_Die die, DwarfFunction& fun);
 
   private:
     Dwarf_Debug dbg;
     LANGAGE langsrc;
+    // Before DWARF 5, file indexes start at 1
+    Dwarf_Unsigned first_file_index = 1;
     std::vector<std::string> file_tabl;
-    std::map<Dwarf_Off, std::string> type_tabl;
+    // Types already resolved in the current compute unit, by offset of their entry
+    std::unordered_map<Dwarf_Off, TypeId> type_ids;
   };
 
 
-  DwarfReader::DwarfReader(Elf* elf) : langsrc(LANGAGE::UNKNOWN) {
-    const int res = dwarf_elf_init(elf, DW_DLC_READ, nullptr, nullptr, &dbg, nullptr);
-    if (res == DW_DLV_ERROR) { throw std::runtime_error("dwarf_init failed"); }
-  }
-
-  void DwarfReader::populateDwarf(SymbolTable& symTab) {
-    if (!dbg) { throw std::runtime_error("dwarf dbg not initialized"); }
-
-    readCu(symTab);
-  }
-
-  void DwarfReader::readCu(SymbolTable& symTable) {
-    Dwarf_Unsigned cu_header_length = 0;
-    Dwarf_Half version_stamp = 0;
-    Dwarf_Unsigned abbrev_offset = 0;
-    Dwarf_Half address_size = 0;
-    Dwarf_Unsigned next_cu_header = 0;
-    bool done = true;
-
-    while (done) {
-      int res = dwarf_next_cu_header(dbg, &cu_header_length, &version_stamp, &abbrev_offset,
-                                     &address_size, &next_cu_header, nullptr);
+  DwarfReader::DwarfReader(Dwarf_Debug dbg) : dbg(dbg), langsrc(LANGAGE::UNKNOWN) {}
 
-      if (res == DW_DLV_NO_ENTRY) {
-        return;
-      } else if (res == DW_DLV_ERROR) {
-        throw std::runtime_error("read_cu failed");
-      }
+  void DwarfReader::readUnit(Dwarf_Die cu_die, std::vector<DwarfFunction>& functions) {
+    // Files and types are referenced relatively to their compute unit
+    file_tabl.clear();
+    type_ids.clear();
 
-      Dwarf_Die cur_die = nullptr;
-      res = dwarf_siblingof(dbg, nullptr, &cur_die, nullptr);
-      if (res == DW_DLV_ERROR) { throw std::runtime_error("dwarf_siblingof failed"); }
-      if (res == DW_DLV_NO_ENTRY) { throw std::runtime_error("No DIEs in CU"); }
+    Dwarf_Half version = 0;
+    Dwarf_Half offset_size = 0;
+    dwarf_get_version_of_die(cu_die, &version, &offset_size);
+    first_file_index = version >= 5 ? 0 : 1;
 
-      loadLangage(cur_die);
-      loadFileTable(cur_die);
-      loadBasicTypeMap(cur_die);
-      loadComplexeTypeMap(cur_die);
+    loadLangage(cu_die);
+    loadFileTable(cu_die);
 
-      getDieAndSiblings(cur_die, symTable);
-
-      dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
-      cur_die = nullptr;
-    }
+    getDieAndSiblings(cu_die, functions);
   }
 
-  void DwarfReader::getDieAndSiblings(Dwarf_Die die, SymbolTable& symTable) {
+  void DwarfReader::getDieAndSiblings(Dwarf_Die die, std::vector<DwarfFunction>& functions) {
     Dwarf_Error err = nullptr;
     Dwarf_Die cur_die = die;
     Dwarf_Die sib_die = die;
@@ -139,8 +115,6 @@ namespace ldb {
     Dwarf_Die child = nullptr;
     const int res = dwarf_child(die, &child, nullptr);
     Dwarf_Attribute attr = nullptr;
-    std::string type = "";
-    Dwarf_Off in_type = 0;
     Dwarf_Unsigned in_line = 0;
     Dwarf_Unsigned in_file = 0;
 
@@ -159,13 +133,6 @@ namespace ldb {
 
       const int got_name = !dwarf_diename(die, &name, &err);
 
-      const int got_type =
-              !dwarf_attr(die, DW_AT_type, &attr, nullptr) && !dwarf_formref(attr, &in_type, &err);
-
-      if (got_type) {
-        const auto it = type_tabl.find(in_type);
-        if (it != type_tabl.end()) type = it->second;
-      }
 
       const int got_line = !dwarf_attr(die, DW_AT_decl_line, &attr, nullptr) &&
                            !dwarf_formudata(attr, &in_line, &err);
@@ -173,30 +140,47 @@ namespace ldb {
       const int got_file = !dwarf_attr(die, DW_AT_decl_file, &attr, nullptr) &&
                            !dwarf_formudata(attr, &in_file, &err);
 
+      // DW_AT_high_pc is either an absolute address or, since DWARF 4, an offset from low_pc
+      Dwarf_Addr low_pc = 0;
+      Dwarf_Addr high_pc = 0;
+      Dwarf_Half high_form = 0;
+      Dwarf_Form_Class high_class = DW_FORM_CLASS_UNKNOWN;
+      const int got_range = !dwarf_lowpc(die, &low_pc, nullptr) &&
+                            !dwarf_highpc_b(die, &high_pc, &high_form, &high_class, nullptr);
+      if (got_range and high_class == DW_FORM_CLASS_ADDRESS) high_pc -= low_pc;
+
       if (got_name) {
         str_name = std::string(name);
         dwarf_dealloc(dbg, name, DW_DLA_STRING);
         name = nullptr;
       }
 
-      auto* fun = symTable[str_name];
-
-      if (!fun) { return; }
-
-      fun->setLine(in_line);
-      if (got_file) fun->setFile(file_tabl[in_file]);
-      if (got_type) fun->setType(type);
+      // Functions are matched with their ELF symbol by name
+      if (str_name.empty()) {
+        if (res == DW_DLV_OK) dwarf_dealloc(dbg, child, DW_DLA_DIE);
+        return;
+      }
 
-      if (res == DW_DLV_OK) parseFunction(child, *fun);
+      DwarfFunction fun;
+      fun.name = std::move(str_name);
+      fun.line = in_line;
+      if (got_range) fun.size = high_pc;
+      if (got_file and in_file >= first_file_index and
+          in_file - first_file_index < file_tabl.size())
+        fun.file = file_tabl[in_file - first_file_index];
+      fun.type = getTypeOf(die);
+
+      if (res == DW_DLV_OK) parseFunction(child, fun);
+      functions.push_back(std::move(fun));
     }
     else if (res == DW_DLV_OK) {
-      getDieAndSiblings(child, symTable);
+      getDieAndSiblings(child, functions);
       cur_die = child;
       while (dwarf_siblingof(dbg, cur_die, &sib_die, nullptr) == DW_DLV_OK) {
         dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
         cur_die = nullptr;
         cur_die = sib_die;
-        getDieAndSiblings(sib_die, symTable);
+        getDieAndSiblings(sib_die, functions);
       }
       dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
       cur_die = nullptr;
@@ -232,98 +216,71 @@ namespace ldb {
     string = nullptr;
   }
 
-  void DwarfReader::loadBasicTypeMap(Dwarf_Die die) {
-    Dwarf_Die child = nullptr;
-    const int res = dwarf_child(die, &child, nullptr);
-    if (res != DW_DLV_OK) return;
-
-    Dwarf_Die cur_die = die;
-    while (dwarf_siblingof(dbg, child, &cur_die, nullptr) == DW_DLV_OK) {
-      Dwarf_Half tag = 0;
-      dwarf_tag(cur_die, &tag, nullptr);
-      if (tag == DW_TAG_base_type || tag == DW_TAG_structure_type || tag == DW_TAG_typedef ||
-          tag == DW_TAG_enumeration_type) {
-
-        Dwarf_Off offset = 0;
-        dwarf_die_CU_offset(cur_die, &offset, nullptr);
-        char* name = nullptr;
-        const int got_name = !dwarf_diename(cur_die, &name, nullptr);
-        std::string str_name = "";
-        if (got_name) str_name = std::string(name);
-        dwarf_dealloc(dbg, name, DW_DLA_STRING);
-        name = nullptr;
-        type_tabl.insert({offset, str_name});
-      }
-      dwarf_dealloc(dbg, child, DW_DLA_DIE);
-      child = nullptr;
-      child = cur_die;
-    }
-    if (cur_die != die) {
-      dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
-      cur_die = nullptr;
-    }
+  TypeId DwarfReader::getTypeOf(Dwarf_Die die, int depth) {
+    Dwarf_Attribute attr = nullptr;
+    Dwarf_Off offset = 0;
+    if (dwarf_attr(die, DW_AT_type, &attr, nullptr) != DW_DLV_OK) return TypeTable::kUnknown;
+    const int res = dwarf_global_formref(attr, &offset, nullptr);
+    dwarf_dealloc(dbg, attr, DW_DLA_ATTR);
+    if (res != DW_DLV_OK) return TypeTable::kUnknown;
+    return resolveType(offset, depth);
   }
 
-  void DwarfReader::loadComplexeTypeMap(Dwarf_Die die) {
-    bool have_new_type = true;
+  TypeId DwarfReader::resolveType(Dwarf_Off offset, int depth) {
+    const auto it = type_ids.find(offset);
+    if (it != type_ids.end()) return it->second;
+    // Type chains are short, a deep one can only be a malformed cycle
+    if (depth > 64) return TypeTable::kUnknown;
 
-    Dwarf_Error err = nullptr;
-    Dwarf_Die die_child = nullptr;
-    const int res = dwarf_child(die, &die_child, nullptr);
-    if (res != DW_DLV_OK) return;
+    Dwarf_Die die = nullptr;
+    if (dwarf_offdie(dbg, offset, &die, nullptr) != DW_DLV_OK) return TypeTable::kUnknown;
 
-    while (have_new_type) {
-      have_new_type = false;
+    Dwarf_Half tag = 0;
+    dwarf_tag(die, &tag, nullptr);
 
-      Dwarf_Die cur_die = die_child;
-      Dwarf_Die cur_child = nullptr;
-      while (dwarf_siblingof(dbg, cur_die, &cur_child, nullptr) == DW_DLV_OK) {
-        dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
-        cur_die = nullptr;
-        Dwarf_Half tag = 0;
-        dwarf_tag(cur_child, &tag, nullptr);
-
-        Dwarf_Off offset = 0;
-        std::string name = "";
-        Dwarf_Attribute attr = nullptr;
-        if (tag == DW_TAG_pointer_type || tag == DW_TAG_const_type || tag == DW_TAG_array_type) {
-          dwarf_die_CU_offset(cur_child, &offset, nullptr);
-
-          Dwarf_Off in_type = 0;
-          const int got_type = !dwarf_attr(cur_child, DW_AT_type, &attr, nullptr) &&
-                               !dwarf_formref(attr, &in_type, &err);
-
-          if (got_type) {
-            const auto it = type_tabl.find(in_type);
-            if (it != type_tabl.end()) {
-              switch (tag) {
-                case DW_TAG_pointer_type:
-                  name = it->second + "*";
-                  break;
-                case DW_TAG_const_type:
-                  name = "const " + it->second;
-                  break;
-                case DW_TAG_array_type:
-                  name = it->second + "[]";
-                  break;
-                default:
-                  break;
-              }
-              type_tabl.insert({offset, name});
-            }
-          }
+    auto& types = TypeTable::getDefault();
+    auto derive = [&](TypeTable::Kind kind, const char* default_base) {
+      TypeId base = getTypeOf(die, depth + 1);
+      if (base == TypeTable::kUnknown) base = types.intern(default_base);
+      return types.intern(kind, base);
+    };
+
+    TypeId id = TypeTable::kUnknown;
+    switch (tag) {
+      case DW_TAG_pointer_type:
+        id = derive(TypeTable::Kind::kPointer, "void");
+        break;
+      case DW_TAG_const_type:
+        id = derive(TypeTable::Kind::kConst, "void");
+        break;
+      case DW_TAG_array_type:
+        id = derive(TypeTable::Kind::kArray, "");
+        break;
+      case DW_TAG_reference_type:
+      case DW_TAG_rvalue_reference_type:
+        id = derive(TypeTable::Kind::kReference, "");
+        break;
+      case DW_TAG_volatile_type:
+        // Qualifiers we do not display are transparent
+        id = getTypeOf(die, depth + 1);
+        break;
+      default: {
+        // Base types, structures, typedefs, enumerations...
+        char* name = nullptr;
+        if (dwarf_diename(die, &name, nullptr) == DW_DLV_OK) {
+          id = types.intern(name);
+          dwarf_dealloc(dbg, name, DW_DLA_STRING);
         }
-        cur_die = cur_child;
+        break;
       }
-      dwarf_dealloc(dbg, cur_die, DW_DLA_DIE);
-      cur_die = nullptr;
     }
-    dwarf_dealloc(dbg, die_child, DW_DLA_DIE);
-    die_child = nullptr;
+    dwarf_dealloc(dbg, die, DW_DLA_DIE);
+
+    type_ids[offset] = id;
+    return id;
   }
 
-  void DwarfReader::parseFunction(Dwarf_Die die, Symbol& fun) {
-    Dwarf_Error err = nullptr;
+  void DwarfReader::parseFunction(Dwarf_Die die, DwarfFunction& fun) {
     Dwarf_Half tag = 0;
     dwarf_tag(die, &tag, nullptr);
 
@@ -336,21 +293,10 @@ namespace ldb {
       name = nullptr;
     }
 
-    Dwarf_Attribute attr;
-    Dwarf_Off in_type = 0;
-    int got_type =
-            !dwarf_attr(die, DW_AT_type, &attr, nullptr) && !dwarf_formref(attr, &in_type, &err);
-
-    std::string type_name = "";
-    if (got_type) {
-      auto it = type_tabl.find(in_type);
-      if (it != type_tabl.end()) type_name = it->second;
-    }
-
     if (tag == DW_TAG_formal_parameter) {
-      fun.getArgs().push_back(Symbol(str_name, type_name));
+      fun.args.emplace_back(str_name, getTypeOf(die));
     } else if (tag == DW_TAG_variable) {
-      fun.getVars().push_back(Symbol(str_name, type_name));
+      fun.vars.emplace_back(str_name, getTypeOf(die));
     }
 
     Dwarf_Die child = 0;
@@ -360,9 +306,45 @@ namespace ldb {
     if (res == DW_DLV_OK) parseFunction(child, fun);
   }
 
-  void readDwarfDebugInfo(Elf* elf, DebugInfo& db) {
-    DwarfReader reader(elf);
-    reader.populateDwarf(*db.getSymbolTable());
+  std::vector<DwarfFunction> decodeDwarfUnit(Dwarf_Debug dbg, Dwarf_Off cu_offset) {
+    Dwarf_Die cu_die = nullptr;
+    if (dwarf_offdie(dbg, cu_offset, &cu_die, nullptr) != DW_DLV_OK)
+      throw std::runtime_error("dwarf_offdie failed");
+
+    std::vector<DwarfFunction> functions;
+    try {
+      DwarfReader reader(dbg);
+      reader.readUnit(cu_die, functions);
+    } catch (...) {
+      dwarf_dealloc(dbg, cu_die, DW_DLA_DIE);
+      throw;
+    }
+    dwarf_dealloc(dbg, cu_die, DW_DLA_DIE);
+    return functions;
+  }
+
+  void mergeDwarfFunctions(std::vector<DwarfFunction>&& functions, SymbolTable& symbols) {
+    for (auto& fun : functions) {
+      auto* sym = symbols.findInObject(fun.name);
+      if (not sym) continue;
+
+      sym->setLine(fun.line);
+      // The ELF size is authoritative, it was used to index the symbols
+      if (fun.size > 0 and sym->getSize() == 0) sym->setSize(fun.size);
+      if (not fun.file.empty()) sym->setFile(fun.file);
+      if (fun.type != TypeTable::kUnknown) sym->setTypeId(fun.type);
+
+      auto& args = sym->getArgs();
+      args.insert(args.end(), std::make_move_iterator(fun.args.begin()),
+                  std::make_move_iterator(fun.args.end()));
+      auto& vars = sym->getVars();
+      vars.insert(vars.end(), std::make_move_iterator(fun.vars.begin()),
+                  std::make_move_iterator(fun.vars.end()));
+    }
+  }
+
+  void readDwarfUnit(Dwarf_Debug dbg, Dwarf_Off cu_offset, SymbolTable& symbols) {
+    mergeDwarfFunctions(decodeDwarfUnit(dbg, cu_offset), symbols);
   }
 
-}// namespace ldb
\ No newline at end of file
+}// namespace ldb
@@ -1,15 +1,19 @@
 #include "ELFParser.h"
+#include "DwarfModule.h"
 #include "DwarfReader.h"
+#include "SymbolCache.h"
 #include <algorithm>
 #include <boost/asio.hpp>
-#include <boost/core/demangle.hpp>
+#include <cstring>
 #include <execution>
+#include <fstream>
 #include <future>
 #include <libdwarf/libdwarf.h>
 #include <libelf.h>
 #include <link.h>
-#include <sys/ptrace.h>
 #include <sys/wait.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <tscl.hpp>
 #include <utility>
 
@@ -27,78 +31,164 @@
 namespace ldb {
 
 
-  ELFFile::ELFFile(const fs::path& elf_path)
-      : debug_info(std::make_unique<DebugInfo>()), badbit(false) {
+  ELFFile::ELFFile(const fs::path& elf_path, ModulePool* reusable)
+      : file(elf_path), elf_path(elf_path), debug_info(std::make_unique<DebugInfo>()),
+        badbit(false) {
 
-    loadIntoMemory(elf_path);
+    parseHeader();
+    parseSections();
+    object_id = ObjectId(parseBuildId(), elf_path, file.getStat());
 
-    // We should not wrap the memory return by libelf using unique_ptr since
-    // Malloc and New are not supposed to be compatible and free/delete may throw
-    Elf* elf = elf_memory(data.get(), std::filesystem::file_size(elf_path));
-    if (not elf) throw std::runtime_error("Failed to load file: " + elf_path.string());
+    // Most objects did not change since the last time we parsed them
+    if (reusable and loadFromPool(*reusable)) return;
+    if (loadFromCache()) return;
 
+    // Parse the local symbols of the file (Only functions)
+    parseSymbols();
 
-    header = elf64_getehdr(elf);
-    if (not header) throw std::runtime_error("Failed to read elf header");
+    // The debug information is only decoded when it is needed, unless lazy loading was disabled
+    auto* symtab = debug_info->getSymbolTable();
+    if (symtab and hasSection(".debug_info")) {
+      auto dwarf = std::make_shared<DwarfModule>(elf_path);
+      symtab->setDwarfModule(dwarf);
+      if (not DwarfModule::isLazyLoadingEnabled()) addDwarfWarnings(dwarf->loadAll(*symtab));
+    }
 
-    parseSections();
+    // DWARF may have refined the size of the symbols, we can now index them
+    if (not symtab) return;
+    symtab->setObjectId(object_id);
+    symtab->indexAddresses();
 
-    // Parse the local symbols of the file (Only functions)
-    parseSymbols();
+    if (auto* cache = SymbolCache::getDefault(); cache and not cache->store(object_id, *symtab))
+      warnings.push_back("Failed to cache the symbols of " + elf_path.string());
+  }
 
-    readDwarfDebugInfo(elf, *debug_info.get());
-    elf_end(elf);
+  void ELFFile::addDwarfWarnings(std::vector<std::string>&& errors) {
+    for (auto& error : errors)
+      warnings.push_back("Failed to read the debug information of " + elf_path.string() + ": " +
+                         error);
   }
 
-  ELFFile::~ELFFile() {
-    // if (header) free(header);
+  bool ELFFile::loadFromCache() {
+    auto* cache = SymbolCache::getDefault();
+    if (not cache) return false;
+
+    auto symbols = cache->load(object_id, elf_path);
+    if (not symbols) return false;
+
+    // The entry may have been written with lazy DWARF loading enabled
+    const auto& dwarf = symbols->getDwarfModule();
+    if (dwarf and not DwarfModule::isLazyLoadingEnabled())
+      addDwarfWarnings(dwarf->loadAll(*symbols));
+
+    symbols->setObjectId(object_id);
+    symbols->indexNames();
+    symbols->indexAddresses();
+    debug_info->setSymbolTable(std::move(symbols));
+    return true;
   }
 
-  void ELFFile::loadIntoMemory(const fs::path& elf_path) {
+  bool ELFFile::loadFromPool(ModulePool& pool) {
+    auto symbols = pool.take(object_id);
+    if (not symbols) return false;
+
+    // The table still holds the load address of the previous execution
+    symbols->setObjectFile(elf_path);
+    symbols->relocate(0);
+    symbols->indexAddresses();
+    debug_info->setSymbolTable(std::move(symbols));
+    return true;
+  }
 
-    std::ifstream file(elf_path, std::ios::binary);
-    file.exceptions(file.exceptions() | std::ios::failbit);
+  void ELFFile::relocateExecutable(const Process& process) {
+    // Only position independent executables are loaded at a random address
+    if (header->e_type != ET_DYN) return;
 
-    this->elf_path = elf_path;
-    file.seekg(0, std::ios::end);
-    auto size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    std::ifstream auxv("/proc/" + std::to_string(process.getPid()) + "/auxv", std::ios::binary);
+    Elf64_auxv_t entry;
+    while (auxv.read(reinterpret_cast<char*>(&entry), sizeof(entry)) and entry.a_type != AT_NULL) {
+      if (entry.a_type != AT_ENTRY) continue;
+      load_bias = entry.a_un.a_val - header->e_entry;
+      break;
+    }
 
-    data = std::make_unique<char[]>(size);
-    file.read(data.get(), size);
-    data_size = size;
+    if (auto* symtab = debug_info->getSymbolTable()) {
+      symtab->relocate(load_bias);
+      symtab->indexAddresses();
+    }
   }
 
-  // String in the elf file are stored in the following format:
-  // '\0' + string + '\0' + string + '\0' + ...
-  // We load the entire string table into memory without modifying it format
-  // Strings can then be created from the string table by using an offset
-  // Returns an empty string on failure
-  std::string ELFFile::parseStringTable(const Elf64_Shdr& str_header) {
-    std::string string_table;
-    string_table.resize(str_header.sh_size);
+  bool ELFFile::hasSection(std::string_view name) const {
+    if (header->e_shstrndx == SHN_UNDEF or header->e_shstrndx >= sections.size()) return false;
+    auto names = parseStringTable(sections[header->e_shstrndx]);
+    return std::any_of(sections.begin(), sections.end(), [&](const Elf64_Shdr& sec) {
+      return sec.sh_name < names.size() and std::string_view(names.data() + sec.sh_name) == name;
+    });
+  }
 
-    if (not data) return "";
+  std::string ELFFile::parseBuildId() const {
+    // Notes are stored as [ header | name | desc ], name and desc being padded to 4 bytes
+    constexpr size_t kAlign = 4;
+    auto align = [](size_t size) { return (size + kAlign - 1) & ~(kAlign - 1); };
+
+    for (const auto& sec : sections) {
+      if (sec.sh_type != SHT_NOTE) continue;
+      auto notes = file.view(sec.sh_offset, sec.sh_size);
+
+      size_t pos = 0;
+      while (pos + sizeof(Elf64_Nhdr) <= notes.size()) {
+        Elf64_Nhdr note;
+        std::memcpy(&note, notes.data() + pos, sizeof(note));
+        size_t name_pos = pos + sizeof(Elf64_Nhdr);
+        size_t desc_pos = name_pos + align(note.n_namesz);
+        if (desc_pos + note.n_descsz > notes.size()) break;
+
+        if (note.n_type == NT_GNU_BUILD_ID and note.n_namesz == sizeof(ELF_NOTE_GNU) and
+            notes.substr(name_pos, note.n_namesz) ==
+                    std::string_view(ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)))
+          return std::string(notes.substr(desc_pos, note.n_descsz));
+        pos = desc_pos + align(note.n_descsz);
+      }
+    }
+    return "";
+  }
 
-    if (str_header.sh_offset > data_size) throw std::runtime_error("Invalid string table offset");
-    char* dptr = data.get() + str_header.sh_offset;
+  ELFFile::~ELFFile() {
+    // if (header) free(header);
+  }
 
-    std::memcpy(string_table.data(), dptr, str_header.sh_size);
+  void ELFFile::parseHeader() {
+    header = file.at<Elf64_Ehdr>(0);
+    if (not header or std::memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 or
+        header->e_ident[EI_CLASS] != ELFCLASS64)
+      throw std::runtime_error("Failed to read elf header");
+  }
 
-    if (string_table[0] != '\0') throw std::runtime_error("Invalid string table format");
+  // String in the elf file are stored in the following format:
+  // '\0' + string + '\0' + string + '\0' + ...
+  // We return a view over the string table without modifying it format
+  // Strings can then be created from the string table by using an offset
+  // Returns an empty view on failure
+  std::string_view ELFFile::parseStringTable(const Elf64_Shdr& str_header) const {
+    if (not file.contains(str_header.sh_offset, str_header.sh_size))
+      throw std::runtime_error("Invalid string table offset");
+
+    auto string_table = file.view(str_header.sh_offset, str_header.sh_size);
+    if (string_table.empty()) return string_table;
+
+    // Every string must be null-terminated, including the last one, so that
+    // they can be safely read from an offset
+    if (string_table.front() != '\0' or string_table.back() != '\0')
+      throw std::runtime_error("Invalid string table format");
     return string_table;
   }
 
-  // Build a vector of all the sections in the elf file
+  // Point the sections view to the section headers stored in the file
   bool ELFFile::parseSections() {
-    sections.resize(header->e_shnum);
+    const auto* sec_ptr = file.at<Elf64_Shdr>(header->e_shoff, header->e_shnum);
+    if (not sec_ptr) throw std::runtime_error("Invalid section header offset");
 
-    if (header->e_shoff > data_size) throw std::runtime_error("Invalid section header offset");
-    char* dptr = data.get() + header->e_shoff;
-
-    // Parse the all sections in one go
-    auto* sec_ptr = sections.data();
-    std::memcpy(sec_ptr, dptr, header->e_shnum * sizeof(Elf64_Shdr));
+    sections = {sec_ptr, header->e_shnum};
     return true;
   }
 
@@ -111,28 +201,24 @@ namespace ldb {
     for (auto& sec : sections) {
       if (sec.sh_type != SHT_SYMTAB) continue;
 
+      if (sec.sh_link >= sections.size()) continue;
       auto sym_str_table = parseStringTable(sections[sec.sh_link]);
       if (sym_str_table.empty()) continue;
 
-      // Jump to the beginning of the symbol table
-      char* dptr = data.get() + sec.sh_offset;
+      // The symbols are read in place, straight from the mapping
       size_t n_sym = sec.sh_size / sizeof(Elf64_Sym);
+      const auto* sym_ptr = file.at<Elf64_Sym>(sec.sh_offset, n_sym);
+      if (not sym_ptr) continue;
       auto buff = std::make_unique<SymbolTable>(n_sym, elf_path);
 
-
-      for (size_t i = 0; i < n_sym; i++) {
-        Elf64_Sym sym;
-
-        char* sym_ptr = dptr + i * sizeof(Elf64_Sym);
-        std::memcpy(&sym, sym_ptr, sizeof(Elf64_Sym));
-
+      for (const Elf64_Sym& sym : std::span(sym_ptr, n_sym)) {
         if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC or sym.st_shndx > sections.size() or
-            sym.st_shndx == SHN_UNDEF) {
+            sym.st_shndx == SHN_UNDEF or sym.st_name >= sym_str_table.size()) {
           continue;
         }
 
-        std::string name(sym_str_table.data() + sym.st_name);
-        buff->emplace_back(sym.st_value, name, "");
+        // The string table is null-terminated, so the name can be read directly from it
+        buff->add(sym.st_value, sym.st_size, sym_str_table.data() + sym.st_name);
       }
       if (not symbols) {
         symbols = std::move(buff);
@@ -143,13 +229,17 @@ namespace ldb {
       // Since we only parse functions, we may have allocated too much space
       // We shrink the table to the actual size
       // This also removes empty tables in the linked list
-      if (symbols) symbols->shrinkToFit();
+      if (symbols) {
+        symbols->shrinkToFit();
+        // The symbols won't move anymore, we can index their names for the DWARF reader
+        symbols->indexNames();
+      }
       debug_info->setSymbolTable(std::move(symbols));
     }
 
-  // Locate the address of the link map
+  // Locate the address of the r_debug structure
   // Return 0 on failure
-  Elf64_Addr ELFFile::locateLinkMap(const Process& process) {
+  Elf64_Addr ELFFile::locateRendezvous(const Process& process) {
     // Locate the .dynamic section
     auto dynsec_it = std::find_if(sections.begin(), sections.end(),
                                   [](const Elf64_Shdr& s) { return s.sh_type == SHT_DYNAMIC; });
@@ -159,129 +249,38 @@ namespace ldb {
     auto& dynsec = *dynsec_it;
     size_t ndyn = dynsec.sh_size / sizeof(Elf64_Dyn);
 
-    // Parse the section entries until we find the DT_DEBUG
-    for (size_t i = 0; i < ndyn; i++) {
-
-      Elf64_Addr curr_addr = dynsec.sh_addr + i * sizeof(Elf64_Dyn);
-      long d_tag = ptrace(PTRACE_PEEKDATA, process.getPid(), curr_addr, nullptr);
+    // The whole section is read at once, the loader filled DT_DEBUG in place
+    std::vector<Elf64_Dyn> entries(ndyn);
+    auto memory = process.getMemory();
+    if (not memory.read(load_bias + dynsec.sh_addr, entries.data(), ndyn * sizeof(Elf64_Dyn)))
+      return 0;
 
-      if (d_tag == -1) break;
-
-      if (d_tag == DT_DEBUG) {
-        // The debug struct addr is the second member of the struct
-
-        auto r_debug_addr = (Elf64_Addr) ptrace(PTRACE_PEEKDATA, process.getPid(),
-                                                curr_addr + sizeof(Elf64_Sxword), 0);
-        if (r_debug_addr == 0 or errno) {
-          std::cerr << "Error while reading DT_DEBUG" << std::endl;
-          perror("ptrace");
-          return 0;
-        }
-
-        // From the debug struct we can fetch the link_map's head address
-        auto link_map_addr = (Elf64_Addr) ptrace(PTRACE_PEEKDATA, process.getPid(),
-                                                 r_debug_addr + offsetof(struct r_debug, r_map), 0);
-
-        return link_map_addr;
-      }
+    // Parse the section entries until we find the DT_DEBUG
+    for (const auto& entry : entries) {
+      if (entry.d_tag == DT_NULL) break;
+      if (entry.d_tag != DT_DEBUG) continue;
+
+      // The debug struct is only filled once the loader ran
+      if (entry.d_un.d_ptr == 0)
+        tscl::logger("DT_DEBUG is not set, the loader did not run yet", tscl::Log::Warning);
+      return entry.d_un.d_ptr;
     }
     return 0;
   }
 
-  std::string ELFFile::parseLiveString(Process& process, Elf64_Addr str_addr) {
-
-    std::string str;
-    str.resize(256);
-
-    memset(str.data(), 0, 256);
-
-    Elf64_Addr curr_addr = ptrace(PTRACE_PEEKDATA, process.getPid(), str_addr, 0);
-    if (curr_addr <= 1) return "";
-
-    // ptrace allows us to read sizeof(long) bytes at a time
-    // So we cannot read more than len(str) / sizeof(long) bytes
-    // Cast to long* for reading
-    long* dptr = reinterpret_cast<long*>(str.data());
-
-    // Ensure we have enough space to read an entire long
-    // And that the length of the string is exactly equal to the number of byte read
-    // If the second condition is false, it means we read '\0'
-    for (size_t i = 0; str.size() - i * sizeof(long) >= 0 and str.size() >= i * sizeof(long); i++) {
-      dptr[i] = ptrace(PTRACE_PEEKDATA, process.getPid(), curr_addr + i * sizeof(long), 0);
-      if (str[i] <= 0) break;
-    }
-    str.resize(str.find('\0'));
-    str.shrink_to_fit();
-    return str;
-  }
-
-  std::vector<std::pair<Elf64_Addr, std::string>> ELFFile::parseLinkMap(Process& process,
-                                                                        Elf64_Addr link_map_addr) {
-    // The link_map is stored as a linked list
-    // But we don't want to handle malloc, so we store them in a vector
-    std::vector<std::pair<Elf64_Addr, std::string>> res;
-    pid_t pid = process.getPid();
-    bool done = false;
-
-    link_map_addr = (Elf64_Addr) ptrace(PTRACE_PEEKDATA, pid,
-                                        link_map_addr + offsetof(struct link_map, l_next), 0);
-
-    while (not done) {
-      // Writing in place
-      res.emplace_back();
-      auto& curr = res.back();
-      /* base address */
-      curr.first = (Elf64_Addr) ptrace(PTRACE_PEEKDATA, pid,
-                                       link_map_addr + offsetof(struct link_map, l_addr), 0);
-      if (curr.first <= 0) {
-        res.pop_back();
-        break;
-      }
-
-      curr.second = parseLiveString(process, link_map_addr + offsetof(struct link_map, l_name));
-
-      // Address of the next item
-      link_map_addr = (Elf64_Addr) ptrace(PTRACE_PEEKDATA, pid,
-                                          link_map_addr + offsetof(struct link_map, l_next), 0);
-      if (link_map_addr <= 0 or errno) { done = true; }
-    }
-    return res;
-  }
-
-  bool ELFFile::parseDynamicSymbols(Process& process) {
+  bool ELFFile::parseDynamicSymbols(Process& process, ModulePool* reusable) {
 
     auto dynsec = std::find_if(sections.begin(), sections.end(),
                                [](const Elf64_Shdr& sec) { return sec.sh_type == SHT_DYNSYM; });
     if (dynsec == sections.end()) return false;
 
-    auto link_map_addr = locateLinkMap(process);
-    if (not link_map_addr) return false;
-
+    auto rendezvous = locateRendezvous(process);
+    if (not rendezvous) return false;
 
-    std::unique_ptr<SymbolTable> res = nullptr;
-    auto link_map = parseLinkMap(process, link_map_addr);
-
-    for (const auto& lm : link_map) {
-      try {
-        ELFFile shared_lib(lm.second);
-        // We may fail to parse the lib
-        // For example if we don't have the permissions
-        if (not shared_lib.hasSymbolTable()) continue;
-
-        auto deb_info = shared_lib.yieldDebugInfo();
-        auto new_symbols = deb_info->yieldSymbolTable();
-        new_symbols->relocate(lm.first);
-
-        if (not res) res = std::move(new_symbols);
-        else
-          res->join(std::move(new_symbols));
-        debug_info->appendSharedLibraries(lm.second);
-      } catch (std::runtime_error& e) {
-        tscl::logger("Failed to parse dynamic library " + lm.second + ": " + e.what(),
-                     tscl::Log::Warning);
-      }
-    }
+    link_map = LinkMap(rendezvous);
+    auto delta = link_map.update(process.getMemory());
 
+    auto res = loadLibraries(delta.added, *debug_info, reusable);
     auto* old_symtab = debug_info->getSymbolTable();
     if (not old_symtab) {
       debug_info->setSymbolTable(std::move(res));
@@ -289,38 +288,56 @@ namespace ldb {
       old_symtab->join(std::move(res));
     }
 
+    // Rebuild the address index so it covers the shared libraries
+    if (auto* symtab = debug_info->getSymbolTable()) symtab->indexAddresses();
     return true;
   }
 
+  std::unique_ptr<SymbolTable> ELFFile::loadLibraries(const std::vector<LinkMapEntry>& libraries,
+                                                      DebugInfo& debug_info,
+                                                      ModulePool* reusable) {
+    // Parsing a library (ELF and DWARF) does not depend on the others, so every library is
+    // parsed in its own task. Each task only writes to its own slot, which keeps the merge below
+    // deterministic: tables are joined in link map order, whatever the order the tasks ended in
+    std::vector<std::unique_ptr<SymbolTable>> tables(libraries.size());
+    std::vector<std::string> errors(libraries.size());
+    std::vector<std::vector<std::string>> warnings(libraries.size());
+
+    // Libraries have very different sizes, so we schedule them one by one
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, libraries.size(), 1),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                        for (size_t i = range.begin(); i != range.end(); i++) {
+                          const auto& lib = libraries[i];
+                          try {
+                            ELFFile shared_lib(lib.path, reusable);
+                            warnings[i] = shared_lib.getWarnings();
+                            // We may fail to parse the lib
+                            // For example if we don't have the permissions
+                            if (not shared_lib.hasSymbolTable()) continue;
+
+                            auto deb_info = shared_lib.yieldDebugInfo();
+                            tables[i] = deb_info->yieldSymbolTable();
+                            tables[i]->relocate(lib.base);
+                          } catch (std::exception& e) { errors[i] = e.what(); }
+                        }
+                      });
 
-  std::optional<std::pair<std::string, size_t>> addr2Line(const std::filesystem::path& path,
-                                                          const Elf64_Addr addr) {
-    std::array<char, 128> buffer;
-    std::stringstream ss;
-
-    ss << "addr2line -e " << path << " " << std::hex << addr;
-
-    const std::string str_cmd = std::move(ss.str());
-    const char* cmd = str_cmd.c_str();
-
-    FILE* fp = popen(cmd, "r");
-    if (not fp) throw std::runtime_error("popen failed");
-
-    std::string output;
-    while (fgets(buffer.data(), buffer.size(), fp) != nullptr) { output += buffer.data(); }
-
-    const int status = pclose(fp);
-    if (WEXITSTATUS(status) != 0) return std::nullopt;
-
-    std::pair<std::string, size_t> res;
-
-    const size_t separator = output.find(":");
-    std::string str_pos = output.substr(separator + 1);
-
-    res.first = output.substr(0, separator);
-    if (res.first == "??" or str_pos == "??") return std::nullopt;
-    res.second = strtoul(str_pos.c_str(), nullptr, 10);
+    std::unique_ptr<SymbolTable> res = nullptr;
+    for (size_t i = 0; i < libraries.size(); i++) {
+      // The logger is not meant to be used concurrently, report the errors from this thread
+      for (const auto& warning : warnings[i]) tscl::logger(warning, tscl::Log::Warning);
+      if (not errors[i].empty()) {
+        tscl::logger("Failed to parse dynamic library " + libraries[i].path + ": " + errors[i],
+                     tscl::Log::Warning);
+        continue;
+      }
+      if (not tables[i]) continue;
 
+      if (not res) res = std::move(tables[i]);
+      else
+        res->join(std::move(tables[i]));
+      debug_info.appendSharedLibraries(libraries[i].path);
+    }
     return res;
   }
 
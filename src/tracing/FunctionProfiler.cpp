@@ -0,0 +1,176 @@
+#include "FunctionProfiler.h"
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <utility>
+
+namespace ldb {
+
+  namespace {
+    uint64_t now() {
+      timespec time{};
+      clock_gettime(CLOCK_MONOTONIC, &time);
+      return uint64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    /**
+     * @brief Quote a field, since demangled names hold commas
+     */
+    void writeCsvString(std::ostream& os, const std::string& str) {
+      os << '"';
+      for (char c : str) {
+        if (c == '"') os << '"';
+        os << c;
+      }
+      os << '"';
+    }
+
+    void writeJsonString(std::ostream& os, const std::string& str) {
+      os << '"';
+      for (char c : str) {
+        if (c == '"' or c == '\\') os << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) {
+          constexpr char kHex[] = "0123456789abcdef";
+          os << "\\u00" << kHex[c >> 4] << kHex[c & 0xF];
+        } else
+          os << c;
+      }
+      os << '"';
+    }
+  }// namespace
+
+  void FunctionProfiler::addFunction(Elf64_Addr entry, std::string name) {
+    getFunction(entry).name = std::move(name);
+  }
+
+  void FunctionProfiler::moveFunction(Elf64_Addr entry, Elf64_Addr new_entry) {
+    if (entry == new_entry or functions.contains(new_entry)) return;
+    auto node = functions.extract(entry);
+    if (node.empty()) return;
+    node.key() = new_entry;
+    functions.insert(std::move(node));
+  }
+
+  FunctionProfiler::Function& FunctionProfiler::getFunction(Elf64_Addr entry) {
+    auto [it, inserted] = functions.try_emplace(entry);
+    if (inserted) {
+      std::ostringstream ss;
+      ss << "0x" << std::hex << entry;
+      it->second.name = ss.str();
+    }
+    return it->second;
+  }
+
+  std::optional<Elf64_Addr> FunctionProfiler::enter(Elf64_Addr entry, const user_regs_struct& regs,
+                                                    const RemoteMemory& memory) {
+    uint64_t start = now();
+    auto return_address = memory.read<Elf64_Addr>(regs.rsp);
+    if (not return_address) return std::nullopt;
+
+    // Calls deeper in the stack are gone, and so is a call whose frame is reused by another one,
+    // unless it is a tail call from another function, which returns to the same address. A call
+    // of the same function from the same frame follows a longjmp instead
+    while (not calls.empty() and
+           (calls.back().stack < regs.rsp or
+            (calls.back().stack == regs.rsp and
+             (calls.back().return_address != *return_address or calls.back().function == entry))))
+      pop(std::nullopt);
+
+    auto& function = getFunction(entry);
+    function.calls++;
+    function.depth++;
+    function.max_depth = std::max(function.max_depth, function.depth);
+    calls.push_back({entry, *return_address, regs.rsp, start});
+    if (returns[*return_address]++ == 0) return return_address;
+    return std::nullopt;
+  }
+
+  bool FunctionProfiler::leave(Elf64_Addr return_address, const user_regs_struct& regs) {
+    uint64_t end = now();
+    // The return popped the return address
+    uint64_t stack = regs.rsp - sizeof(Elf64_Addr);
+    while (not calls.empty() and calls.back().stack < stack) pop(std::nullopt);
+
+    bool returned = false;
+    while (not calls.empty() and calls.back().stack == stack and
+           calls.back().return_address == return_address) {
+      pop(end);
+      returned = true;
+    }
+    return returned;
+  }
+
+  void FunctionProfiler::pop(std::optional<uint64_t> end) {
+    const auto& call = calls.back();
+    auto& function = functions.at(call.function);
+    function.depth--;
+    if (end) function.latency.record(*end - call.start);
+    else
+      function.unwound++;
+
+    auto it = returns.find(call.return_address);
+    if (--it->second == 0) {
+      released.push_back(call.return_address);
+      returns.erase(it);
+    }
+    calls.pop_back();
+  }
+
+  std::vector<Elf64_Addr> FunctionProfiler::takeReleased() {
+    return std::exchange(released, {});
+  }
+
+  void FunctionProfiler::clearCalls() {
+    for (auto& [entry, function] : functions) function.depth = 0;
+    calls.clear();
+    returns.clear();
+    released.clear();
+  }
+
+  void FunctionProfiler::clear() {
+    for (auto& [entry, function] : functions) {
+      function.calls = 0;
+      function.unwound = 0;
+      function.max_depth = function.depth;
+      function.latency.clear();
+    }
+  }
+
+  bool FunctionProfiler::exportCsv(std::ostream& os) const {
+    os << "function,address,calls,returned,unwound,max_depth,min_ns,mean_ns";
+    for (double percentile : kPercentiles) os << ",p" << percentile << "_ns";
+    os << ",max_ns\n";
+
+    for (const auto& [entry, function] : functions) {
+      const auto& latency = function.latency;
+      writeCsvString(os, function.name);
+      os << ",0x" << std::hex << entry << std::dec << ',' << function.calls << ','
+         << latency.getCount() << ',' << function.unwound << ',' << function.max_depth << ','
+         << latency.getMin() << ',' << uint64_t(latency.getMean());
+      for (double percentile : kPercentiles) os << ',' << latency.getPercentile(percentile);
+      os << ',' << latency.getMax() << '\n';
+    }
+    return os.good();
+  }
+
+  bool FunctionProfiler::exportJson(std::ostream& os) const {
+    os << "[";
+    bool first = true;
+    for (const auto& [entry, function] : functions) {
+      const auto& latency = function.latency;
+      os << (first ? "\n" : ",\n") << "  {\"function\": ";
+      first = false;
+      writeJsonString(os, function.name);
+      os << ", \"address\": " << entry << ", \"calls\": " << function.calls
+         << ", \"returned\": " << latency.getCount() << ", \"unwound\": " << function.unwound
+         << ", \"max_depth\": " << function.max_depth << ", \"min_ns\": " << latency.getMin()
+         << ", \"mean_ns\": " << uint64_t(latency.getMean());
+      for (double percentile : kPercentiles)
+        os << ", \"p" << percentile << "_ns\": " << latency.getPercentile(percentile);
+      os << ", \"max_ns\": " << latency.getMax() << "}";
+    }
+    os << "\n]\n";
+    return os.good();
+  }
+
+}// namespace ldb
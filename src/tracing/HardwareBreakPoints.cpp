@@ -0,0 +1,109 @@
+#include "HardwareBreakPoints.h"
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+namespace ldb {
+
+  namespace {
+    // Low bits of DR6, set for the watch point that triggered the trap
+    constexpr uint64_t kTriggeredMask = 0xF;
+
+    size_t getOffset(size_t index) {
+      return offsetof(struct user, u_debugreg) + index * sizeof(unsigned long);
+    }
+
+    // Encoding of the LEN bits of DR7
+    uint64_t encodeSize(uint8_t size) {
+      switch (size) {
+        case 1:
+          return 0b00;
+        case 2:
+          return 0b01;
+        case 4:
+          return 0b11;
+        case 8:
+          return 0b10;
+        default:
+          throw std::runtime_error("Watch points are 1, 2, 4 or 8 bytes long");
+      }
+    }
+
+    // Local enable bit, type and size of a register in DR7
+    uint64_t getControlMask(size_t index) {
+      return (uint64_t(1) << (2 * index)) | (uint64_t(0xF) << (16 + 4 * index));
+    }
+  }// namespace
+
+  size_t HardwareBreakPoints::add(Elf64_Addr address, Type type, uint8_t size) {
+    if (type == Type::kExecute) size = 1;
+    uint64_t len = encodeSize(size);
+    if (address % size != 0) throw std::runtime_error("Watch points must be aligned on their size");
+
+    size_t index = 0;
+    while (index < kCount and watch_points[index]) index++;
+    if (index == kCount) throw std::runtime_error("All the debug registers are in use");
+
+    uint64_t control = (dr7 & ~getControlMask(index)) | (uint64_t(1) << (2 * index)) |
+                       (uint64_t(type) << (16 + 4 * index)) | (len << (18 + 4 * index));
+    // The address is written first, so the watch point is never enabled on a stale one
+    if (not writeRegister(index, address) or not writeRegister(7, control))
+      throw std::runtime_error("Failed to write the debug registers");
+
+    dr7 = control;
+    watch_points[index] = WatchPoint{address, type, size};
+    return index;
+  }
+
+  void HardwareBreakPoints::remove(size_t index) {
+    if (index >= kCount or not watch_points[index])
+      throw std::runtime_error("Watch point not found");
+    dr7 &= ~getControlMask(index);
+    writeRegister(7, dr7);
+    writeRegister(index, 0);
+    watch_points[index].reset();
+  }
+
+  void HardwareBreakPoints::removeAll() {
+    for (size_t i = 0; i < kCount; i++)
+      if (watch_points[i]) remove(i);
+  }
+
+  void HardwareBreakPoints::reset(pid_t new_pid) {
+    pid = new_pid;
+    dr7 = 0;
+    watch_points = {};
+  }
+
+  std::optional<size_t> HardwareBreakPoints::takeTriggered() {
+    if (isEmpty()) return std::nullopt;
+    errno = 0;
+    uint64_t dr6 = ptrace(PTRACE_PEEKUSER, pid, getOffset(6), nullptr);
+    if (errno != 0) return std::nullopt;
+
+    // The bits are sticky, they would be reported again on the next trap
+    writeRegister(6, 0);
+    for (size_t i = 0; i < kCount; i++)
+      if ((dr6 & kTriggeredMask & (uint64_t(1) << i)) and watch_points[i]) return i;
+    return std::nullopt;
+  }
+
+  const char* HardwareBreakPoints::getTypeName(Type type) {
+    switch (type) {
+      case Type::kExecute:
+        return "execute";
+      case Type::kWrite:
+        return "write";
+      case Type::kReadWrite:
+        return "read/write";
+    }
+    return "unknown";
+  }
+
+  bool HardwareBreakPoints::writeRegister(size_t index, uint64_t value) {
+    return ptrace(PTRACE_POKEUSER, pid, getOffset(index), value) == 0;
+  }
+
+}// namespace ldb
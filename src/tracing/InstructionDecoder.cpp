@@ -0,0 +1,379 @@
+#include "InstructionDecoder.h"
+#include <algorithm>
+
+namespace ldb {
+
+  namespace {
+    // Longer instructions raise #GP
+    constexpr size_t kMaxLength = 15;
+
+    class Cursor {
+    public:
+      explicit Cursor(std::span<const uint8_t> code)
+          : code(code.first(std::min(code.size(), kMaxLength))) {}
+
+      bool has(size_t count) const {
+        return pos + count <= code.size();
+      }
+
+      uint8_t peek() const {
+        return code[pos];
+      }
+
+      uint8_t next() {
+        return code[pos++];
+      }
+
+      bool skip(size_t count) {
+        if (not has(count)) return false;
+        pos += count;
+        return true;
+      }
+
+      size_t getPosition() const {
+        return pos;
+      }
+
+    private:
+      std::span<const uint8_t> code;
+      size_t pos = 0;
+    };
+
+    /**
+     * @brief What follows the opcode
+     */
+    struct Operands {
+      bool modrm = false;
+      // Size of the immediate in bytes
+      uint8_t immediate = 0;
+      ControlFlow control_flow = ControlFlow::kNone;
+    };
+
+    bool isLegacyPrefix(uint8_t byte) {
+      switch (byte) {
+        case 0x26:
+        case 0x2E:
+        case 0x36:
+        case 0x3E:
+        case 0x64:
+        case 0x65:
+        case 0x66:
+        case 0x67:
+        case 0xF0:
+        case 0xF2:
+        case 0xF3:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    /**
+     * @brief Skip the ModRM byte, and the SIB byte and displacement it may be followed by
+     * @param reg Set to the reg field of the ModRM byte, which extends some opcodes
+     */
+    bool readModRM(Cursor& cursor, InstructionInfo& info, uint8_t& reg) {
+      if (not cursor.has(1)) return false;
+      uint8_t modrm = cursor.next();
+      uint8_t mod = modrm >> 6;
+      uint8_t rm = modrm & 7;
+      reg = (modrm >> 3) & 7;
+      if (mod == 3) return true;
+
+      if (rm == 4) {
+        if (not cursor.has(1)) return false;
+        uint8_t sib = cursor.next();
+        // No base register, only a 32 bits displacement
+        if (mod == 0 and (sib & 7) == 5) return cursor.skip(4);
+      } else if (mod == 0 and rm == 5) {
+        // In 64 bits mode, this encoding is relative to the next instruction
+        info.rip_displacement = cursor.getPosition();
+        return cursor.skip(4);
+      }
+
+      if (mod == 1) return cursor.skip(1);
+      if (mod == 2) return cursor.skip(4);
+      return true;
+    }
+
+    /**
+     * @brief Operands of the opcodes of the secondary map, after 0x0F
+     */
+    std::optional<Operands> decodeSecondary(Cursor& cursor) {
+      if (not cursor.has(1)) return std::nullopt;
+      uint8_t op = cursor.next();
+
+      if (op >= 0x80 and op <= 0x8F) return Operands{false, 4, ControlFlow::kRelativeBranch};
+      if ((op >= 0x70 and op <= 0x73) or op == 0xA4 or op == 0xAC or op == 0xBA or op == 0xC2 or
+          (op >= 0xC4 and op <= 0xC6))
+        return Operands{true, 1};
+      if (op >= 0xC8 and op <= 0xCF) return Operands{};
+
+      switch (op) {
+        case 0x05:// syscall
+        case 0x07:// sysret
+        case 0x34:// sysenter
+        case 0x35:// sysexit
+          return Operands{false, 0, ControlFlow::kUnsupported};
+        case 0x06:
+        case 0x08:
+        case 0x09:
+        case 0x0B:
+        case 0x0E:
+        case 0x30:
+        case 0x31:
+        case 0x32:
+        case 0x33:
+        case 0x37:
+        case 0x77:
+        case 0xA0:
+        case 0xA1:
+        case 0xA2:
+        case 0xA8:
+        case 0xA9:
+        case 0xAA:
+          return Operands{};
+        case 0x0F:// 3DNow!, whose opcode is in the immediate
+          return Operands{true, 1};
+        case 0x38:
+          if (not cursor.skip(1)) return std::nullopt;
+          return Operands{true};
+        case 0x3A:
+          if (not cursor.skip(1)) return std::nullopt;
+          return Operands{true, 1};
+        case 0x04:
+        case 0x0A:
+        case 0x0C:
+        case 0x24:
+        case 0x25:
+        case 0x26:
+        case 0x27:
+        case 0x36:
+        case 0x39:
+        case 0x3B:
+        case 0x3C:
+        case 0x3D:
+        case 0x3E:
+        case 0x3F:
+          return std::nullopt;
+        default:
+          // The rest of the map only takes a ModRM operand
+          return Operands{true};
+      }
+    }
+
+    /**
+     * @brief Operands of the instructions encoded with a VEX or EVEX prefix
+     * @param prefix The first byte of the prefix: 0xC4, 0xC5 or 0x62
+     */
+    std::optional<Operands> decodeVex(Cursor& cursor, uint8_t prefix) {
+      uint8_t map = 1;
+      if (prefix == 0xC5) {
+        if (not cursor.skip(1)) return std::nullopt;
+      } else if (prefix == 0xC4) {
+        if (not cursor.has(2)) return std::nullopt;
+        map = cursor.next() & 0x1F;
+        cursor.skip(1);
+        if (map < 1 or map > 3) return std::nullopt;
+      } else {
+        if (not cursor.has(3)) return std::nullopt;
+        map = cursor.next() & 0x07;
+        cursor.skip(2);
+        if (map == 0 or map == 4 or map == 7) return std::nullopt;
+      }
+
+      if (not cursor.has(1)) return std::nullopt;
+      uint8_t op = cursor.next();
+      // vzeroupper / vzeroall
+      if (map == 1 and op == 0x77 and prefix != 0x62) return Operands{};
+      if (map == 3) return Operands{true, 1};
+      if (map == 1 and ((op >= 0x70 and op <= 0x73) or op == 0xC2 or (op >= 0xC4 and op <= 0xC6)))
+        return Operands{true, 1};
+      return Operands{true};
+    }
+
+    /**
+     * @brief Operands of the opcodes of the primary map
+     */
+    std::optional<Operands> decodePrimary(Cursor& cursor, uint8_t op, bool operand_size,
+                                          bool address_size, bool rex_w) {
+      // Immediates sized by the operand size are never 64 bits
+      uint8_t imm_z = operand_size ? 2 : 4;
+
+      if (op == 0x0F) return decodeSecondary(cursor);
+      if (op == 0xC4 or op == 0xC5 or op == 0x62) return decodeVex(cursor, op);
+
+      // Arithmetic operations, in 8 groups of the same layout
+      if (op < 0x40) {
+        switch (op & 7) {
+          case 0:
+          case 1:
+          case 2:
+          case 3:
+            return Operands{true};
+          case 4:
+            return Operands{false, 1};
+          case 5:
+            return Operands{false, imm_z};
+          default:
+            // push/pop of segment registers and BCD operations, invalid in 64 bits mode
+            return std::nullopt;
+        }
+      }
+
+      if (op >= 0x50 and op <= 0x5F) return Operands{};
+      if (op >= 0x70 and op <= 0x7F) return Operands{false, 1, ControlFlow::kRelativeBranch};
+      if (op >= 0x84 and op <= 0x8F) return Operands{true};
+      if (op >= 0x90 and op <= 0x99) return Operands{};
+      if (op >= 0xA0 and op <= 0xA3) return Operands{false, uint8_t(address_size ? 4 : 8)};
+      if (op >= 0xB0 and op <= 0xB7) return Operands{false, 1};
+      if (op >= 0xB8 and op <= 0xBF) return Operands{false, uint8_t(rex_w ? 8 : imm_z)};
+      if (op >= 0xD8 and op <= 0xDF) return Operands{true};
+
+      switch (op) {
+        case 0x63:
+        case 0xD0:
+        case 0xD1:
+        case 0xD2:
+        case 0xD3:
+        case 0xFE:
+          return Operands{true};
+        case 0x68:
+        case 0xA9:
+          return Operands{false, imm_z};
+        case 0x69:
+        case 0x81:
+        case 0xC7:
+          return Operands{true, imm_z};
+        case 0x6A:
+        case 0xA8:
+        case 0xE4:
+        case 0xE5:
+        case 0xE6:
+        case 0xE7:
+          return Operands{false, 1};
+        case 0x6B:
+        case 0x80:
+        case 0x83:
+        case 0xC0:
+        case 0xC1:
+        case 0xC6:
+          return Operands{true, 1};
+        case 0x6C:
+        case 0x6D:
+        case 0x6E:
+        case 0x6F:
+        case 0x9B:
+        case 0x9C:
+        case 0x9D:
+        case 0x9E:
+        case 0x9F:
+        case 0xA4:
+        case 0xA5:
+        case 0xA6:
+        case 0xA7:
+        case 0xAA:
+        case 0xAB:
+        case 0xAC:
+        case 0xAD:
+        case 0xAE:
+        case 0xAF:
+        case 0xC9:
+        case 0xD7:
+        case 0xEC:
+        case 0xED:
+        case 0xEE:
+        case 0xEF:
+        case 0xF4:
+        case 0xF5:
+        case 0xF8:
+        case 0xF9:
+        case 0xFA:
+        case 0xFB:
+        case 0xFC:
+        case 0xFD:
+          return Operands{};
+        case 0xC2:// ret imm16
+          return Operands{false, 2, ControlFlow::kAbsoluteBranch};
+        case 0xC3:// ret
+          return Operands{false, 0, ControlFlow::kAbsoluteBranch};
+        case 0xC8:// enter
+          return Operands{false, 3};
+        case 0xE0:// loopne
+        case 0xE1:// loope
+        case 0xE2:// loop
+        case 0xE3:// jrcxz
+        case 0xEB:// jmp rel8
+          return Operands{false, 1, ControlFlow::kRelativeBranch};
+        case 0xE8:// call rel32
+          return Operands{false, 4, ControlFlow::kRelativeCall};
+        case 0xE9:// jmp rel32
+          return Operands{false, 4, ControlFlow::kRelativeBranch};
+        case 0xCA:// far ret
+        case 0xCB:
+        case 0xCC:// int3
+        case 0xCF:// iret
+        case 0xF1:// int1
+          return Operands{false, uint8_t(op == 0xCA ? 2 : 0), ControlFlow::kUnsupported};
+        case 0xCD:// int imm8
+          return Operands{false, 1, ControlFlow::kUnsupported};
+        case 0xF6:
+        case 0xF7:
+        case 0xFF:
+          // Depends on the reg field of the ModRM byte, see decodeInstruction()
+          return Operands{true};
+        default:
+          return std::nullopt;
+      }
+    }
+  }// namespace
+
+  std::optional<InstructionInfo> decodeInstruction(std::span<const uint8_t> code) {
+    Cursor cursor(code);
+    bool operand_size = false;
+    bool address_size = false;
+    while (cursor.has(1) and isLegacyPrefix(cursor.peek())) {
+      uint8_t prefix = cursor.next();
+      if (prefix == 0x66) operand_size = true;
+      else if (prefix == 0x67)
+        address_size = true;
+    }
+
+    // REX must come right before the opcode
+    bool rex_w = false;
+    if (cursor.has(1) and (cursor.peek() & 0xF0) == 0x40) rex_w = cursor.next() & 0x08;
+    if (not cursor.has(1)) return std::nullopt;
+
+    uint8_t op = cursor.next();
+    auto operands = decodePrimary(cursor, op, operand_size, address_size, rex_w);
+    if (not operands) return std::nullopt;
+
+    InstructionInfo info;
+    info.control_flow = operands->control_flow;
+    if (operands->modrm) {
+      uint8_t reg = 0;
+      if (not readModRM(cursor, info, reg)) return std::nullopt;
+
+      if ((op == 0xF6 or op == 0xF7) and reg < 2) {
+        // test r/m, imm
+        operands->immediate = op == 0xF6 ? 1 : (operand_size ? 2 : 4);
+      } else if (op == 0xC7 and reg == 7) {
+        // xbegin: the processor keeps its abort target, computed from the copy, past the step
+        info.control_flow = ControlFlow::kUnsupported;
+      } else if (op == 0xFF) {
+        if (reg == 2) info.control_flow = ControlFlow::kAbsoluteCall;
+        else if (reg == 4)
+          info.control_flow = ControlFlow::kAbsoluteBranch;
+        else if (reg == 3 or reg == 5)
+          info.control_flow = ControlFlow::kUnsupported;
+        else if (reg == 7)
+          return std::nullopt;
+      }
+    }
+    if (not cursor.skip(operands->immediate)) return std::nullopt;
+
+    info.length = cursor.getPosition();
+    return info;
+  }
+
+}// namespace ldb
@@ -0,0 +1,53 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace ldb {
+
+  LatencyHistogram::LatencyHistogram() : buckets(kBucketCount, 0) {}
+
+  uint32_t LatencyHistogram::getBucket(uint64_t value) {
+    if (value < 2 * kHalfBuckets) return value;
+    // The top kPrecisionBits bits of the value select the bucket within its power of two
+    uint32_t shift = std::bit_width(value) - kPrecisionBits;
+    return shift * kHalfBuckets + (value >> shift);
+  }
+
+  uint64_t LatencyHistogram::getHighestValue(uint32_t bucket) {
+    if (bucket < 2 * kHalfBuckets) return bucket;
+    uint32_t shift = bucket / kHalfBuckets - 1;
+    uint64_t lowest = uint64_t(bucket % kHalfBuckets + kHalfBuckets) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+  }
+
+  void LatencyHistogram::record(uint64_t value) {
+    buckets[getBucket(value)]++;
+    count++;
+    sum += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+
+  void LatencyHistogram::clear() {
+    std::fill(buckets.begin(), buckets.end(), 0);
+    count = 0;
+    sum = 0;
+    min = UINT64_MAX;
+    max = 0;
+  }
+
+  uint64_t LatencyHistogram::getPercentile(double percentile) const {
+    if (count == 0) return 0;
+    percentile = std::clamp(percentile, 0.0, 100.0);
+    auto rank = std::max<uint64_t>(1, std::ceil(percentile / 100 * double(count)));
+
+    uint64_t seen = 0;
+    for (uint32_t bucket = getBucket(min); bucket < kBucketCount; bucket++) {
+      seen += buckets[bucket];
+      if (seen >= rank) return std::clamp(getHighestValue(bucket), min, max);
+    }
+    return max;
+  }
+
+}// namespace ldb
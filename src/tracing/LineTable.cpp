@@ -0,0 +1,133 @@
+#include "LineTable.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace ldb {
+
+  LineTable::LineTable(Dwarf_Debug dbg, Dwarf_Die cu_die) {
+    Dwarf_Line* lines = nullptr;
+    Dwarf_Signed count = 0;
+    int res = dwarf_srclines(cu_die, &lines, &count, nullptr);
+    if (res == DW_DLV_NO_ENTRY) return;
+    if (res == DW_DLV_ERROR) throw std::runtime_error("dwarf_srclines failed");
+
+    // The file of a row is only resolved the first time its number is seen
+    std::unordered_map<Dwarf_Unsigned, uint32_t> file_indices;
+    auto resolveFile = [&](Dwarf_Line line) -> uint32_t {
+      Dwarf_Unsigned number = 0;
+      dwarf_line_srcfileno(line, &number, nullptr);
+      auto it = file_indices.find(number);
+      if (it != file_indices.end()) return it->second;
+
+      char* name = nullptr;
+      std::string path;
+      if (dwarf_linesrc(line, &name, nullptr) == DW_DLV_OK) {
+        path = std::filesystem::path(name).lexically_normal().string();
+        dwarf_dealloc(dbg, name, DW_DLA_STRING);
+      }
+      files.push_back(std::move(path));
+      file_indices[number] = files.size() - 1;
+      return files.size() - 1;
+    };
+
+    rows.reserve(count);
+    for (Dwarf_Signed i = 0; i < count; i++) {
+      Dwarf_Addr address = 0;
+      Dwarf_Unsigned line = 0;
+      Dwarf_Unsigned column = 0;
+      Dwarf_Bool is_stmt = false;
+      Dwarf_Bool end_sequence = false;
+      if (dwarf_lineaddr(lines[i], &address, nullptr) != DW_DLV_OK) continue;
+      dwarf_lineno(lines[i], &line, nullptr);
+      dwarf_lineoff_b(lines[i], &column, nullptr);
+      dwarf_linebeginstatement(lines[i], &is_stmt, nullptr);
+      dwarf_lineendsequence(lines[i], &end_sequence, nullptr);
+
+      rows.push_back({address, resolveFile(lines[i]), uint32_t(line), uint32_t(column),
+                      bool(is_stmt), bool(end_sequence)});
+    }
+    dwarf_srclines_dealloc(dbg, lines, count);
+
+    // Sequences are not required to be in order. When a sequence starts where another one ends,
+    // the end marker must come first so the address resolves to the new sequence
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& lhs, const Row& rhs) {
+      return lhs.address < rhs.address or
+             (lhs.address == rhs.address and lhs.end_sequence and not rhs.end_sequence);
+    });
+  }
+
+  std::optional<SourceLocation> LineTable::find(Elf64_Addr addr) const {
+    auto it = std::upper_bound(rows.begin(), rows.end(), addr,
+                               [](Elf64_Addr a, const Row& row) { return a < row.address; });
+    if (it == rows.begin()) return std::nullopt;
+    --it;
+    if (it->end_sequence or it->line == 0 or files[it->file].empty()) return std::nullopt;
+    return SourceLocation{files[it->file], it->line, it->column};
+  }
+
+  std::vector<Elf64_Addr> LineTable::findAddresses(const std::filesystem::path& file,
+                                                   size_t line) const {
+    std::vector<Elf64_Addr> res;
+    auto matching = matchFiles(file);
+    if (std::none_of(matching.begin(), matching.end(), [](bool b) { return b; })) return res;
+
+    for (size_t i = 0; i < rows.size(); i++) {
+      const auto& row = rows[i];
+      if (row.end_sequence or not row.is_stmt or row.line != line or not matching[row.file])
+        continue;
+
+      // Only keep the first row of every block of the line
+      if (i > 0) {
+        const auto& prev = rows[i - 1];
+        if (not prev.end_sequence and prev.line == row.line and prev.file == row.file) continue;
+      }
+      res.push_back(row.address);
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+  }
+
+  std::vector<Elf64_Addr> LineTable::findLineStarts(Elf64_Addr start, Elf64_Addr end) const {
+    std::vector<Elf64_Addr> res;
+    auto it = std::lower_bound(rows.begin(), rows.end(), start,
+                               [](const Row& row, Elf64_Addr a) { return row.address < a; });
+    for (; it != rows.end() and it->address < end; ++it) {
+      if (it->end_sequence or not it->is_stmt or it->line == 0) continue;
+      if (it != rows.begin()) {
+        const auto& prev = *(it - 1);
+        if (not prev.end_sequence and prev.line == it->line and prev.file == it->file) continue;
+      }
+      if (res.empty() or res.back() != it->address) res.push_back(it->address);
+    }
+    return res;
+  }
+
+  bool LineTable::hasFile(const std::filesystem::path& file) const {
+    auto matching = matchFiles(file);
+    return std::any_of(matching.begin(), matching.end(), [](bool b) { return b; });
+  }
+
+  std::vector<bool> LineTable::matchFiles(const std::filesystem::path& file) const {
+    std::vector<bool> res(files.size(), false);
+    std::string expected = file.lexically_normal().string();
+    if (expected.empty()) return res;
+
+    for (size_t i = 0; i < files.size(); i++) {
+      const std::string& candidate = files[i];
+      if (file.is_absolute()) {
+        res[i] = candidate == expected;
+        continue;
+      }
+      // A relative path must match whole components at the end of the file
+      if (candidate.size() < expected.size() or
+          candidate.compare(candidate.size() - expected.size(), expected.size(), expected) != 0)
+        continue;
+      res[i] = candidate.size() == expected.size() or
+               candidate[candidate.size() - expected.size() - 1] == '/';
+    }
+    return res;
+  }
+
+}// namespace ldb
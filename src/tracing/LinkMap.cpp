@@ -0,0 +1,79 @@
+#include "LinkMap.h"
+#include <algorithm>
+#include <climits>
+#include <link.h>
+#include <unordered_map>
+
+namespace ldb {
+
+  namespace {
+    // Guard against a corrupted (cyclic) list
+    constexpr size_t kMaxObjects = 1 << 16;
+  }// namespace
+
+  std::optional<Elf64_Addr> LinkMap::getBreakAddress(const RemoteMemory& memory) const {
+    if (not isValid()) return std::nullopt;
+    auto r_brk = memory.read<Elf64_Addr>(rendezvous + offsetof(struct r_debug, r_brk));
+    if (not r_brk or *r_brk == 0) return std::nullopt;
+    return r_brk;
+  }
+
+  bool LinkMap::isConsistent(const RemoteMemory& memory) const {
+    if (not isValid()) return false;
+    auto debug = memory.read<struct r_debug>(rendezvous);
+    return debug and debug->r_state == r_debug::RT_CONSISTENT;
+  }
+
+  LinkMap::Delta LinkMap::update(const RemoteMemory& memory) {
+    Delta delta;
+    if (not isValid()) return delta;
+
+    auto head = memory.read<Elf64_Addr>(rendezvous + offsetof(struct r_debug, r_map));
+    if (not head or *head == 0) return delta;
+
+    // Nodes we already know do not need their path to be read again
+    std::unordered_map<Elf64_Addr, const LinkMapEntry*> known;
+    for (const auto& entry : entries) known.emplace(entry.node, &entry);
+
+    // Each node is read in one go. The first one is the executable itself, which we skip
+    auto node = memory.read<struct link_map>(*head);
+    if (not node) return delta;
+
+    std::vector<LinkMapEntry> current;
+    for (Elf64_Addr curr = reinterpret_cast<Elf64_Addr>(node->l_next);
+         curr != 0 and current.size() < kMaxObjects;) {
+      node = memory.read<struct link_map>(curr);
+      if (not node) break;
+      Elf64_Addr addr = curr;
+      curr = reinterpret_cast<Elf64_Addr>(node->l_next);
+
+      // Objects without a base address or a name (e.g. the vdso) have no file we can parse
+      auto name_address = reinterpret_cast<Elf64_Addr>(node->l_name);
+      if (node->l_addr == 0 or name_address == 0) continue;
+
+      // The loader may reuse the memory of an unloaded node for another object
+      auto it = known.find(addr);
+      if (it != known.end() and it->second->base == node->l_addr and
+          it->second->name_address == name_address) {
+        current.push_back(*it->second);
+        continue;
+      }
+
+      auto path = memory.readString(name_address, PATH_MAX);
+      if (not path or path->empty()) continue;
+      current.push_back({addr, node->l_addr, name_address, std::move(*path)});
+    }
+
+    for (const auto& entry : current) {
+      if (std::find(entries.begin(), entries.end(), entry) == entries.end())
+        delta.added.push_back(entry);
+    }
+    for (const auto& entry : entries) {
+      if (std::find(current.begin(), current.end(), entry) == current.end())
+        delta.removed.push_back(entry);
+    }
+    entries = std::move(current);
+    return delta;
+  }
+
+}// namespace ldb
@@ -0,0 +1,60 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace ldb {
+
+  MappedFile::MappedFile(const std::filesystem::path& path) : path(path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Failed to open file: " + path.string());
+
+    if (fstat(fd, &status) != 0 or status.st_size <= 0) {
+      close(fd);
+      throw std::runtime_error("Failed to stat file: " + path.string());
+    }
+    length = status.st_size;
+
+    // libelf is allowed to patch the image it is given (e.g. when converting byte order), so we
+    // request a writable, private mapping: pages stay shared with the page cache until they are
+    // written to, and writes never reach the file since it was opened read-only
+    address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file, we can close the descriptor right away
+    close(fd);
+
+    if (address == MAP_FAILED) {
+      address = nullptr;
+      length = 0;
+      throw std::runtime_error("Failed to map file: " + path.string());
+    }
+  }
+
+  MappedFile::~MappedFile() {
+    unmap();
+  }
+
+  MappedFile::MappedFile(MappedFile&& other) noexcept
+      : path(std::move(other.path)), status(other.status),
+        address(std::exchange(other.address, nullptr)),
+        length(std::exchange(other.length, 0)) {}
+
+  MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this == &other) return *this;
+    unmap();
+    path = std::move(other.path);
+    status = other.status;
+    address = std::exchange(other.address, nullptr);
+    length = std::exchange(other.length, 0);
+    return *this;
+  }
+
+  void MappedFile::unmap() {
+    if (address) munmap(address, length);
+    address = nullptr;
+    length = 0;
+  }
+
+}// namespace ldb
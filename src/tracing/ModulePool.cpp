@@ -0,0 +1,39 @@
+#include "ModulePool.h"
+
+namespace ldb {
+
+  ModulePool::ModulePool(std::unique_ptr<SymbolTable> chain) {
+    std::unique_ptr<SymbolTable> curr = std::move(chain);
+    while (curr) {
+      auto rest = curr->detachNext();
+
+      // An object may own multiple consecutive tables (e.g. one per symbol section)
+      const ObjectId& id = curr->getObjectId();
+      if (id.isValid()) {
+        auto it = modules.find(id.getKey());
+        if (it == modules.end()) modules.emplace(id.getKey(), std::move(curr));
+        else
+          it->second->join(std::move(curr));
+      }
+      curr = std::move(rest);
+    }
+  }
+
+  std::unique_ptr<SymbolTable> ModulePool::take(const ObjectId& id) {
+    if (not id.isValid()) return nullptr;
+
+    std::lock_guard lock(mutex);
+    auto it = modules.find(id.getKey());
+    if (it == modules.end()) return nullptr;
+
+    auto res = std::move(it->second);
+    modules.erase(it);
+    return res;
+  }
+
+  size_t ModulePool::getSize() const {
+    std::lock_guard lock(mutex);
+    return modules.size();
+  }
+
+}// namespace ldb
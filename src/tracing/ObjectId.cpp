@@ -0,0 +1,36 @@
+#include "ObjectId.h"
+#include <iomanip>
+#include <sstream>
+
+namespace ldb {
+
+  namespace {
+    // 64 bits FNV-1a, used to fold the path of objects without build-id in a short key
+    uint64_t fnv1a(const std::string& str) {
+      uint64_t hash = 0xcbf29ce484222325;
+      for (unsigned char c : str) {
+        hash ^= c;
+        hash *= 0x100000001b3;
+      }
+      return hash;
+    }
+  }// namespace
+
+  ObjectId::ObjectId(const std::string& build_id, const std::filesystem::path& path,
+                     const struct stat& status) {
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+
+    if (not build_id.empty()) {
+      has_build_id = true;
+      for (unsigned char c : build_id) ss << std::setw(2) << static_cast<unsigned>(c);
+    } else {
+      // Without a build-id, we can only assume that the file did not change if it is still the
+      // same inode, and it was not modified since
+      ss << "f" << fnv1a(path.string()) << "-" << status.st_dev << "-" << status.st_ino << "-"
+         << status.st_size << "-" << status.st_mtim.tv_sec << "." << status.st_mtim.tv_nsec;
+    }
+    key = ss.str();
+  }
+
+}// namespace ldb
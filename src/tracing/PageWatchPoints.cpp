@@ -0,0 +1,174 @@
+#include "PageWatchPoints.h"
+#include <algorithm>
+#include <csignal>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <vector>
+
+namespace ldb {
+
+  namespace {
+    constexpr Elf64_Addr kPageSize = 4096;
+
+    Elf64_Addr getPage(Elf64_Addr addr) {
+      return addr & ~(kPageSize - 1);
+    }
+  }// namespace
+
+  int PageWatchPoints::Page::getProtection() const {
+    if (accesses) return PROT_NONE;
+    if (writes) return original & ~PROT_WRITE;
+    return original;
+  }
+
+  size_t PageWatchPoints::add(Elf64_Addr address, size_t size, Type type) {
+    if (type == Type::kExecute) throw std::runtime_error("Page watch points only watch data");
+    if (size == 0) throw std::runtime_error("Empty watch point");
+
+    Elf64_Addr first = getPage(address);
+    size_t count = (getPage(address + size - 1) - first) / kPageSize + 1;
+    bool known = true;
+    for (size_t i = 0; i < count; i++) known &= pages.contains(first + i * kPageSize);
+    // The protection of the pages that are not watched yet is read once, and restored later
+    if (not known) {
+      auto protection = readProtection(first, count);
+      if (not protection) throw std::runtime_error("Watched memory is not mapped");
+      for (size_t i = 0; i < count; i++) pages.try_emplace(first + i * kPageSize, (*protection)[i]);
+    }
+
+    WatchPoint watch_point{address, size, type};
+    updatePages(watch_point, 1);
+    watch_points.emplace(next_id, watch_point);
+    return next_id++;
+  }
+
+  void PageWatchPoints::remove(size_t id) {
+    auto it = watch_points.find(id);
+    if (it == watch_points.end()) throw std::runtime_error("Watch point not found");
+    updatePages(it->second, -1);
+    watch_points.erase(it);
+  }
+
+  void PageWatchPoints::removeAll() {
+    while (not watch_points.empty()) remove(watch_points.begin()->first);
+  }
+
+  void PageWatchPoints::reset(pid_t new_pid) {
+    pid = new_pid;
+    watch_points.clear();
+    pages.clear();
+  }
+
+  void PageWatchPoints::updatePages(const WatchPoint& watch_point, int delta) {
+    Elf64_Addr first = getPage(watch_point.address);
+    Elf64_Addr end = getPage(watch_point.address + watch_point.size - 1) + kPageSize;
+
+    // Consecutive pages that end up with the same protection are changed by a single syscall
+    std::optional<Elf64_Addr> run_start;
+    int run_protection = 0;
+    bool failed = false;
+    auto flush = [&](Elf64_Addr run_end) {
+      if (run_start) failed |= not protect(*run_start, run_end - *run_start, run_protection);
+      run_start = std::nullopt;
+    };
+
+    for (Elf64_Addr addr = first; addr < end; addr += kPageSize) {
+      auto it = pages.find(addr);
+      auto& page = it->second;
+      int before = page.getProtection();
+      (watch_point.type == Type::kReadWrite ? page.accesses : page.writes) += delta;
+      int after = page.getProtection();
+      if (page.accesses == 0 and page.writes == 0) pages.erase(it);
+
+      if (run_start and (before == after or after != run_protection)) flush(addr);
+      if (before != after and not run_start) {
+        run_start = addr;
+        run_protection = after;
+      }
+    }
+    flush(end);
+    if (failed) throw std::runtime_error("Failed to change the protection of the watched pages");
+  }
+
+  bool PageWatchPoints::protect(Elf64_Addr address, size_t size, int protection) {
+    auto res = syscall(SYS_mprotect, {address, size, static_cast<uint64_t>(protection), 0, 0, 0});
+    return res and *res == 0;
+  }
+
+  std::optional<std::vector<int>> PageWatchPoints::readProtection(Elf64_Addr first_page,
+                                                                  size_t count) const {
+    std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+    if (not maps) return std::nullopt;
+
+    std::vector<int> res;
+    res.reserve(count);
+    std::string line;
+    while (res.size() < count and std::getline(maps, line)) {
+      std::istringstream ss(line);
+      Elf64_Addr start = 0, end = 0;
+      char dash;
+      std::string perms;
+      if (not(ss >> std::hex >> start >> dash >> end >> perms) or perms.size() < 3) continue;
+
+      // Mappings are sorted, and the region must not have holes
+      for (Elf64_Addr page = first_page + res.size() * kPageSize;
+           res.size() < count and page >= start and page < end; page += kPageSize) {
+        res.push_back((perms[0] == 'r' ? PROT_READ : 0) | (perms[1] == 'w' ? PROT_WRITE : 0) |
+                      (perms[2] == 'x' ? PROT_EXEC : 0));
+      }
+    }
+    if (res.size() < count) return std::nullopt;
+    return res;
+  }
+
+  std::optional<size_t> PageWatchPoints::findWatchPoint(Elf64_Addr address) const {
+    for (const auto& [id, watch_point] : watch_points)
+      if (address >= watch_point.address and address < watch_point.address + watch_point.size)
+        return id;
+    return std::nullopt;
+  }
+
+  PageWatchPoints::Fault PageWatchPoints::handleFault() {
+    Fault res;
+    siginfo_t info{};
+    if (pages.empty() or ptrace(PTRACE_GETSIGINFO, pid, nullptr, &info) == -1) return res;
+    if (info.si_signo != SIGSEGV or info.si_code != SEGV_ACCERR) return res;
+    Elf64_Addr address = reinterpret_cast<Elf64_Addr>(info.si_addr);
+    Elf64_Addr page = getPage(address);
+    if (not pages.contains(page)) return res;
+
+    res = {true, findWatchPoint(address), address};
+    std::vector<Elf64_Addr> opened;
+    while (true) {
+      protect(page, kPageSize, pages.at(page).original);
+      opened.push_back(page);
+
+      ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr);
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if (not WIFSTOPPED(status)) return res;
+      if (WSTOPSIG(status) != SIGSEGV) break;
+
+      // An access that spans two watched pages faults again on the second one. Any other fault is
+      // a real one, which is reported
+      if (ptrace(PTRACE_GETSIGINFO, pid, nullptr, &info) == -1) break;
+      address = reinterpret_cast<Elf64_Addr>(info.si_addr);
+      page = getPage(address);
+      if (info.si_code != SEGV_ACCERR or not pages.contains(page) or
+          std::find(opened.begin(), opened.end(), page) != opened.end()) {
+        res.handled = false;
+        break;
+      }
+      if (not res.watch_point) res.watch_point = findWatchPoint(address);
+    }
+
+    for (auto addr : opened) protect(addr, kPageSize, pages.at(addr).getProtection());
+    return res;
+  }
+
+}// namespace ldb
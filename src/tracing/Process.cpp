@@ -156,6 +156,12 @@ namespace ldb {
 
       ptrace(PTRACE_TRACEME, 0, start_flags, nullptr);
 
+      // The mask survives execv(): the signals blocked by the tracer thread must not be blocked
+      // in the program
+      sigset_t empty;
+      sigemptyset(&empty);
+      sigprocmask(SIG_SETMASK, &empty, nullptr);
+
       // Build a vector containing all the arguments
       std::vector<const char*> argv_c;
       argv_c.reserve(args.size() + 1);
@@ -223,7 +229,7 @@ namespace ldb {
   }
 
   bool Process::isProbeable() const {
-    return isProbeableStatus(status);
+    return isProbeableStatus(getStatus());
   }
 
   bool Process::resume() {
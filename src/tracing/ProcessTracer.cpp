@@ -1,23 +1,42 @@
 #include "ProcessTracer.h"
 
 #include "RegistersSnapshot.h"
+#include <tscl.hpp>
 
 namespace ldb {
 
   ProcessTracer::ProcessTracer(const std::string& command, const std::vector<std::string>& args)
-      : executable_path(command), arguments(args) {
-
-    process = Process::fromCommand(command, args, true);
-    if (not process) throw std::runtime_error("Failed to start process");
+      : thread(std::make_unique<TracerThread>()), executable_path(command), arguments(args) {
+
+    // Only the thread that forked the process can trace it
+    execute([this]() {
+      process = Process::fromCommand(executable_path, arguments, true);
+      if (not process) throw std::runtime_error("Failed to start process");
+
+      // Wait until we reach the entry point
+      waitpid(process->getPid(), nullptr, 0);
+      process->updateStatus(Process::Status::kStopped);
+      breakpoint_handler = std::make_unique<BreakPointHandler>(this->process->getPid());
+      readSymbols();
+      watchSharedLibraries();
+    });
+  }
 
-    // Wait until we reach the entry point
-    waitpid(process->getPid(), nullptr, 0);
-    process->updateStatus(Process::Status::kStopped);
-    breakpoint_handler = std::make_unique<BreakPointHandler>(this->process->getPid());
-    readSymbols();
+  ProcessTracer::~ProcessTracer() {
+    // The process is killed and reaped by the thread that traces it
+    execute([this]() {
+      thread->watch(nullptr);
+      process = nullptr;
+    });
   }
 
   bool ProcessTracer::restart() {
+    return execute([this]() { return restartProcess(); });
+  }
+
+  bool ProcessTracer::restartProcess() {
+    // The symbols are replaced, or dropped if the process fails to start
+    ++symbols_generation;
     process = Process::fromCommand(executable_path, arguments, true);
     if (not process) {
       signal_handler->reset(nullptr, nullptr);
@@ -34,23 +53,31 @@ namespace ldb {
 
     // We must re-read the symbols
     // While the path may not have changed, the user may have recompiled the program
-    // in between, so this is a must
-    readSymbols();
+    // in between, so this is a must. Most objects did not change though: their tables are
+    // kept, and only the ones whose identity changed are parsed again
+    ModulePool previous(debug_info->yieldSymbolTable());
+    debug_info = nullptr;
+    readSymbols(&previous);
 
     // We update the breakPoint table with new addresses
     breakpoint_handler->refreshBreakPoint(*debug_info->getSymbolTable(), oldBreakPoints);
+    watchSharedLibraries();
 
     signal_handler->reset(process.get(), breakpoint_handler.get());
     return true;
   }
 
-  bool ProcessTracer::readSymbols() {
+  bool ProcessTracer::readSymbols(ModulePool* reusable) {
     if (process->getStatus() != Process::Status::kStopped) return false;
 
     // Read the static symbol table
-    ELFFile elf(executable_path);
+    ELFFile elf(executable_path, reusable);
+    for (const auto& warning : elf.getWarnings()) tscl::logger(warning, tscl::Log::Warning);
+    // Position independent executables are not loaded at the addresses found in the file
+    elf.relocateExecutable(*process);
     const auto* symbolTable = elf.getDebugInfo()->getSymbolTable();
-    const Symbol* _start_symbol = symbolTable->operator[]("_start");
+    const Symbol* _start_symbol = symbolTable ? (*symbolTable)["_start"] : nullptr;
+    if (not _start_symbol) throw std::runtime_error("Failed to locate _start");
 
     breakpoint_handler->add(*_start_symbol);
 
@@ -60,25 +87,68 @@ namespace ldb {
 
     waitpid(process->getPid(), nullptr, 0);
 
-    unsigned long rip = ptrace(PTRACE_PEEKUSER, process->getPid(), 8 * RIP, NULL);
-    if (not breakpoint_handler->isBreakPoint(rip - 1))
+    user_regs_struct regs{};
+    ptrace(PTRACE_GETREGS, process->getPid(), nullptr, &regs);
+    if (not breakpoint_handler->isBreakPoint(regs.rip - 1))
       throw std::runtime_error("Program crashed before _start");
 
 
-    elf.parseDynamicSymbols(*process);
+    elf.parseDynamicSymbols(*process, reusable);
+    link_map = elf.getLinkMap();
     debug_info = elf.yieldDebugInfo();
 
-    breakpoint_handler->resetBreakpoint();
+    breakpoint_handler->resetBreakpoint(regs);
 
     breakpoint_handler->remove(*_start_symbol);
+    // The entry point is never executed again, break points are stepped over there from now on
+    if (_start_symbol->getSize() >= BreakPointHandler::kScratchSize)
+      breakpoint_handler->setScratchArea(_start_symbol->getAddress());
     process->updateStatus(Process::Status::kStopped);
     return debug_info != nullptr;
   }
 
+  void ProcessTracer::watchSharedLibraries() {
+    auto r_brk = link_map.getBreakAddress(process->getMemory());
+    if (not r_brk) {
+      tscl::logger("Failed to locate r_brk, libraries loaded at runtime won't be tracked",
+                   tscl::Log::Warning);
+      return;
+    }
+    breakpoint_handler->addInternal(*r_brk, [this]() { return updateSharedLibraries(); });
+  }
+
+  bool ProcessTracer::updateSharedLibraries() {
+    if (not debug_info or not debug_info->getSymbolTable()) return false;
+
+    // The loader calls r_brk before and after changing the link map, the list can only be walked
+    // once it is consistent
+    auto memory = process->getMemory();
+    if (not link_map.isConsistent(memory)) return false;
+
+    auto delta = link_map.update(memory);
+    if (delta.isEmpty()) return false;
+
+    auto* symtab = debug_info->getSymbolTable();
+    if (not delta.removed.empty()) ++symbols_generation;
+    for (const auto& lib : delta.removed) {
+      breakpoint_handler->unloadObject(*symtab, lib.path);
+      symtab->removeObject(lib.path);
+      debug_info->removeSharedLibrary(lib.path);
+    }
+
+    symtab->join(ELFFile::loadLibraries(delta.added, *debug_info));
+    symtab->indexAddresses();
+
+    breakpoint_handler->resolvePending(*symtab);
+    return true;
+  }
+
   std::unique_ptr<RegistersSnapshot> ProcessTracer::getRegistersSnapshot() const {
-    if (not isProbeableStatus(process->getStatus())) { return {}; }
+    return thread->run([this]() -> std::unique_ptr<RegistersSnapshot> {
+      if (not isProbeableStatus(process->getStatus())) { return {}; }
 
-    return std::make_unique<RegistersSnapshot>(*process);
+      return std::make_unique<RegistersSnapshot>(*process);
+    });
   }
 
   const std::string& ProcessTracer::getExecutable() {
@@ -87,7 +157,7 @@ namespace ldb {
   }
 
   std::unique_ptr<StackTrace> ProcessTracer::getStackTrace() {
-    return std::make_unique<StackTrace>(*this);
+    return execute([this]() { return std::make_unique<StackTrace>(*this); });
   }
 
 }// namespace ldb
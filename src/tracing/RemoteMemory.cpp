@@ -0,0 +1,146 @@
+#include "RemoteMemory.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ldb {
+
+  namespace {
+    // Strings are read page by page, since reading across the end of a mapping fails as a whole
+    constexpr size_t kPageSize = 4096;
+  }// namespace
+
+  bool RemoteMemory::read(Elf64_Addr address, void* buffer, size_t size) const {
+    Chunk chunk = {address, buffer, size};
+    return read(std::span<const Chunk>(&chunk, 1));
+  }
+
+  bool RemoteMemory::read(std::span<const Chunk> chunks) const {
+    std::vector<iovec> local;
+    std::vector<iovec> remote;
+
+    // The kernel caps the number of buffers per call
+    for (size_t first = 0; first < chunks.size(); first += IOV_MAX) {
+      size_t count = std::min<size_t>(IOV_MAX, chunks.size() - first);
+      local.clear();
+      remote.clear();
+      size_t total = 0;
+      for (const auto& chunk : chunks.subspan(first, count)) {
+        local.push_back({chunk.buffer, chunk.size});
+        remote.push_back({reinterpret_cast<void*>(chunk.address), chunk.size});
+        total += chunk.size;
+      }
+
+      ssize_t n = process_vm_readv(pid, local.data(), count, remote.data(), count, 0);
+      size_t done = n < 0 ? 0 : n;
+      if (done == total) continue;
+
+      // The read stops at the first buffer that failed. The remaining bytes are read one buffer at
+      // a time through /proc/pid/mem
+      for (const auto& chunk : chunks.subspan(first, count)) {
+        if (done >= chunk.size) {
+          done -= chunk.size;
+          continue;
+        }
+        auto* buffer = static_cast<char*>(chunk.buffer) + done;
+        size_t remaining = chunk.size - done;
+        done = 0;
+        if (readFromProc(chunk.address + chunk.size - remaining, buffer, remaining) != remaining)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  bool RemoteMemory::write(Elf64_Addr address, const void* buffer, size_t size) const {
+    Chunk chunk = {address, const_cast<void*>(buffer), size};
+    return write(std::span<const Chunk>(&chunk, 1));
+  }
+
+  bool RemoteMemory::write(std::span<const Chunk> chunks) const {
+    // Same as for reads, the file is bound to the address space it was opened for
+    int fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDWR | O_CLOEXEC);
+
+    bool res = true;
+    for (const auto& chunk : chunks) {
+      const auto* buffer = static_cast<const char*>(chunk.buffer);
+      size_t done = 0;
+      while (fd >= 0 and done < chunk.size) {
+        ssize_t n = pwrite(fd, buffer + done, chunk.size - done, chunk.address + done);
+        if (n <= 0) break;
+        done += n;
+      }
+      // Some kernels refuse writes to read-only pages through /proc/pid/mem
+      if (done < chunk.size)
+        res &= writeWithPtrace(chunk.address + done, buffer + done, chunk.size - done);
+    }
+    if (fd >= 0) close(fd);
+    return res;
+  }
+
+  std::optional<std::string> RemoteMemory::readString(Elf64_Addr address, size_t max_size) const {
+    std::string res;
+    char buffer[kPageSize];
+
+    while (res.size() < max_size) {
+      // Never read past the end of the current page, the next one may not be mapped
+      size_t size = kPageSize - (address % kPageSize);
+      size = std::min(size, max_size - res.size());
+      if (not read(address, buffer, size)) {
+        if (res.empty()) return std::nullopt;
+        return res;
+      }
+
+      std::string_view view(buffer, size);
+      size_t end = view.find('\0');
+      res.append(view.substr(0, end));
+      if (end != std::string_view::npos) break;
+      address += size;
+    }
+    return res;
+  }
+
+  size_t RemoteMemory::readFromProc(Elf64_Addr address, void* buffer, size_t size) const {
+    // The file must be opened after every exec, since it is bound to the address space of the
+    // process at the time it was opened
+    int fd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = pread(fd, static_cast<char*>(buffer) + done, size - done, address + done);
+      if (n <= 0) break;
+      done += n;
+    }
+    close(fd);
+    return done;
+  }
+
+  bool RemoteMemory::writeWithPtrace(Elf64_Addr address, const void* buffer, size_t size) const {
+    const auto* bytes = static_cast<const char*>(buffer);
+    // Words are aligned down, and partially overwritten at both ends
+    Elf64_Addr first = address - address % sizeof(long);
+    for (Elf64_Addr word_addr = first; word_addr < address + size; word_addr += sizeof(long)) {
+      errno = 0;
+      long word = ptrace(PTRACE_PEEKDATA, pid, word_addr, nullptr);
+      if (errno != 0) return false;
+
+      auto* word_bytes = reinterpret_cast<char*>(&word);
+      for (size_t i = 0; i < sizeof(long); i++) {
+        Elf64_Addr byte_addr = word_addr + i;
+        if (byte_addr >= address and byte_addr < address + size)
+          word_bytes[i] = bytes[byte_addr - address];
+      }
+      if (ptrace(PTRACE_POKEDATA, pid, word_addr, word) < 0) return false;
+    }
+    return true;
+  }
+
+}// namespace ldb
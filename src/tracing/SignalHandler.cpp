@@ -1,6 +1,7 @@
 #include "SignalHandler.h"
 #include <cerrno>
 #include <sys/ptrace.h>
+#include <sys/user.h>
 #include <tscl.hpp>
 
 namespace ldb {
@@ -27,7 +28,9 @@ namespace ldb {
 
   SignalEvent SignalHandler::waitEvent() {
     if (is_muted) return SignalEvent::None;
-    std::optional<SignalEvent> e = pollEvent(0);
+    std::optional<SignalEvent> e;
+    // Only interrupted by signals, which do not end the wait
+    while (not e) e = pollEvent(0);
     return handleEvent(*e);
   }
 
@@ -50,30 +53,36 @@ namespace ldb {
     else
       do {
         res = waitpid(process->getPid(), &status, WNOHANG);
+        // Only sleep while there is nothing to report, so events are handled as soon as possible
+        if (res != 0) break;
         usleep(delta);
         slept += delta;
-      } while (slept <= usec and res == 0 and not is_muted);
+      } while (slept <= usec and not is_muted);
 
 
     if (res == 0) {
       if (usec == 0) throw std::runtime_error("waitpid() failed");
       return std::nullopt;
     } else if (res < 0) {
+      // Interrupted on purpose, see TracerThread
+      if (errno == EINTR) return std::nullopt;
+      process->updateStatus(Process::Status::kDead);
       return SignalEvent{Signal::kSIGQUIT, Process::Status::kDead, true, false};
     }
 
     int signal = 0;
-    if (WIFSTOPPED(status)) {
+    bool stopped = WIFSTOPPED(status);
+    if (stopped) {
       signal = WSTOPSIG(status);
     } else if (WIFSIGNALED(status)) {
       signal = WTERMSIG(status);
     } else if (WIFEXITED(status)) {
       signal = SIGQUIT;
     }
-    return makeEventFromSignal(signal);
+    return makeEventFromSignal(signal, stopped);
   }
 
-  SignalEvent SignalHandler::makeEventFromSignal(int signal) {
+  SignalEvent SignalHandler::makeEventFromSignal(int signal, bool stopped) {
 
     Process::Status new_status = Process::Status::kUnknown;
 
@@ -81,6 +90,10 @@ namespace ldb {
     if (signal == SIGCONT) new_status = Process::Status::kRunning;
     else if (signal == SIGQUIT)
       new_status = Process::Status::kExited;
+    // The process is only stopped until the signal is delivered: the fault may come from a page
+    // watch point, handlePageFault() decides
+    else if (signal == SIGSEGV and stopped)
+      new_status = Process::Status::kStopped;
     // Handle catchable signals
     else if (signal == SIGTRAP or signal == SIGSTOP or signal == SIGTSTP or signal == SIGTTIN or
              signal == SIGTTOU or signal == SIGCHLD or signal == SIGALRM or signal == SIGURG or
@@ -89,26 +102,73 @@ namespace ldb {
     else
       new_status = Process::Status::kKilled;
     process->updateStatus(new_status);
+
     return {static_cast<Signal>(signal), new_status, false,
             new_status == Process::Status::kKilled or new_status == Process::Status::kExited or
                     new_status == Process::Status::kDead};
   }
 
-  SignalEvent SignalHandler::handleEvent(const SignalEvent& event) {
-    if (event.getSignal() == Signal::kSIGTRAP and breakpoint_handler->isAtBreakpoint()) {
-      breakpoint_handler->resetBreakpoint();
-      ptrace(PTRACE_SINGLESTEP, process->getPid(), nullptr, nullptr);
-      waitpid(process->getPid(), nullptr, 0);
+  std::optional<SignalEvent> SignalHandler::handlePageFault(const SignalEvent& event) {
+    if (event.getSignal() != Signal::kSIGSEGV or event.getStatus() != Process::Status::kStopped)
+      return std::nullopt;
+
+    auto& pages = breakpoint_handler->getPageWatchPoints();
+    auto fault = pages.isEmpty() ? PageWatchPoints::Fault{} : pages.handleFault();
+    if (not fault.handled) {
+      // A real fault, which kills the process once the signal is delivered
+      process->updateStatus(Process::Status::kKilled);
+      return SignalEvent{Signal::kSIGSEGV, Process::Status::kKilled, false, true};
+    }
+    // The page fault was ours: the process is only stopped, and the signal is not delivered
+    if (not fault.watch_point) {
+      process->resume();
+      return SignalEvent{Signal::kSIGSEGV, Process::Status::kRunning, true, false};
     }
-    if (ignored_signals[static_cast<size_t>(event.getSignal())]) {
-      int res = ptrace(PTRACE_CONT, process->getPid(), nullptr, nullptr);
+    return SignalEvent{Signal::kSIGTRAP, Process::Status::kStopped, false, false}
+            .withPageWatchPoint(fault.watch_point);
+  }
+
+  SignalEvent SignalHandler::handleEvent(const SignalEvent& event) {
+    if (event.getSignal() == Signal::kSIGTRAP and event.getStatus() == Process::Status::kStopped)
+      return handleTrap(event);
+    if (auto page_event = handlePageFault(event)) return *page_event;
+    if (not event.isFatal() and ignored_signals[static_cast<size_t>(event.getSignal())]) {
       // If we failed to resume the process, we consider the signal as non-ignored
-      if (res == -1) {
-        tscl::logger("Failed to continue process: current thread might not be attached",
-                     tscl::Log::Error);
-      }
-      return {event.getSignal(), event.getStatus(), false, false};
+      if (process->resume()) return {event.getSignal(), Process::Status::kRunning, true, false};
+      tscl::logger("Failed to continue process: current thread might not be attached",
+                   tscl::Log::Error);
+    }
+    return event;
+  }
+
+  void SignalHandler::logMessages(std::vector<BreakPointMessage>&& messages) {
+    for (const auto& message : messages)
+      tscl::logger(message.text, message.warning ? tscl::Log::Warning : tscl::Log::Information);
+  }
+
+  SignalEvent SignalHandler::handleTrap(const SignalEvent& event) {
+    user_regs_struct regs{};
+    if (ptrace(PTRACE_GETREGS, process->getPid(), nullptr, &regs) == -1) return event;
+
+    // Hardware watch points trap at full speed, after the access: there is no break point to step
+    // over, and the debug status register is only read then
+    if (regs.rip <= 1 or not breakpoint_handler->isBreakPoint(regs.rip - 1))
+      return event.withWatchPoint(breakpoint_handler->getHardwareBreakPoints().takeTriggered());
+
+    // Internal break points, and the ones whose action continues, are handled silently
+    auto changed = breakpoint_handler->handleInternalBreakpoint(regs);
+    bool handled = changed or breakpoint_handler->handleActionBreakpoint(regs);
+    auto messages = breakpoint_handler->takeMessages();
+    if (not messages.empty()) logMessages(std::move(messages));
+    if (handled) {
+      if (changed.value_or(false)) internalBreakpointChanged();
+      process->resume();
+      return {event.getSignal(), Process::Status::kRunning, true, false};
     }
+
+    breakpoint_handler->resetBreakpoint(regs);
+    ptrace(PTRACE_SINGLESTEP, process->getPid(), nullptr, nullptr);
+    waitpid(process->getPid(), nullptr, 0);
     return event;
   }
 }// namespace ldb
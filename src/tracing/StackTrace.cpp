@@ -1,45 +1,126 @@
 #include "StackTrace.h"
 #include "ProcessTracer.h"
+#include "RemoteMemory.h"
 #include <libunwind-ptrace.h>
 #include <libunwind.h>
 
 namespace ldb {
+
+  namespace {
+    // libunwind reads the stack of the tracee word by word, which _UPT_access_mem does with
+    // PTRACE_PEEKDATA. We provide our own accessors, reading through RemoteMemory instead, and
+    // forward everything else to the ptrace implementation
+    struct UnwindContext {
+      void* upt;
+      RemoteMemory memory;
+    };
+
+    void* upt(void* arg) {
+      return static_cast<UnwindContext*>(arg)->upt;
+    }
+
+    int findProcInfo(unw_addr_space_t as, unw_word_t ip, unw_proc_info_t* pi, int need_unwind_info,
+                     void* arg) {
+      return _UPT_find_proc_info(as, ip, pi, need_unwind_info, upt(arg));
+    }
+
+    void putUnwindInfo(unw_addr_space_t as, unw_proc_info_t* pi, void* arg) {
+      _UPT_put_unwind_info(as, pi, upt(arg));
+    }
+
+    int getDynInfoListAddr(unw_addr_space_t as, unw_word_t* dilap, void* arg) {
+      return _UPT_get_dyn_info_list_addr(as, dilap, upt(arg));
+    }
+
+    int accessMem(unw_addr_space_t as, unw_word_t addr, unw_word_t* val, int write, void* arg) {
+      // We never write in the tracee memory while unwinding, but let ptrace handle it just in case
+      if (write) return _UPT_access_mem(as, addr, val, write, upt(arg));
+
+      auto* context = static_cast<UnwindContext*>(arg);
+      if (not context->memory.read(addr, val, sizeof(unw_word_t))) return -UNW_EINVAL;
+      return 0;
+    }
+
+    int accessReg(unw_addr_space_t as, unw_regnum_t reg, unw_word_t* val, int write, void* arg) {
+      return _UPT_access_reg(as, reg, val, write, upt(arg));
+    }
+
+    int accessFpReg(unw_addr_space_t as, unw_regnum_t reg, unw_fpreg_t* val, int write,
+                    void* arg) {
+      return _UPT_access_fpreg(as, reg, val, write, upt(arg));
+    }
+
+    int resume(unw_addr_space_t as, unw_cursor_t* cursor, void* arg) {
+      return _UPT_resume(as, cursor, upt(arg));
+    }
+
+    int getProcName(unw_addr_space_t as, unw_word_t addr, char* buf, size_t len,
+                    unw_word_t* offp, void* arg) {
+      return _UPT_get_proc_name(as, addr, buf, len, offp, upt(arg));
+    }
+
+    unw_accessors_t accessors = {
+            .find_proc_info = findProcInfo,
+            .put_unwind_info = putUnwindInfo,
+            .get_dyn_info_list_addr = getDynInfoListAddr,
+            .access_mem = accessMem,
+            .access_reg = accessReg,
+            .access_fpreg = accessFpReg,
+            .resume = resume,
+            .get_proc_name = getProcName,
+    };
+  }// namespace
+
   StackTrace::StackTrace(ProcessTracer& tracer) {
-    pid_t pid = tracer.getProcess().getPid();
-    unw_addr_space_t as = unw_create_addr_space(&_UPT_accessors, 0);
+    const Process& process = tracer.getProcess();
+    unw_addr_space_t as = unw_create_addr_space(&accessors, 0);
+    if (not as) return;
+
+    UnwindContext context = {_UPT_create(process.getPid()), process.getMemory()};
+    if (not context.upt) {
+      unw_destroy_addr_space(as);
+      return;
+    }
 
-    void* context = _UPT_create(pid);
     unw_cursor_t cursor;
+    auto* SymbolTable = tracer.getDebugInfo() ? tracer.getDebugInfo()->getSymbolTable() : nullptr;
 
-    if (unw_init_remote(&cursor, as, context)) return;
+    if (SymbolTable and unw_init_remote(&cursor, as, &context) == 0) {
+      bool done = false;
+      while (not done) {
+        unw_word_t offset, pc;
+        char sym[2048];
+        if (unw_get_reg(&cursor, UNW_REG_IP, &pc) != 0) break;
 
-    auto* SymbolTable = tracer.getDebugInfo() ? tracer.getDebugInfo()->getSymbolTable() : nullptr;
-    if (not SymbolTable) return;
-
-    bool done = false;
-    while (not done) {
-      unw_word_t offset, pc;
-      char sym[2048];
-      if (unw_get_reg(&cursor, UNW_REG_IP, &pc) != 0) break;
-
-      int res = unw_get_proc_name(&cursor, sym, sizeof(sym), &offset);
-
-      // Search the address in the symbol table
-      const Symbol* symbol = (*SymbolTable)[pc - offset];// We must add the offset to the address to
-                                                         // get the address of the function
-      if (symbol) {
-        frames.emplace_back(pc - offset, offset, symbol);
-      } else {
-        // If we failed to find a symbol, we can resort to using the name provided by libunwind
-        if (res == 0) frames.emplace_back(sym, pc - offset, offset);
-        else
-          frames.emplace_back("????", pc - offset, offset);
-      }
-      done = unw_step(&cursor) <= 0;
-      if (frames.size() > 50) {
-        is_truncated = true;
-        done = true;
+        // Callers frames hold a return address, which may already point past the end of the
+        // calling function (e.g. when the call is its last instruction). Search for pc - 1 instead
+        Elf64_Addr lookup_pc = frames.empty() ? pc : pc - 1;
+
+        // Search the function containing the address in the symbol table
+        auto [symbol, table] = SymbolTable->findInTable(lookup_pc);
+        if (symbol) {
+          // The frame shows the arguments and location of the function, which may not be
+          // decoded yet
+          table->loadDebugInfo(lookup_pc);
+          frames.emplace_back(symbol->getAddress(), pc - symbol->getAddress(), symbol);
+        } else {
+          // Only ask libunwind when we don't know the function
+          int res = unw_get_proc_name(&cursor, sym, sizeof(sym), &offset);
+          // If we failed to find a symbol, we can resort to using the name provided by libunwind
+          if (res == 0) frames.emplace_back(sym, pc - offset, offset);
+          else
+            frames.emplace_back("????", pc, 0);
+        }
+        done = unw_step(&cursor) <= 0;
+        if (frames.size() > 50) {
+          is_truncated = true;
+          done = true;
+        }
       }
     }
+
+    // Release the unwinder resources, this is done on every stop
+    _UPT_destroy(context.upt);
+    unw_destroy_addr_space(as);
   }
 }// namespace ldb
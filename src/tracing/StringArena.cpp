@@ -0,0 +1,33 @@
+#include "StringArena.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ldb {
+
+  std::string_view StringArena::add(std::string_view str) {
+    size_t needed = str.size() + 1;
+    if (needed > available) {
+      // Long strings get a block of their own, so the current one is not wasted
+      size_t block_size = std::max(needed, kBlockSize);
+      blocks.push_back(std::make_unique<char[]>(block_size));
+      capacity += block_size;
+
+      if (block_size > kBlockSize and available > 0) {
+        char* res = blocks.back().get();
+        std::memcpy(res, str.data(), str.size());
+        res[str.size()] = '\0';
+        return {res, str.size()};
+      }
+      cursor = blocks.back().get();
+      available = block_size;
+    }
+
+    char* res = cursor;
+    std::memcpy(res, str.data(), str.size());
+    res[str.size()] = '\0';
+    cursor += needed;
+    available -= needed;
+    return {res, str.size()};
+  }
+
+}// namespace ldb
@@ -1,16 +1,77 @@
 #include "Symbol.h"
+#include "SymbolTable.h"
 
 namespace ldb {
+  namespace {
+    const std::filesystem::path kNoFile;
+    const std::vector<Variable> kNoVariables;
+  }// namespace
+
+  Elf64_Addr Symbol::getAddress() const {
+    if (not table) return addr;
+    return addr + table->getBaseAddress();
+  }
+
+  std::string_view Symbol::getDemangledName() const {
+    if (not table) return getName();
+    return table->demangle(*this);
+  }
+
+  const SymbolDebugInfo* Symbol::getDebugInfo() const {
+    if (debug == kNoDebugInfo or not table) return nullptr;
+    return &table->debug_infos[debug];
+  }
+
+  SymbolDebugInfo& Symbol::editDebugInfo() {
+    if (not table) throw std::runtime_error("Symbol does not belong to a table");
+    if (debug == kNoDebugInfo) {
+      debug = table->debug_infos.size();
+      table->debug_infos.emplace_back();
+    }
+    return table->debug_infos[debug];
+  }
+
+  const std::filesystem::path& Symbol::getFile() const {
+    const auto* info = getDebugInfo();
+    return info ? info->file : kNoFile;
+  }
+
+  size_t Symbol::getLine() const {
+    const auto* info = getDebugInfo();
+    return info ? info->line : 0;
+  }
+
+  TypeId Symbol::getTypeId() const {
+    const auto* info = getDebugInfo();
+    return info ? info->type : TypeTable::kUnknown;
+  }
+
+  const std::string& Symbol::getType() const {
+    return TypeTable::getDefault().getName(getTypeId());
+  }
+
+  const std::vector<Variable>& Symbol::getArgs() const {
+    const auto* info = getDebugInfo();
+    return info ? info->args : kNoVariables;
+  }
+
+  const std::vector<Variable>& Symbol::getVars() const {
+    const auto* info = getDebugInfo();
+    return info ? info->vars : kNoVariables;
+  }
+
   std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
-    os << "addr: " << symbol.addr << " name: " << symbol.name << " ";
+    os << "addr: " << symbol.getAddress() << " name: " << symbol.getName() << " ";
 
-    for (size_t i = 0; i < symbol.args.size(); i++)
-      os << "arg" << i << "(" << symbol.args[i].type << " " << symbol.args[i].name << ") ";
+    const auto& args = symbol.getArgs();
+    for (size_t i = 0; i < args.size(); i++)
+      os << "arg" << i << "(" << args[i].getType() << " " << args[i].getName() << ") ";
 
-    for (size_t i = 0; i < symbol.vars.size(); i++)
-      os << "var" << i << "(" << symbol.vars[i].type << " " << symbol.vars[i].name << ") ";
+    const auto& vars = symbol.getVars();
+    for (size_t i = 0; i < vars.size(); i++)
+      os << "var" << i << "(" << vars[i].getType() << " " << vars[i].getName() << ") ";
 
-    os << "in file: " << symbol.file << std::endl;
+    os << "in file: " << symbol.getFile() << std::endl;
     return os;
   }
 }// namespace ldb
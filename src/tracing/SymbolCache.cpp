@@ -0,0 +1,260 @@
+#include "SymbolCache.h"
+#include "DwarfModule.h"
+#include "MappedFile.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace ldb {
+
+  namespace {
+    // Layout of a cache entry:
+    // [ EntryHeader | SymbolRecord * symbol_count | VariableRecord * variable_count | strings ]
+    // Strings are stored once, null-terminated, and referenced by their offset in the pool. The
+    // offset 0 is always the empty string. Since an entry is only ever read by the machine that
+    // wrote it, everything is stored in native byte order.
+    constexpr char kMagic[8] = {'L', 'D', 'B', 'S', 'Y', 'M', 'C', '\0'};
+    // Must be bumped whenever the layout below changes
+    constexpr uint32_t kVersion = 3;
+    // The debug information was not decoded yet, and must be read from the object on demand
+    constexpr uint32_t kFlagLazyDebugInfo = 1;
+    // The object has debug information. Line tables are always read from the object
+    constexpr uint32_t kFlagDebugInfo = 2;
+
+    struct EntryHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t flags;
+      uint64_t symbol_count;
+      uint64_t variable_count;
+      uint64_t symbols_offset;
+      uint64_t variables_offset;
+      uint64_t strings_offset;
+      uint64_t strings_size;
+    };
+
+    struct SymbolRecord {
+      uint64_t address;
+      uint64_t size;
+      uint32_t name;
+      uint32_t file;
+      uint32_t type;
+      uint32_t line;
+      // Arguments are stored first, then the local variables
+      uint32_t first_variable;
+      uint32_t arg_count;
+      uint32_t var_count;
+      uint32_t flags;
+    };
+
+    // The symbol has debug information
+    constexpr uint32_t kRecordDebugInfo = 1;
+
+    struct VariableRecord {
+      uint32_t name;
+      uint32_t type;
+    };
+
+    // Deduplicates the strings so the file table and type names are only stored once
+    class StringPool {
+    public:
+      StringPool() {
+        data.push_back('\0');
+      }
+
+      uint32_t add(std::string_view str) {
+        if (str.empty()) return 0;
+        auto [it, inserted] = offsets.try_emplace(std::string(str), data.size());
+        if (inserted) {
+          data.append(str);
+          data.push_back('\0');
+        }
+        return it->second;
+      }
+
+      const std::string& getData() const {
+        return data;
+      }
+
+    private:
+      std::string data;
+      std::unordered_map<std::string, uint32_t> offsets;
+    };
+
+    std::filesystem::path defaultDirectory() {
+      if (const char* dir = std::getenv("LDB_SYMBOL_CACHE_DIR"); dir and *dir) return dir;
+      if (const char* dir = std::getenv("XDG_CACHE_HOME"); dir and *dir)
+        return std::filesystem::path(dir) / "ldb" / "symbols";
+      if (const char* dir = std::getenv("HOME"); dir and *dir)
+        return std::filesystem::path(dir) / ".cache" / "ldb" / "symbols";
+      return {};
+    }
+  }// namespace
+
+  SymbolCache::SymbolCache(std::filesystem::path directory) : directory(std::move(directory)) {}
+
+  SymbolCache* SymbolCache::getDefault() {
+    static std::unique_ptr<SymbolCache> cache = []() -> std::unique_ptr<SymbolCache> {
+      const char* enabled = std::getenv("LDB_SYMBOL_CACHE");
+      if (enabled and std::string_view(enabled) == "0") return nullptr;
+
+      auto dir = defaultDirectory();
+      if (dir.empty()) return nullptr;
+      return std::make_unique<SymbolCache>(dir);
+    }();
+    return cache.get();
+  }
+
+  std::filesystem::path SymbolCache::entryPath(const ObjectId& id) const {
+    return directory / (id.getKey() + ".ldbsym");
+  }
+
+  std::unique_ptr<SymbolTable> SymbolCache::load(const ObjectId& id,
+                                                 const std::filesystem::path& object_file) const {
+    if (not id.isValid()) return nullptr;
+
+    auto path = entryPath(id);
+    std::error_code ec;
+    if (not std::filesystem::exists(path, ec)) return nullptr;
+
+    try {
+      MappedFile entry(path);
+
+      const auto* header = entry.at<EntryHeader>(0);
+      if (not header or std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 or
+          header->version != kVersion)
+        return nullptr;
+
+      const auto* records = entry.at<SymbolRecord>(header->symbols_offset, header->symbol_count);
+      const auto* variables =
+              entry.at<VariableRecord>(header->variables_offset, header->variable_count);
+      auto strings = entry.view(header->strings_offset, header->strings_size);
+      if ((header->symbol_count and not records) or (header->variable_count and not variables) or
+          strings.empty() or strings.back() != '\0')
+        return nullptr;
+
+      // Every offset is checked, a corrupted entry is simply ignored
+      bool corrupted = false;
+      auto str = [&](uint32_t offset) -> const char* {
+        if (offset >= strings.size()) {
+          corrupted = true;
+          return "";
+        }
+        return strings.data() + offset;
+      };
+
+      auto table = std::make_unique<SymbolTable>(header->symbol_count, object_file);
+      for (size_t i = 0; i < header->symbol_count and not corrupted; i++) {
+        const auto& record = records[i];
+        auto& sym = table->add(record.address, record.size, str(record.name));
+        // Only the symbols described by the debug information get a side entry
+        if (record.flags & kRecordDebugInfo) {
+          sym.setFile(str(record.file));
+          sym.setLine(record.line);
+          sym.setType(str(record.type));
+        }
+
+        uint64_t end = uint64_t(record.first_variable) + record.arg_count + record.var_count;
+        if (end > header->variable_count) return nullptr;
+
+        const auto* var = variables + record.first_variable;
+        for (size_t j = 0; j < record.arg_count; j++, var++)
+          sym.getArgs().emplace_back(str(var->name), str(var->type));
+        for (size_t j = 0; j < record.var_count; j++, var++)
+          sym.getVars().emplace_back(str(var->name), str(var->type));
+      }
+      if (corrupted) return nullptr;
+      if (header->flags & kFlagDebugInfo) {
+        auto dwarf = std::make_shared<DwarfModule>(object_file);
+        if (not(header->flags & kFlagLazyDebugInfo)) dwarf->setDecoded();
+        table->setDwarfModule(std::move(dwarf));
+      }
+      return table;
+    } catch (std::exception&) { return nullptr; }
+  }
+
+  bool SymbolCache::store(const ObjectId& id, const SymbolTable& table) const {
+    if (not id.isValid() or directory.empty()) return false;
+
+    std::vector<SymbolRecord> records;
+    std::vector<VariableRecord> variables;
+    StringPool strings;
+
+    records.reserve(table.getSize());
+    for (const SymbolTable* curr = &table; curr != nullptr; curr = curr->getNext()) {
+      for (const auto& sym : *curr) {
+        SymbolRecord record = {};
+        record.address = sym.getRelativeAddress();
+        record.size = sym.getSize();
+        record.name = strings.add(sym.getName());
+        record.file = strings.add(sym.getFile().string());
+        record.type = strings.add(sym.getType());
+        record.line = sym.getLine();
+        record.first_variable = variables.size();
+        record.arg_count = sym.getArgs().size();
+        record.var_count = sym.getVars().size();
+        if (sym.hasDebugInfo()) record.flags |= kRecordDebugInfo;
+
+        for (const auto& arg : sym.getArgs())
+          variables.push_back({strings.add(arg.getName()), strings.add(arg.getType())});
+        for (const auto& var : sym.getVars())
+          variables.push_back({strings.add(var.getName()), strings.add(var.getType())});
+        records.push_back(record);
+      }
+    }
+
+    EntryHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    if (const auto& dwarf = table.getDwarfModule()) {
+      header.flags |= kFlagDebugInfo;
+      if (not dwarf->isDecoded()) header.flags |= kFlagLazyDebugInfo;
+    }
+    header.symbol_count = records.size();
+    header.variable_count = variables.size();
+    header.symbols_offset = sizeof(EntryHeader);
+    header.variables_offset = header.symbols_offset + records.size() * sizeof(SymbolRecord);
+    header.strings_offset = header.variables_offset + variables.size() * sizeof(VariableRecord);
+    header.strings_size = strings.getData().size();
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) return false;
+
+    // Write to a temporary file first, and move it in place once complete, so concurrent readers
+    // never see a partial entry
+    auto path = entryPath(id);
+    std::stringstream tmp_name;
+    tmp_name << path.string() << ".tmp." << getpid() << "."
+             << std::hash<std::thread::id>{}(std::this_thread::get_id());
+    std::filesystem::path tmp_path = tmp_name.str();
+
+    {
+      std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+      if (not out) return false;
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char*>(records.data()),
+                records.size() * sizeof(SymbolRecord));
+      out.write(reinterpret_cast<const char*>(variables.data()),
+                variables.size() * sizeof(VariableRecord));
+      out.write(strings.getData().data(), strings.getData().size());
+      if (not out) {
+        out.close();
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+      }
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    if (not ec) return true;
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+
+}// namespace ldb
@@ -0,0 +1,199 @@
+#include "SymbolIndex.h"
+#include <algorithm>
+#include <cctype>
+
+namespace ldb {
+
+  namespace {
+    std::string toLower(std::string_view str) {
+      std::string res(str);
+      for (auto& c : res) c = std::tolower(static_cast<unsigned char>(c));
+      return res;
+    }
+
+    uint32_t packTrigram(const char* str) {
+      return (uint32_t(uint8_t(str[0])) << 16) | (uint32_t(uint8_t(str[1])) << 8) |
+             uint32_t(uint8_t(str[2]));
+    }
+
+    // Scores are split in bands, so any substring match ranks above any fuzzy match
+    constexpr int kExactScore = 1000;
+    constexpr int kPrefixScore = 800;
+    constexpr int kSubstringScore = 600;
+    constexpr int kFuzzyScore = 299;
+    // How often the scans check whether they were cancelled
+    constexpr size_t kCancelCheckInterval = 4096;
+  }// namespace
+
+  SymbolIndex::SymbolIndex(const SymbolTable& table) {
+    symbols.reserve(table.getSize());
+    names.reserve(table.getSize());
+    mangled_names.reserve(table.getSize());
+    for (const SymbolTable* curr = &table; curr != nullptr; curr = curr->getNext()) {
+      curr->demangleAll();
+      for (const auto& sym : *curr) {
+        symbols.push_back(&sym);
+        std::string_view demangled = sym.getDemangledName();
+        names.push_back(arena.add(toLower(demangled)));
+        mangled_names.push_back(demangled == sym.getName() ? std::string_view()
+                                                           : arena.add(toLower(sym.getName())));
+      }
+    }
+  }
+
+  std::optional<int> SymbolIndex::scoreSymbol(uint32_t id, std::string_view query) const {
+    auto res = score(names[id], query);
+    if (mangled_names[id].empty()) return res;
+    auto mangled = score(mangled_names[id], query);
+    if (not res or (mangled and *mangled > *res)) return mangled;
+    return res;
+  }
+
+  bool SymbolIndex::containsQuery(uint32_t id, std::string_view query) const {
+    return names[id].find(query) != std::string_view::npos or
+           mangled_names[id].find(query) != std::string_view::npos;
+  }
+
+  std::optional<int> SymbolIndex::score(std::string_view name, std::string_view query) {
+    if (query.empty()) return 0;
+    if (query.size() > name.size()) return std::nullopt;
+
+    int extra = static_cast<int>(std::min<size_t>(name.size() - query.size(), 99));
+    size_t pos = name.find(query);
+    if (pos == 0) return name.size() == query.size() ? kExactScore : kPrefixScore - extra;
+    if (pos != std::string_view::npos) {
+      int res = kSubstringScore - static_cast<int>(std::min<size_t>(pos, 50)) - std::min(extra, 49);
+      // Matching the start of a word (foo_bar, ns::bar) is more likely to be what was meant
+      char before = name[pos - 1];
+      if (before == '_' or before == ':' or before == '.' or before == ' ') res += 50;
+      return res;
+    }
+
+    // Every character of the query must appear in order. Gaps between them lower the score
+    int penalty = 0;
+    size_t curr = 0;
+    for (size_t i = 0; i < query.size(); i++) {
+      size_t found = name.find(query[i], curr);
+      if (found == std::string_view::npos) return std::nullopt;
+      penalty += static_cast<int>(std::min<size_t>(found - curr, i == 0 ? 20 : 10));
+      curr = found + 1;
+    }
+    return std::max(1, kFuzzyScore - penalty);
+  }
+
+  void SymbolIndex::buildTrigrams() const {
+    std::vector<uint64_t> pairs;
+    for (uint32_t id = 0; id < names.size(); id++) {
+      for (std::string_view name : {names[id], mangled_names[id]}) {
+        for (size_t i = 0; i + 3 <= name.size(); i++)
+          pairs.push_back((uint64_t(packTrigram(name.data() + i)) << 32) | id);
+      }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    trigram_ids.reserve(pairs.size());
+    for (uint64_t pair : pairs) {
+      uint32_t key = pair >> 32;
+      if (trigram_keys.empty() or trigram_keys.back() != key) {
+        trigram_keys.push_back(key);
+        trigram_offsets.push_back(trigram_ids.size());
+      }
+      trigram_ids.push_back(uint32_t(pair));
+    }
+    trigram_offsets.push_back(trigram_ids.size());
+  }
+
+  void SymbolIndex::prepareSearch() const {
+    std::call_once(trigrams_built, [this]() { buildTrigrams(); });
+  }
+
+  std::vector<uint32_t> SymbolIndex::findCandidates(std::string_view query) const {
+    prepareSearch();
+
+    // The posting list of every trigram of the query
+    std::vector<std::pair<const uint32_t*, const uint32_t*>> lists;
+    for (size_t i = 0; i + 3 <= query.size(); i++) {
+      uint32_t key = packTrigram(query.data() + i);
+      auto it = std::lower_bound(trigram_keys.begin(), trigram_keys.end(), key);
+      if (it == trigram_keys.end() or *it != key) return {};
+      size_t pos = std::distance(trigram_keys.begin(), it);
+      lists.emplace_back(trigram_ids.data() + trigram_offsets[pos],
+                         trigram_ids.data() + trigram_offsets[pos + 1]);
+    }
+
+    // Intersect from the shortest list, so the intermediate results stay small
+    std::sort(lists.begin(), lists.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.second - lhs.first < rhs.second - rhs.first;
+    });
+    std::vector<uint32_t> res(lists.front().first, lists.front().second);
+    std::vector<uint32_t> tmp;
+    for (size_t i = 1; i < lists.size() and not res.empty(); i++) {
+      tmp.clear();
+      std::set_intersection(res.begin(), res.end(), lists[i].first, lists[i].second,
+                            std::back_inserter(tmp));
+      std::swap(res, tmp);
+    }
+    return res;
+  }
+
+  void SymbolIndex::search(std::string_view query, const Callback& callback,
+                           const std::atomic<bool>& cancelled, size_t batch_size) const {
+    auto deliver = [&](std::vector<Match>& matches) {
+      for (size_t i = 0; i < matches.size(); i += batch_size) {
+        if (cancelled) return false;
+        size_t end = std::min(matches.size(), i + batch_size);
+        if (not callback(std::vector<Match>(matches.begin() + i, matches.begin() + end)))
+          return false;
+      }
+      return true;
+    };
+    auto rank = [&](std::vector<Match>& matches) {
+      std::sort(matches.begin(), matches.end(), [&](const Match& lhs, const Match& rhs) {
+        if (lhs.score != rhs.score) return lhs.score > rhs.score;
+        if (names[lhs.id].size() != names[rhs.id].size())
+          return names[lhs.id].size() < names[rhs.id].size();
+        return lhs.id < rhs.id;
+      });
+    };
+
+    std::string lowered = toLower(query);
+    std::vector<Match> matches;
+    if (lowered.empty()) {
+      matches.reserve(symbols.size());
+      for (uint32_t id = 0; id < symbols.size(); id++) matches.push_back({id, 0});
+      deliver(matches);
+      return;
+    }
+
+    // First the substring matches: with at least a trigram, only the names containing every
+    // trigram of the query need to be checked
+    std::vector<bool> matched(symbols.size(), false);
+    auto check = [&](uint32_t id) {
+      if (not containsQuery(id, lowered)) return;
+      matches.push_back({id, *scoreSymbol(id, lowered)});
+      matched[id] = true;
+    };
+    if (lowered.size() >= 3) {
+      for (uint32_t id : findCandidates(lowered)) check(id);
+    } else {
+      for (uint32_t id = 0; id < symbols.size(); id++) {
+        if (id % kCancelCheckInterval == 0 and cancelled) return;
+        check(id);
+      }
+    }
+    rank(matches);
+    if (not deliver(matches)) return;
+
+    // Then the fuzzy matches, which require a full scan
+    matches.clear();
+    for (uint32_t id = 0; id < symbols.size(); id++) {
+      if (id % kCancelCheckInterval == 0 and cancelled) return;
+      if (matched[id]) continue;
+      if (auto res = scoreSymbol(id, lowered)) matches.push_back({id, *res});
+    }
+    rank(matches);
+    deliver(matches);
+  }
+
+}// namespace ldb
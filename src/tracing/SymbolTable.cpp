@@ -1,49 +1,253 @@
 #include "SymbolTable.h"
+#include "DwarfModule.h"
+#include <algorithm>
 #include <atomic>
+#include <boost/core/demangle.hpp>
+#include <string>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <thread>
+#include <unordered_map>
 namespace ldb {
 
+  namespace {
+    // Itanium C++ ABI mangled names, the only ones this demangles
+    bool isMangled(std::string_view name) {
+      return name.size() > 2 and name[0] == '_' and name[1] == 'Z';
+    }
+  }// namespace
+
   void SymbolTable::shrinkToFit() {
     for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
+      // Shrinking moves the symbols around, invalidating the names index
+      curr->names.clear();
       curr->symbols.shrink_to_fit();
     }
   }
 
-  void SymbolTable::relocate(Elf64_Addr addr) {
+  void SymbolTable::relocate(Elf64_Addr base) {
     for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
-      for (auto& sym : curr->symbols) sym.relocate(addr);
+      curr->base_address = base;
     }
-    base_address = addr;
+    // The index holds the old addresses
+    clearIndex();
   }
 
-  Symbol* SymbolTable::operator[](const std::string& name) {
-    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
-      for (auto& sym : curr->symbols) {
-        if (sym.getName() == name) { return &sym; }
-      }
+  void SymbolTable::clearIndex() {
+    range_starts.clear();
+    ranges.clear();
+    tables.clear();
+    modules.clear();
+  }
+
+  std::unique_ptr<SymbolTable> SymbolTable::detachNext() {
+    clearIndex();
+    tail = nullptr;
+    // The rest of the chain is a head of its own, whose tail is unknown
+    if (next) next->tail = nullptr;
+    return std::move(next);
+  }
+
+  const Symbol* SymbolTable::at(size_t index) const {
+    if (not tables.empty()) {
+      // Find the last table whose first symbol is at or before index. Empty tables share the
+      // position of the next one, and are skipped since the last of them is picked
+      auto it = std::upper_bound(
+              tables.begin(), tables.end(), index,
+              [](size_t i, const TableEntry& entry) { return i < entry.first_symbol; });
+      --it;
+      size_t local = index - it->first_symbol;
+      if (local >= it->table->symbols.size()) return nullptr;
+      return &it->table->symbols[local];
+    }
+
+    for (const SymbolTable* table = this; table != nullptr; table = table->next.get()) {
+      if (index < table->symbols.size()) { return &table->symbols[index]; }
+      index -= table->symbols.size();
     }
     return nullptr;
   }
 
-  const Symbol* SymbolTable::operator[](const std::string& name) const {
+  size_t SymbolTable::getSize() const {
+    if (not tables.empty()) return tables.back().first_symbol + tables.back().table->symbols.size();
+
+    size_t count = 0;
+    for (const SymbolTable* table = this; table != nullptr; table = table->next.get()) {
+      count += table->symbols.size();
+    }
+    return count;
+  }
+
+  void SymbolTable::setObjectId(const ObjectId& id) {
+    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) curr->object_id = id;
+  }
+
+  void SymbolTable::setDwarfModule(std::shared_ptr<DwarfModule> module) {
+    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) curr->dwarf = module;
+  }
+
+  const SymbolTable* SymbolTable::findTable(Elf64_Addr addr) const {
+    if (not hasAddressIndex()) return this;
+    size_t pos = findRange(addr);
+    if (pos != ranges.size()) return ranges[pos].table;
+    return findModule(addr);
+  }
+
+  const SymbolTable* SymbolTable::findModule(Elf64_Addr addr) const {
+    auto it = std::upper_bound(
+            modules.begin(), modules.end(), addr,
+            [](Elf64_Addr a, const ModuleRange& range) { return a < range.start; });
+    if (it == modules.begin()) return nullptr;
+    --it;
+    if (addr >= it->end) return nullptr;
+    return it->table;
+  }
+
+  void SymbolTable::loadDebugInfo(Elf64_Addr addr) const {
+    const SymbolTable* table = findTable(addr);
+    if (not table or not table->dwarf) return;
+
+    // Decoding fills the symbols in place. This is not visible from the outside of the table,
+    // which only gains information, so the table is still logically const
+    table->dwarf->load(addr - table->base_address, const_cast<SymbolTable&>(*table));
+  }
+
+  std::optional<SourceLocation> SymbolTable::findLocation(Elf64_Addr addr) const {
+    const SymbolTable* table = findTable(addr);
+    if (not table or not table->dwarf) return std::nullopt;
+    return table->dwarf->findLocation(addr - table->base_address);
+  }
+
+  std::vector<Elf64_Addr> SymbolTable::findAddresses(const std::filesystem::path& file,
+                                                     size_t line) const {
+    std::vector<Elf64_Addr> res;
+    // The tables of an object share the same module, which is only searched once
+    const DwarfModule* last = nullptr;
     for (const SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
-      for (const auto& sym : curr->symbols) {
-        if (sym.getName() == name) { return &sym; }
+      if (not curr->dwarf or curr->dwarf.get() == last) continue;
+      last = curr->dwarf.get();
+      for (auto addr : curr->dwarf->findAddresses(file, line))
+        res.push_back(addr + curr->base_address);
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+  }
+
+  std::vector<Elf64_Addr> SymbolTable::findLineStarts(Elf64_Addr start, Elf64_Addr end) const {
+    const SymbolTable* table = findTable(start);
+    if (not table or not table->dwarf) return {};
+    auto res = table->dwarf->findLineStarts(start - table->base_address, end - table->base_address);
+    for (auto& addr : res) addr += table->base_address;
+    return res;
+  }
+
+  void SymbolTable::setObjectFile(const std::filesystem::path& path) {
+    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get())
+      curr->object_file = path;
+  }
+
+  void SymbolTable::indexNames() {
+    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
+      curr->names.clear();
+      curr->names.reserve(curr->symbols.size());
+      // On duplicated names, keep the first symbol, as the linear search would
+      for (auto& sym : curr->symbols) curr->names.try_emplace(sym.getName(), &sym);
+    }
+  }
+
+  std::string_view SymbolTable::demangle(const Symbol& symbol) const {
+    std::string_view name = symbol.getName();
+    if (not isMangled(name)) return name;
+
+    size_t pos = &symbol - symbols.data();
+    std::lock_guard lock(demangle_mutex);
+    // Symbols may have been added since the last call
+    if (demangled.size() < symbols.size()) demangled.resize(symbols.size());
+    if (demangled[pos].empty()) {
+      // Names are null-terminated in the arena
+      std::string res = boost::core::demangle(name.data());
+      demangled[pos] = res == name ? name : demangled_strings.add(res);
+    }
+    return demangled[pos];
+  }
+
+  void SymbolTable::demangleAll() const {
+    std::vector<size_t> pending;
+    {
+      std::lock_guard lock(demangle_mutex);
+      if (demangled.size() < symbols.size()) demangled.resize(symbols.size());
+      for (size_t i = 0; i < symbols.size(); i++)
+        if (demangled[i].empty() and isMangled(symbols[i].getName())) pending.push_back(i);
+    }
+    if (pending.empty()) return;
+
+    // Demangling is the slow part, the results are only stored in the arena afterwards
+    std::vector<std::string> results(pending.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, pending.size()),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                        for (size_t i = range.begin(); i != range.end(); i++)
+                          results[i] = boost::core::demangle(symbols[pending[i]].getName().data());
+                      });
+
+    std::lock_guard lock(demangle_mutex);
+    for (size_t i = 0; i < pending.size(); i++) {
+      auto& entry = demangled[pending[i]];
+      // Demangled meanwhile by getDemangledName()
+      if (not entry.empty()) continue;
+      std::string_view name = symbols[pending[i]].getName();
+      entry = results[i] == name ? name : demangled_strings.add(results[i]);
+    }
+  }
+
+  Symbol* SymbolTable::operator[](std::string_view name) {
+    const auto* const_this = this;
+    return const_cast<Symbol*>((*const_this)[name]);
+  }
+
+  const Symbol* SymbolTable::operator[](std::string_view name) const {
+    for (const SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
+      // Fallback to a linear search if the index was not built
+      if (curr->names.empty()) {
+        for (const auto& sym : curr->symbols) {
+          if (sym.getName() == name) { return &sym; }
+        }
+        continue;
       }
+
+      auto it = curr->names.find(name);
+      if (it != curr->names.end()) return it->second;
     }
     return nullptr;
   }
 
-  Symbol* SymbolTable::operator[](Elf64_Addr addr) {
-    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
-      for (auto& sym : curr->symbols) {
-        if (sym.getAddress() == addr) { return &sym; }
+  Symbol* SymbolTable::findInObject(std::string_view name) {
+    for (SymbolTable* curr = this; curr != nullptr and curr->object_file == object_file;
+         curr = curr->next.get()) {
+      if (curr->names.empty()) {
+        for (auto& sym : curr->symbols) {
+          if (sym.getName() == name) { return &sym; }
+        }
+        continue;
       }
+
+      auto it = curr->names.find(name);
+      if (it != curr->names.end()) return it->second;
     }
     return nullptr;
   }
 
+  Symbol* SymbolTable::operator[](Elf64_Addr addr) {
+    const auto* const_this = this;
+    return const_cast<Symbol*>((*const_this)[addr]);
+  }
+
   const Symbol* SymbolTable::operator[](Elf64_Addr addr) const {
+    if (hasAddressIndex()) {
+      size_t pos = findRange(addr);
+      if (pos == ranges.size() or range_starts[pos] != addr) return nullptr;
+      return ranges[pos].symbol;
+    }
+
     for (const SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
       for (const auto& sym : curr->symbols) {
         if (sym.getAddress() == addr) { return &sym; }
@@ -53,24 +257,149 @@ namespace ldb {
   }
 
   std::pair<const Symbol*, const SymbolTable*> SymbolTable::findInTable(Elf64_Addr addr) const {
+    if (hasAddressIndex()) {
+      size_t pos = findRange(addr);
+      if (pos == ranges.size()) return {nullptr, nullptr};
+      return {ranges[pos].symbol, ranges[pos].table};
+    }
+
     for (const SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
       for (const auto& sym : curr->symbols) {
-        if (sym.getAddress() == addr) { return {&sym, curr}; }
+        if (sym.contains(addr)) { return {&sym, curr}; }
       }
     }
     return {nullptr, nullptr};
   }
 
+  size_t SymbolTable::findRange(Elf64_Addr addr) const {
+    size_t count = range_starts.size();
+    if (count == 0 or addr < range_starts.front()) return ranges.size();
+
+    // Find the last range starting at or before addr. The search is branchless: the comparison
+    // becomes a conditional move, so the lookups don't stall on mispredicted branches
+    const Elf64_Addr* base = range_starts.data();
+    while (count > 1) {
+      size_t half = count / 2;
+      base = base[half] <= addr ? base + half : base;
+      count -= half;
+    }
+
+    size_t pos = base - range_starts.data();
+    if (addr >= ranges[pos].end) return ranges.size();
+    return pos;
+  }
+
+  void SymbolTable::indexAddresses() {
+    struct Entry {
+      Elf64_Addr start;
+      Elf64_Xword size;
+      const Symbol* symbol;
+      const SymbolTable* table;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(getSize());
+    for (const SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
+      for (const auto& sym : curr->symbols) {
+        entries.push_back({sym.getAddress(), sym.getSize(), &sym, curr});
+      }
+    }
+
+    // When multiple symbols share the same address (aliases), keep the widest one
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+      return lhs.start < rhs.start or (lhs.start == rhs.start and lhs.size > rhs.size);
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const Entry& lhs, const Entry& rhs) {
+                                return lhs.start == rhs.start;
+                              }),
+                  entries.end());
+
+    range_starts.clear();
+    ranges.clear();
+    range_starts.reserve(entries.size());
+    ranges.reserve(entries.size());
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      const auto& entry = entries[i];
+      Elf64_Addr end = entry.start + entry.size;
+
+      // Hand-written assembly often comes without a size: such a symbol is assumed to extend
+      // up to the next symbol of the same object file
+      if (entry.size == 0) {
+        end = entry.start + 1;
+        if (i + 1 < entries.size() and entries[i + 1].table == entry.table)
+          end = entries[i + 1].start;
+      }
+      range_starts.push_back(entry.start);
+      ranges.push_back({end, entry.symbol, entry.table});
+    }
+
+    // Number the symbols of every table, and find the first table of every object
+    tables.clear();
+    std::unordered_map<const SymbolTable*, const SymbolTable*> object_heads;
+    size_t count = 0;
+    const SymbolTable* object_head = nullptr;
+    for (SymbolTable* curr = this; curr != nullptr; curr = curr->next.get()) {
+      tables.push_back({count, curr});
+      count += curr->symbols.size();
+      if (not object_head or object_head->object_file != curr->object_file) object_head = curr;
+      object_heads[curr] = object_head;
+      if (not curr->next) tail = curr;
+    }
+
+    // An object spans from its first symbol to the end of its last one
+    std::unordered_map<const SymbolTable*, std::pair<Elf64_Addr, Elf64_Addr>> spans;
+    for (size_t i = 0; i < ranges.size(); i++) {
+      const SymbolTable* head = object_heads[ranges[i].table];
+      auto [it, inserted] = spans.try_emplace(head, range_starts[i], ranges[i].end);
+      if (inserted) continue;
+      it->second.first = std::min(it->second.first, range_starts[i]);
+      it->second.second = std::max(it->second.second, ranges[i].end);
+    }
+
+    modules.clear();
+    modules.reserve(spans.size());
+    for (const auto& [table, span] : spans) modules.push_back({span.first, span.second, table});
+    std::sort(modules.begin(), modules.end(),
+              [](const ModuleRange& lhs, const ModuleRange& rhs) { return lhs.start < rhs.start; });
+  }
+
   void SymbolTable::join(std::unique_ptr<SymbolTable>&& other) {
     if (not other) { return; }
 
-    // Append the new table at the end of the list
-    SymbolTable* curr = nullptr;
-    for (curr = this; curr->next; curr = curr->next.get())
-      ;
-    curr->next = std::move(other);
+    // Append the new table at the end of the list. The tail is known unless the chain was cut,
+    // in which case it is searched once
+    SymbolTable* last = tail ? tail : this;
+    while (last->next) last = last->next.get();
+
+    SymbolTable* other_tail = other->tail ? other->tail : other.get();
+    other->tail = nullptr;
+    last->next = std::move(other);
+    while (other_tail->next) other_tail = other_tail->next.get();
+    tail = other_tail;
+
+    // The index does not cover the new symbols, it must be rebuilt
+    clearIndex();
   }
 
+  size_t SymbolTable::removeObject(const std::filesystem::path& path) {
+    size_t count = 0;
+    for (SymbolTable* curr = this; curr->next;) {
+      if (curr->next->object_file != path) {
+        curr = curr->next.get();
+        continue;
+      }
+      curr->next = std::move(curr->next->next);
+      count++;
+    }
+
+    if (count) {
+      clearIndex();
+      tail = nullptr;
+    }
+    return count;
+  }
 
   std::ostream& operator<<(std::ostream& os, const SymbolTable& table) {
 
@@ -0,0 +1,178 @@
+#include "TraceBuffer.h"
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+namespace ldb {
+
+  namespace {
+    std::string_view trim(std::string_view str) {
+      while (not str.empty() and std::isspace(static_cast<unsigned char>(str.front())))
+        str.remove_prefix(1);
+      while (not str.empty() and std::isspace(static_cast<unsigned char>(str.back())))
+        str.remove_suffix(1);
+      return str;
+    }
+
+    template<typename T>
+    void writeValue(std::ostream& os, T value) {
+      os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    TraceBuffer::Column parseColumn(std::string_view spec) {
+      spec = trim(spec);
+      uint32_t slice_size = 0;
+      size_t colon = spec.rfind(':');
+      if (colon != std::string_view::npos) {
+        auto size = trim(spec.substr(colon + 1));
+        if (size.empty())
+          throw std::runtime_error("Missing slice size in '" + std::string(spec) + "'");
+        constexpr uint32_t kMax = TraceBuffer::kMaxSliceSize;
+        uint64_t value = 0;
+        for (char c : size) {
+          if (not std::isdigit(static_cast<unsigned char>(c)) or value > kMax)
+            throw std::runtime_error("Invalid slice size in '" + std::string(spec) + "'");
+          value = value * 10 + (c - '0');
+        }
+        if (value == 0 or value > kMax)
+          throw std::runtime_error("Slices are 1 to " + std::to_string(kMax) + " bytes long");
+        slice_size = value;
+        spec = trim(spec.substr(0, colon));
+      }
+      return {std::string(spec), BreakPointCondition(spec), slice_size};
+    }
+  }// namespace
+
+  std::vector<TraceBuffer::Column> TraceBuffer::parseColumns(std::string_view spec) {
+    std::vector<Column> res;
+    // Commas between parentheses do not separate columns
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= spec.size(); i++) {
+      if (i < spec.size() and spec[i] == '(') depth++;
+      else if (i < spec.size() and spec[i] == ')')
+        depth--;
+      else if (i == spec.size() or (spec[i] == ',' and depth == 0)) {
+        auto column = spec.substr(start, i - start);
+        if (not trim(column).empty()) res.push_back(parseColumn(column));
+        start = i + 1;
+      }
+    }
+    if (res.empty()) throw std::runtime_error("A trace point needs at least a column");
+    return res;
+  }
+
+  TraceBuffer::TraceBuffer(std::vector<Column> columns, size_t capacity)
+      : columns(std::move(columns)), capacity(std::bit_ceil(std::max<size_t>(capacity, 1))),
+        timestamps(this->capacity) {
+    for (const auto& column : this->columns) {
+      values.emplace_back(this->capacity * column.getWidth());
+      valid.emplace_back(this->capacity);
+    }
+    chunks.reserve(this->columns.size());
+    chunk_columns.reserve(this->columns.size());
+  }
+
+  void TraceBuffer::record(const user_regs_struct& regs, uint64_t reached,
+                           const RemoteMemory& memory) {
+    uint64_t row = recorded.load(std::memory_order_relaxed);
+    size_t slot = row & (capacity - 1);
+
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timestamps[slot] = uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+    chunks.clear();
+    chunk_columns.clear();
+    for (size_t i = 0; i < columns.size(); i++) {
+      const auto& column = columns[i];
+      auto value = column.expression.evaluate(regs, reached, memory);
+      uint8_t* dest = values[i].data() + slot * column.getWidth();
+      valid[i][slot] = value.has_value();
+      if (not value) continue;
+
+      if (column.slice_size == 0) std::memcpy(dest, &*value, sizeof(int64_t));
+      else {
+        chunks.push_back({static_cast<Elf64_Addr>(*value), dest, column.slice_size});
+        chunk_columns.push_back(i);
+      }
+    }
+
+    // A slice that cannot be read fails the whole batch, which is then read slice by slice
+    if (not chunks.empty() and not memory.read(chunks)) {
+      for (size_t i = 0; i < chunks.size(); i++)
+        valid[chunk_columns[i]][slot] =
+                memory.read(chunks[i].address, chunks[i].buffer, chunks[i].size);
+    }
+    recorded.store(row + 1, std::memory_order_release);
+  }
+
+  void TraceBuffer::clear() {
+    recorded.store(0, std::memory_order_release);
+  }
+
+  size_t TraceBuffer::getSize() const {
+    return std::min<uint64_t>(getRecorded(), capacity);
+  }
+
+  uint64_t TraceBuffer::getFirst() const {
+    uint64_t total = getRecorded();
+    return total - std::min<uint64_t>(total, capacity);
+  }
+
+  uint64_t TraceBuffer::getTimestamp(uint64_t row) const {
+    return timestamps[getSlot(row)];
+  }
+
+  std::optional<int64_t> TraceBuffer::getValue(size_t column, uint64_t row) const {
+    size_t slot = getSlot(row);
+    if (not valid[column][slot]) return std::nullopt;
+    int64_t res;
+    std::memcpy(&res, values[column].data() + slot * sizeof(int64_t), sizeof(int64_t));
+    return res;
+  }
+
+  std::optional<std::span<const uint8_t>> TraceBuffer::getSlice(size_t column,
+                                                                uint64_t row) const {
+    size_t slot = getSlot(row);
+    if (not valid[column][slot]) return std::nullopt;
+    size_t width = columns[column].getWidth();
+    return std::span<const uint8_t>(values[column].data() + slot * width, width);
+  }
+
+  void TraceBuffer::exportArray(std::ostream& os, const uint8_t* array, size_t width,
+                                size_t first, size_t size) const {
+    size_t until_end = std::min(size, capacity - first);
+    os.write(reinterpret_cast<const char*>(array + first * width), until_end * width);
+    os.write(reinterpret_cast<const char*>(array), (size - until_end) * width);
+  }
+
+  bool TraceBuffer::exportTo(std::ostream& os) const {
+    // Rows recorded meanwhile are not exported
+    uint64_t total = getRecorded();
+    size_t size = std::min<uint64_t>(total, capacity);
+    size_t first = (total - size) & (capacity - 1);
+
+    os.write("LDBTRACE", 8);
+    writeValue<uint32_t>(os, kExportVersion);
+    writeValue<uint32_t>(os, columns.size());
+    writeValue<uint64_t>(os, size);
+    writeValue<uint64_t>(os, total);
+    for (const auto& column : columns) {
+      writeValue<uint32_t>(os, column.name.size());
+      os.write(column.name.data(), column.name.size());
+      writeValue<uint32_t>(os, column.slice_size);
+    }
+
+    auto* timestamp_array = reinterpret_cast<const uint8_t*>(timestamps.data());
+    exportArray(os, timestamp_array, sizeof(uint64_t), first, size);
+    for (size_t i = 0; i < columns.size(); i++) {
+      exportArray(os, valid[i].data(), 1, first, size);
+      exportArray(os, values[i].data(), columns[i].getWidth(), first, size);
+    }
+    return os.good();
+  }
+
+}// namespace ldb
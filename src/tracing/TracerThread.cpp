@@ -0,0 +1,125 @@
+#include "TracerThread.h"
+#include <csignal>
+#include <pthread.h>
+#include <tscl.hpp>
+
+namespace ldb {
+
+  namespace {
+    // Interrupts the wait of the tracer thread for the process. A standard signal, unlike the
+    // real-time ones, is only pending once however many times it is sent
+    int wakeSignal() {
+      return SIGUSR2;
+    }
+
+    void installWakeHandler() {
+      static std::once_flag installed;
+      std::call_once(installed, []() {
+        // Without SA_RESTART, waitpid() fails with EINTR instead of being restarted
+        struct sigaction action {};
+        action.sa_handler = [](int) {};
+        sigemptyset(&action.sa_mask);
+        sigaction(wakeSignal(), &action, nullptr);
+      });
+    }
+
+    void setWakeBlocked(bool blocked) {
+      sigset_t set;
+      sigemptyset(&set);
+      sigaddset(&set, wakeSignal());
+      pthread_sigmask(blocked ? SIG_BLOCK : SIG_UNBLOCK, &set, nullptr);
+    }
+  }// namespace
+
+  TracerThread::TracerThread() {
+    installWakeHandler();
+    thread = std::thread(&TracerThread::loop, this);
+  }
+
+  TracerThread::~TracerThread() {
+    run([this]() {
+      handler = nullptr;
+      stopping = true;
+    });
+    thread.join();
+  }
+
+  void TracerThread::push(std::function<void()> task) {
+    {
+      std::scoped_lock<std::mutex> lock(queue_mutex);
+      tasks.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+    wake();
+  }
+
+  void TracerThread::wake() {
+    // Tasks are checked before any other wait, only waitpid() must be interrupted
+    if (waiting) pthread_kill(thread.native_handle(), wakeSignal());
+  }
+
+  bool TracerThread::hasTasks() {
+    std::scoped_lock<std::mutex> lock(queue_mutex);
+    return not tasks.empty();
+  }
+
+  void TracerThread::runTasks() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::scoped_lock<std::mutex> lock(queue_mutex);
+        if (tasks.empty()) return;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  bool TracerThread::isWatching() const {
+    if (not handler or not handler->getProcess()) return false;
+    auto status = handler->getProcess()->getStatus();
+    return status != Process::Status::kExited and status != Process::Status::kKilled and
+           status != Process::Status::kDead;
+  }
+
+  void TracerThread::loop() {
+    // The waits of the handlers, e.g. while stepping over a break point, must not be interrupted
+    setWakeBlocked(true);
+    std::unique_lock<std::mutex> state_lock(state);
+    while (true) {
+      runTasks();
+      if (stopping) return;
+
+      if (not isWatching()) {
+        state_lock.unlock();
+        {
+          std::unique_lock<std::mutex> lock(queue_mutex);
+          queue_cv.wait(lock, [this]() { return not tasks.empty(); });
+        }
+        state_lock.lock();
+        continue;
+      }
+
+      state_lock.unlock();
+      waiting = true;
+      setWakeBlocked(false);
+      std::optional<SignalEvent> event;
+      // A wake up sent before the signal was unblocked is delivered right away, and is missed by
+      // waitpid(): the queue is checked once it can no longer be
+      if (not hasTasks()) event = handler->pollEvent(0);
+      setWakeBlocked(true);
+      waiting = false;
+      state_lock.lock();
+
+      if (not event) continue;
+      try {
+        handler->handleEvent(*event);
+      } catch (const std::exception& e) {
+        tscl::logger(std::string("Failed to handle a signal of the process: ") + e.what(),
+                     tscl::Log::Error);
+      }
+    }
+  }
+
+}// namespace ldb
@@ -0,0 +1,98 @@
+#include "TypeTable.h"
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ldb {
+
+  TypeTable::TypeTable() {
+    nodes.push_back({Kind::kNamed, kUnknown, "", true});
+    named.emplace("", kUnknown);
+  }
+
+  TypeTable& TypeTable::getDefault() {
+    static TypeTable table;
+    return table;
+  }
+
+  TypeId TypeTable::intern(std::string_view name) {
+    {
+      std::shared_lock lock(mutex);
+      auto it = named.find(name);
+      if (it != named.end()) return it->second;
+    }
+
+    std::unique_lock lock(mutex);
+    // Another thread may have added it in the meantime
+    auto it = named.find(name);
+    if (it != named.end()) return it->second;
+
+    TypeId id = nodes.size();
+    nodes.push_back({Kind::kNamed, kUnknown, std::string(name), true});
+    named.emplace(std::string(name), id);
+    return id;
+  }
+
+  TypeId TypeTable::intern(Kind kind, TypeId base) {
+    if (kind == Kind::kNamed) throw std::invalid_argument("Named types must be interned by name");
+    uint64_t key = (uint64_t(kind) << 32) | base;
+    {
+      std::shared_lock lock(mutex);
+      auto it = derived.find(key);
+      if (it != derived.end()) return it->second;
+    }
+
+    std::unique_lock lock(mutex);
+    if (base >= nodes.size()) throw std::out_of_range("Unknown base type");
+    auto it = derived.find(key);
+    if (it != derived.end()) return it->second;
+
+    TypeId id = nodes.size();
+    nodes.push_back({kind, base, "", false});
+    derived.emplace(key, id);
+    return id;
+  }
+
+  const std::string& TypeTable::getName(TypeId id) {
+    {
+      std::shared_lock lock(mutex);
+      if (id >= nodes.size()) return nodes[kUnknown].name;
+      if (nodes[id].resolved) return nodes[id].name;
+    }
+
+    std::unique_lock lock(mutex);
+    // Bases are always older than the types derived from them, so the chain ends on a named type
+    std::vector<TypeId> chain;
+    for (TypeId curr = id; not nodes[curr].resolved; curr = nodes[curr].base) chain.push_back(curr);
+
+    // Resolve from the innermost type, so every type of the chain is only built once
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      auto& node = nodes[*it];
+      const std::string& base = nodes[node.base].name;
+      switch (node.kind) {
+        case Kind::kPointer:
+          node.name = base + "*";
+          break;
+        case Kind::kConst:
+          node.name = "const " + base;
+          break;
+        case Kind::kArray:
+          node.name = base + "[]";
+          break;
+        case Kind::kReference:
+          node.name = base + "&";
+          break;
+        case Kind::kNamed:
+          break;
+      }
+      node.resolved = true;
+    }
+    return nodes[id].name;
+  }
+
+  size_t TypeTable::getSize() const {
+    std::shared_lock lock(mutex);
+    return nodes.size();
+  }
+
+}// namespace ldb
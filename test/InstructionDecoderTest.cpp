@@ -0,0 +1,176 @@
+#include "InstructionDecoder.h"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Decodes known x86-64 encodings, and checks their layout. Displaced stepping relies on the length,
+// the control flow and the offset of the RIP-relative displacement found by the decoder.
+
+namespace {
+
+  using ldb::ControlFlow;
+
+  struct Case {
+    std::string_view name;
+    std::vector<uint8_t> code;
+    // std::nullopt if the bytes must be rejected
+    std::optional<uint8_t> length;
+    ControlFlow control_flow = ControlFlow::kNone;
+    std::optional<uint8_t> rip_displacement = std::nullopt;
+  };
+
+  const std::vector<Case>& cases() {
+    static const std::vector<Case> res = {
+            // Plain opcodes
+            {"nop", {0x90}, 1},
+            {"push rbp", {0x55}, 1},
+            {"hlt", {0xF4}, 1},
+            {"add eax, imm32", {0x05, 1, 0, 0, 0}, 5},
+            {"add al, imm8", {0x04, 1}, 2},
+            {"mov eax, imm32", {0xB8, 1, 0, 0, 0}, 5},
+            {"enter", {0xC8, 0x10, 0, 0}, 4},
+
+            // Legacy prefixes
+            {"mov ax, imm16", {0x66, 0xB8, 1, 0}, 4},
+            {"test ax, imm16", {0x66, 0xA9, 1, 0}, 4},
+            {"rep movsb", {0xF3, 0xA4}, 2},
+            {"lock cmpxchg [rdx], ecx", {0xF0, 0x0F, 0xB1, 0x0A}, 4},
+            {"mov al, [moffs64]", {0xA0, 0, 0, 0, 0, 0, 0, 0, 0}, 9},
+            {"mov al, [moffs32]", {0x67, 0xA0, 0, 0, 0, 0}, 6},
+            {"mov rax, fs:0x28", {0x64, 0x48, 0x8B, 0x04, 0x25, 0x28, 0, 0, 0}, 9},
+            {"15 bytes", {0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+                          0x66, 0x66, 0x90},
+             15},
+            {"16 bytes", {0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+                          0x66, 0x66, 0x66, 0x90},
+             std::nullopt},
+
+            // REX
+            {"mov rbp, rsp", {0x48, 0x89, 0xE5}, 3},
+            {"mov rax, imm64", {0x48, 0xB8, 1, 0, 0, 0, 0, 0, 0, 0}, 10},
+            {"mov r8d, imm32", {0x41, 0xB8, 1, 0, 0, 0}, 6},
+            {"add rsp, imm8", {0x48, 0x83, 0xC4, 0x08}, 4},
+            {"sub rsp, imm32", {0x48, 0x81, 0xEC, 0, 1, 0, 0}, 7},
+            {"REX before a prefix", {0x48, 0x66, 0x90}, std::nullopt},
+
+            // ModRM and SIB
+            {"mov eax, [rbx]", {0x8B, 0x03}, 2},
+            {"mov eax, [rbx + disp8]", {0x8B, 0x43, 0x08}, 3},
+            {"mov eax, [rbx + disp32]", {0x8B, 0x83, 0, 1, 0, 0}, 6},
+            {"mov eax, [rsp + disp8]", {0x8B, 0x44, 0x24, 0x08}, 4},
+            {"mov eax, [rax * 4 + disp32]", {0x8B, 0x04, 0x85, 0, 1, 0, 0}, 7},
+            {"mov eax, [rbp + rax * 2 + disp32]", {0x8B, 0x84, 0x45, 0, 1, 0, 0}, 7},
+            {"test eax, imm32", {0xF7, 0xC0, 1, 0, 0, 0}, 6},
+            {"test ax, imm16", {0x66, 0xF7, 0xC0, 1, 0}, 5},
+            {"test al, imm8", {0xF6, 0xC0, 1}, 3},
+            {"neg eax", {0xF7, 0xD8}, 2},
+            {"imul eax, ecx, imm8", {0x6B, 0xC1, 0x03}, 3},
+            {"nopw [rax + rax]", {0x66, 0x0F, 0x1F, 0x44, 0, 0}, 6},
+            {"nopl [rax + rax + disp32]", {0x0F, 0x1F, 0x84, 0, 0, 0, 0, 0}, 8},
+            {"endbr64", {0xF3, 0x0F, 0x1E, 0xFA}, 4},
+            {"pshufb xmm0, xmm1", {0x66, 0x0F, 0x38, 0x00, 0xC1}, 5},
+            {"pextrd eax, xmm0, imm8", {0x66, 0x0F, 0x3A, 0x16, 0xC0, 1}, 6},
+            {"shl eax, imm8", {0xC1, 0xE0, 0x04}, 3},
+            {"missing SIB", {0x8B, 0x04}, std::nullopt},
+            {"missing displacement", {0x8B, 0x83, 0, 1}, std::nullopt},
+
+            // RIP-relative operands
+            {"lea rax, [rip + disp32]", {0x48, 0x8D, 0x05, 0x10, 0, 0, 0}, 7, ControlFlow::kNone,
+             3},
+            {"mov dword [rip + disp32], imm32", {0xC7, 0x05, 0x10, 0, 0, 0, 1, 0, 0, 0}, 10,
+             ControlFlow::kNone, 2},
+            {"cmp byte [rip + disp32], imm8", {0x80, 0x3D, 0x10, 0, 0, 0, 1}, 7, ControlFlow::kNone,
+             2},
+            {"movss xmm0, [rip + disp32]", {0xF3, 0x0F, 0x10, 0x05, 0x10, 0, 0, 0}, 8,
+             ControlFlow::kNone, 4},
+
+            // VEX and EVEX
+            {"vzeroupper", {0xC5, 0xF8, 0x77}, 3},
+            {"vmovdqa ymm0, [rip + disp32]", {0xC5, 0xFD, 0x6F, 0x05, 0x10, 0, 0, 0}, 8,
+             ControlFlow::kNone, 4},
+            {"vpshufb ymm0, ymm0, ymm1", {0xC4, 0xE2, 0x7D, 0x00, 0xC1}, 5},
+            {"vpalignr ymm0, ymm0, ymm1, imm8", {0xC4, 0xE3, 0x7D, 0x0F, 0xC1, 0x08}, 6},
+            {"vpshufd ymm0, ymm1, imm8", {0xC5, 0xFD, 0x70, 0xC1, 0x1B}, 5},
+            {"vmovdqu64 zmm0, [rax]", {0x62, 0xF1, 0xFE, 0x48, 0x6F, 0x00}, 6},
+            {"VEX map 0", {0xC4, 0xE0, 0x7D, 0x00, 0xC1}, std::nullopt},
+
+            // Relative branches
+            {"je rel8", {0x74, 0x05}, 2, ControlFlow::kRelativeBranch},
+            {"je rel32", {0x0F, 0x84, 0, 1, 0, 0}, 6, ControlFlow::kRelativeBranch},
+            {"jmp rel8", {0xEB, 0x05}, 2, ControlFlow::kRelativeBranch},
+            {"jmp rel32", {0xE9, 0, 1, 0, 0}, 5, ControlFlow::kRelativeBranch},
+            {"loop rel8", {0xE2, 0xFE}, 2, ControlFlow::kRelativeBranch},
+            {"loope rel8", {0xE1, 0xFE}, 2, ControlFlow::kRelativeBranch},
+            {"loopne rel8", {0xE0, 0xFE}, 2, ControlFlow::kRelativeBranch},
+            {"jrcxz rel8", {0xE3, 0x05}, 2, ControlFlow::kRelativeBranch},
+            {"bnd jmp rel32", {0xF2, 0xE9, 0, 1, 0, 0}, 6, ControlFlow::kRelativeBranch},
+            {"call rel32", {0xE8, 0, 1, 0, 0}, 5, ControlFlow::kRelativeCall},
+            {"truncated call", {0xE8, 0, 1}, std::nullopt},
+
+            // Absolute branches
+            {"ret", {0xC3}, 1, ControlFlow::kAbsoluteBranch},
+            {"ret imm16", {0xC2, 0x08, 0}, 3, ControlFlow::kAbsoluteBranch},
+            {"jmp rax", {0xFF, 0xE0}, 2, ControlFlow::kAbsoluteBranch},
+            {"jmp [rip + disp32]", {0xFF, 0x25, 0x10, 0, 0, 0}, 6, ControlFlow::kAbsoluteBranch, 2},
+            {"call rax", {0xFF, 0xD0}, 2, ControlFlow::kAbsoluteCall},
+            {"call [rip + disp32]", {0xFF, 0x15, 0x10, 0, 0, 0}, 6, ControlFlow::kAbsoluteCall, 2},
+            {"call [rax + disp8]", {0xFF, 0x50, 0x08}, 3, ControlFlow::kAbsoluteCall},
+
+            // Instructions that cannot be moved
+            {"syscall", {0x0F, 0x05}, 2, ControlFlow::kUnsupported},
+            {"int3", {0xCC}, 1, ControlFlow::kUnsupported},
+            {"int imm8", {0xCD, 0x80}, 2, ControlFlow::kUnsupported},
+            {"far call [rax]", {0xFF, 0x18}, 2, ControlFlow::kUnsupported},
+            {"far jmp [rax]", {0xFF, 0x28}, 2, ControlFlow::kUnsupported},
+            {"xbegin rel32", {0xC7, 0xF8, 0, 1, 0, 0}, 6, ControlFlow::kUnsupported},
+            {"xbegin rel16", {0x66, 0xC7, 0xF8, 0, 1}, 5, ControlFlow::kUnsupported},
+
+            // Invalid in 64 bits mode
+            {"push es", {0x06}, std::nullopt},
+            {"FF /7", {0xFF, 0xF8}, std::nullopt},
+            {"empty", {}, std::nullopt},
+    };
+    return res;
+  }
+
+  std::ostream& operator<<(std::ostream& os, const std::optional<uint8_t>& value) {
+    if (not value) return os << "none";
+    return os << int(*value);
+  }
+
+  bool check(const Case& test) {
+    auto info = ldb::decodeInstruction(test.code);
+    std::optional<uint8_t> length = info ? std::optional<uint8_t>(info->length) : std::nullopt;
+    bool passed = length == test.length;
+    if (info and passed) {
+      passed = info->control_flow == test.control_flow and
+               info->rip_displacement == test.rip_displacement;
+    }
+    if (passed) return true;
+
+    std::cerr << "FAILED " << test.name << ":";
+    for (auto byte : test.code)
+      std::cerr << " " << std::hex << std::setw(2) << std::setfill('0') << int(byte) << std::dec;
+    std::cerr << "\n  expected length " << test.length << ", flow " << int(test.control_flow)
+              << ", rip displacement " << test.rip_displacement << "\n  got length " << length;
+    if (info)
+      std::cerr << ", flow " << int(info->control_flow) << ", rip displacement "
+                << info->rip_displacement;
+    std::cerr << std::endl;
+    return false;
+  }
+
+}// namespace
+
+int main() {
+  size_t failed = 0;
+  for (const auto& test : cases())
+    if (not check(test)) failed++;
+
+  std::cout << cases().size() - failed << "/" << cases().size() << " encodings decoded"
+            << std::endl;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}